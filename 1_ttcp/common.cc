@@ -18,7 +18,10 @@ bool ParseCommandLine(int argc, char* argv[], Options& opt) {
         ("number,n", po::value<int>(&opt.number)->default_value(8192), "Number of buffers")
         ("trans,t",  po::value<std::string>(&opt.host), "Transmit")
         ("recv,r", "Receive")
-        ("nodelay,D", "set TCP_NODELAY");
+        ("nodelay,D", "set TCP_NODELAY")
+        ("ktls,k", "enable kernel TLS (ttcp_tls)")
+        ("cert", po::value<std::string>(&opt.cert), "certificate file (ttcp_tls -r)")
+        ("key", po::value<std::string>(&opt.key), "private key file (ttcp_tls -r)");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -27,6 +30,7 @@ bool ParseCommandLine(int argc, char* argv[], Options& opt) {
     opt.transmit = vm.count("trans");
     opt.receive = vm.count("recv");
     opt.nodelay = vm.count("nodelay");
+    opt.ktls = vm.count("ktls");
     if (vm.count("help")) {
         std::cout << desc << std::endl;
         return false;
@@ -8,9 +8,11 @@ struct Options {
     int length;
     int number;
     bool transmit, receive, nodelay;
+    bool ktls;                  // ttcp_tls: 开启 kTLS
     std::string host;
+    std::string cert, key;      // ttcp_tls: 接收端证书与私钥
 
-    Options() : port(0), length(0), number(0), transmit(0), receive(0), nodelay(0) {
+    Options() : port(0), length(0), number(0), transmit(0), receive(0), nodelay(0), ktls(0) {
     }
 };
 
@@ -0,0 +1,138 @@
+// ttcp over TLS: 与 ttcp_blocking 相同的协议, 用 sylar::SSLSocket 收发, -k 开启 kTLS
+// 接收端: ttcp_tls -r --cert cert.pem --key key.pem [-k]
+// 发送端: ttcp_tls -t 127.0.0.1 [-k] [-l 65536 -n 8192]
+#include <iostream>
+#include <assert.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <iomanip>
+
+#include "common.h"
+#include "sylar/socket.h"
+#include "sylar/socket_stream.h"
+#include "sylar/serialize.h"
+
+// 会话头, 线上格式与 SessionMessage 相同: ByteArray 默认网络字节序, 两个定长 int32
+struct SessionHeader {
+    int32_t number;
+    int32_t length;
+    SYLAR_SERIALIZE(number, length)
+};
+
+static void PrintKtls(sylar::SSLSocket::ptr sock) {
+    std::cout << "ktls send = " << sock->isKtlsSend()
+              << ", ktls recv = " << sock->isKtlsRecv() << std::endl;
+}
+
+void transmit(const Options& opt) {
+    sylar::IPAddress::ptr addr = sylar::IPAddress::Create(opt.host.c_str(), opt.port);
+    if (!addr) {
+        std::cout << "Unable to resolve " << opt.host << std::endl;
+        return;
+    }
+    sylar::SSLSocket::ptr sock = sylar::SSLSocket::CreateTCP(addr);
+    sock->setKtls(opt.ktls);
+    if (!sock->connect(addr)) {
+        perror("connect");
+        std::cout << "Unable to connect " << addr->toString() << std::endl;
+        return;
+    }
+    if (opt.nodelay) {
+        int v = 1;
+        sock->setOption(IPPROTO_TCP, TCP_NODELAY, v);
+    }
+    std::cout << "connected to " << addr->toString() << std::endl;
+    PrintKtls(sock);
+    sylar::SocketStream stream(sock);
+
+    int64_t start = GetNow();
+    SessionHeader header = {opt.number, opt.length};
+    sylar::ByteArray::ptr ba(new sylar::ByteArray);
+    sylar::Serialize(ba, header);
+    ba->setPosition(0);
+    if (stream.writeFixSize(ba, ba->getReadSize()) != (int)sizeof(SessionMessage)) {
+        perror("write SessionMessage");
+        exit(1);
+    }
+
+    // 长度头与数据分开, 每条消息一次 writev
+    int32_t length = htonl(opt.length);
+    std::string data(opt.length, 0);
+    for (int i = 0; i < opt.length; ++i) {
+        data[i] = "0123456789ABCDEF"[i % 16];
+    }
+    double total_mb = 1.0 * opt.length * opt.number / 1024 / 1024;
+    std::cout << std::fixed << std::setprecision(3) << total_mb << " MiB in total" << std::endl;
+
+    for (int i = 0; i < opt.number; ++i) {
+        iovec iov[2];
+        iov[0].iov_base = &length;
+        iov[0].iov_len = sizeof(length);
+        iov[1].iov_base = &data[0];
+        iov[1].iov_len = data.size();
+        int nw = stream.writeFixSizeV(iov, 2);
+        assert(nw == (int)(sizeof(length) + data.size()));
+
+        int ack = 0;
+        int nr = stream.readFixSize(&ack, sizeof(ack));
+        assert(nr == sizeof(ack));
+        ack = ntohl(ack);
+        assert(ack == opt.length);
+    }
+
+    sock->close();
+    double elapsed = (GetNow() - start) / 1000.0 / 1000.0;
+    printf("%.3f seconds\n%.3f MiB/s\n", elapsed, total_mb / elapsed);
+}
+
+void receive(const Options& opt) {
+    sylar::IPAddress::ptr addr = sylar::IPAddress::Create("0.0.0.0", opt.port);
+    sylar::SSLSocket::ptr listener = sylar::SSLSocket::CreateTCP(addr);
+    listener->setKtls(opt.ktls);
+    if (!listener->bind(addr) || !listener->listen()
+            || !listener->loadCertificates(opt.cert, opt.key)) {
+        perror("listen");
+        exit(1);
+    }
+    sylar::SSLSocket::ptr sock = std::dynamic_pointer_cast<sylar::SSLSocket>(listener->accept());
+    if (!sock || !sock->handshake()) {
+        std::cout << "accept/handshake failed" << std::endl;
+        exit(1);
+    }
+    PrintKtls(sock);
+    sylar::SocketStream stream(sock);
+
+    SessionHeader session_msg = {0, 0};
+    sylar::ByteArray::ptr ba(new sylar::ByteArray);
+    if (stream.readFixSize(ba, sizeof(SessionMessage)) != sizeof(SessionMessage)) {
+        perror("read SessionMessage");
+        exit(1);
+    }
+    ba->setPosition(0);
+    sylar::Deserialize(ba, session_msg);
+    std::cout << "received number = " << session_msg.number << std::endl
+            << "received length = " << session_msg.length << std::endl;
+
+    std::string payload(session_msg.length, 0);
+    for (int i = 0; i < session_msg.number; ++i) {
+        int32_t length = 0;
+        if (stream.readFixSize(&length, sizeof(length)) != sizeof(length)) {
+            perror("read error");
+            exit(1);
+        }
+        length = ntohl(length);
+        assert(length == session_msg.length);
+
+        if (stream.readFixSize(&payload[0], length) != length) {
+            perror("read payload error");
+            exit(1);
+        }
+
+        int32_t ack = htonl(length);
+        if (stream.writeFixSize(&ack, sizeof(ack)) != sizeof(ack)) {
+            perror("write ack error");
+            exit(1);
+        }
+    }
+    sock->close();
+}
@@ -0,0 +1,63 @@
+// ByteArray 创建/写入/销毁 吞吐压测, 对比 BufferPool 开关
+// 用法: bytearray_pool_bench [iterations] [write_bytes] [threads,threads,...]
+#include <stdlib.h>
+#include <stdio.h>
+#include <functional>
+#include <sstream>
+#include <vector>
+#include "sylar/bytearray.h"
+#include "sylar/config.h"
+#include "sylar/thread.h"
+#include "sylar/util.h"
+
+static uint64_t run(int threads, std::function<void()> fn) {
+    std::vector<sylar::Thread::ptr> thrs;
+    uint64_t begin = sylar::GetCurretUS();
+    for (int i = 0; i < threads; ++i) {
+        thrs.push_back(std::make_shared<sylar::Thread>(fn, "bench_" + std::to_string(i)));
+    }
+    for (auto& t : thrs) {
+        t->join();
+    }
+    return sylar::GetCurretUS() - begin;
+}
+
+int main(int argc, char** argv) {
+    uint64_t iters = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+    size_t write_bytes = argc > 2 ? strtoull(argv[2], nullptr, 10) : 16 * 1024;
+    std::vector<int> thread_counts = {1, 8, 32};
+    if (argc > 3) {
+        thread_counts.clear();
+        std::stringstream ss(argv[3]);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            thread_counts.push_back(atoi(item.c_str()));
+        }
+    }
+
+    auto enable = sylar::Config::Lookup<bool>("buffer_pool.enable");
+    std::string payload(write_bytes, 'x');
+
+    auto fn = [&]() {
+        char buf[8];    // 每个线程自己的读缓冲, payload 只读共享
+        for (uint64_t i = 0; i < iters; ++i) {
+            sylar::ByteArray::ptr ba(new sylar::ByteArray(4096));
+            ba->write(payload.c_str(), payload.size());
+            ba->setPosition(0);
+            ba->read(buf, sizeof(buf));
+        }
+    };
+
+    for (auto threads : thread_counts) {
+        for (int i = 0; i < 2; ++i) {
+            bool pool = (i == 1);
+            enable->setValue(pool);
+            uint64_t us = run(threads, fn);
+            uint64_t ops = iters * threads;
+            printf("%-8s threads=%-3d bytes=%-7lu ops=%-9lu time=%8.1fms  %8.3f Mops/s\n"
+                    , pool ? "pool" : "malloc", threads, (unsigned long)write_bytes
+                    , (unsigned long)ops, us / 1000.0, us ? ops / (double)us : 0.0);
+        }
+    }
+    return 0;
+}
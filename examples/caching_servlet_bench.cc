@@ -0,0 +1,119 @@
+// CachingServlet 压测: 耗时 2ms 的 servlet 直接执行 与 包一层 CachingServlet 对比
+// connections 个长连接各自串行 GET, uri 在 keys 个之间轮换; 缓存 ttl 较短, 过期时的并发未命中由 single-flight 合并
+// 用法: caching_servlet_bench [connections] [keys] [seconds] [ttl_ms], 服务端监听 127.0.0.1:18023
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <vector>
+#include "sylar/http/http_server.h"
+#include "sylar/http/caching_servlet.h"
+#include "sylar/thread.h"
+#include "sylar/util.h"
+
+static std::atomic<uint64_t> s_invocations(0);
+
+// 收一个响应, 出错返回 false; buf 中多收的数据留给下一个响应
+static bool recv_response(sylar::Socket::ptr sock, std::string& buf) {
+    size_t hdr_end;
+    while ((hdr_end = buf.find("\r\n\r\n")) == std::string::npos) {
+        char tmp[64 * 1024];
+        int rt = sock->recv(tmp, sizeof(tmp));
+        if (rt <= 0) {
+            return false;
+        }
+        buf.append(tmp, rt);
+    }
+    const char* cl = strcasestr(buf.c_str(), "content-length:");
+    if (!cl || cl > buf.c_str() + hdr_end) {
+        return false;
+    }
+    size_t total = hdr_end + 4 + strtoull(cl + 15, nullptr, 10);
+    while (buf.size() < total) {
+        char tmp[64 * 1024];
+        int rt = sock->recv(tmp, std::min(sizeof(tmp), total - buf.size()));
+        if (rt <= 0) {
+            return false;
+        }
+        buf.append(tmp, rt);
+    }
+    buf.erase(0, total);
+    return true;
+}
+
+static void bench(const char* name, sylar::Address::ptr addr, const std::string& prefix
+        , int connections, int keys, int seconds) {
+    std::atomic<uint64_t> requests(0);
+    uint64_t invocations = s_invocations;
+    uint64_t deadline = sylar::GetCurretMS() + seconds * 1000;
+
+    std::vector<sylar::Thread::ptr> clients;
+    for (int i = 0; i < connections; ++i) {
+        clients.push_back(std::make_shared<sylar::Thread>([&, i]() {
+            sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+            if (!sock->connect(addr)) {
+                perror("connect");
+                return;
+            }
+            std::string buf;
+            for (int n = i; sylar::GetCurretMS() < deadline; ++n) {
+                std::string req = "GET " + prefix + "?id=" + std::to_string(n % keys)
+                    + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+                if (sock->send(req.c_str(), req.size()) != (int)req.size()
+                        || !recv_response(sock, buf)) {
+                    break;
+                }
+                ++requests;
+            }
+        }, "client"));
+    }
+    for (auto& i : clients) {
+        i->join();
+    }
+    printf("%-16s %10.0f req/s  servlet calls=%lu\n", name, requests / (double)seconds
+            , (unsigned long)(s_invocations - invocations));
+}
+
+int main(int argc, char** argv) {
+    int connections = argc > 1 ? atoi(argv[1]) : 16;
+    int keys = argc > 2 ? atoi(argv[2]) : 8;
+    int seconds = argc > 3 ? atoi(argv[3]) : 5;
+    uint64_t ttl = argc > 4 ? strtoull(argv[4], nullptr, 10) : 100;
+    sylar::Logger::ptr system = SYLAR_LOG_NAME("system");
+    system->setLevel(sylar::LogLevel::WARN);
+
+    sylar::Address::ptr addr = sylar::Address::LookupAnyIPAddress("127.0.0.1:18023");
+    sylar::IOManager iom(2, false, "server");
+    sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true, &iom, &iom));
+    if (!server->bind(addr)) {
+        perror("bind");
+        return 1;
+    }
+    // 模拟查库: 2ms 的等待 (hook 后只挂起协程)
+    sylar::http::Servlet::ptr slow(new sylar::http::FunctionServlet([](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        ++s_invocations;
+        usleep(2000);
+        rsp->setHeader("Content-Type", "application/json");
+        rsp->setBody("{\"id\":" + req->getParam("id") + ",\"name\":\"item\",\"price\":100}");
+        return 0;
+    }));
+    sylar::http::CachingServlet::ptr cache(new sylar::http::CachingServlet(slow, ttl));
+    auto sd = server->getServletDispatch();
+    sd->addServlet("/direct", slow);
+    sd->addServlet("/cached", cache);
+    server->start();
+
+    printf("connections=%d keys=%d seconds=%d ttl=%lums\n", connections, keys, seconds, (unsigned long)ttl);
+    bench("direct", addr, "/direct", connections, keys, seconds);
+    bench("CachingServlet", addr, "/cached", connections, keys, seconds);
+    auto stats = cache->getStats();
+    printf("cache hits=%lu misses=%lu collapsed=%lu stores=%lu evictions=%lu bytes=%lu\n"
+            , (unsigned long)stats.hits, (unsigned long)stats.misses, (unsigned long)stats.collapsed
+            , (unsigned long)stats.stores, (unsigned long)stats.evictions, (unsigned long)stats.bytes);
+
+    server->stop();
+    return 0;
+}
@@ -0,0 +1,126 @@
+// 响应压缩: 不压缩 / 每次压缩 / 压缩结果缓存 三种方式的线上字节数与服务端压缩耗时
+// 用法: compress_bench [body_size] [requests], 服务端监听 127.0.0.1:18022
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include "sylar/http/http_server.h"
+#include "sylar/http/http_compress.h"
+#include "sylar/util.h"
+
+// 收一个响应, 返回线上的字节数 (头 + body), 出错返回 -1
+static int64_t recv_response(sylar::Socket::ptr sock, std::string& buf) {
+    size_t hdr_end;
+    while ((hdr_end = buf.find("\r\n\r\n")) == std::string::npos) {
+        char tmp[64 * 1024];
+        int rt = sock->recv(tmp, sizeof(tmp));
+        if (rt <= 0) {
+            return -1;
+        }
+        buf.append(tmp, rt);
+    }
+    const char* cl = strcasestr(buf.c_str(), "content-length:");
+    if (!cl || cl > buf.c_str() + hdr_end) {
+        return -1;
+    }
+    size_t total = hdr_end + 4 + strtoull(cl + 15, nullptr, 10);
+    while (buf.size() < total) {
+        char tmp[64 * 1024];
+        int rt = sock->recv(tmp, std::min(sizeof(tmp), total - buf.size()));
+        if (rt <= 0) {
+            return -1;
+        }
+        buf.append(tmp, rt);
+    }
+    buf.erase(0, total);
+    return total;
+}
+
+static void bench(const char* name, sylar::Address::ptr addr, const std::string& uri
+        , const std::string& accept_encoding, int requests) {
+    sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+    if (!sock->connect(addr)) {
+        perror("connect");
+        return;
+    }
+    std::string req = "GET " + uri + " HTTP/1.1\r\nHost: 127.0.0.1\r\n";
+    if (!accept_encoding.empty()) {
+        req += "Accept-Encoding: " + accept_encoding + "\r\n";
+    }
+    req += "\r\n";
+
+    sylar::http::ResetCompressStats();
+    std::string buf;
+    uint64_t bytes = 0;
+    uint64_t begin = sylar::GetCurretUS();
+    for (int i = 0; i < requests; ++i) {
+        if (sock->send(req.c_str(), req.size()) != (int)req.size()) {
+            break;
+        }
+        int64_t n = recv_response(sock, buf);
+        if (n < 0) {
+            break;
+        }
+        bytes += n;
+    }
+    uint64_t us = sylar::GetCurretUS() - begin;
+    auto stats = sylar::http::GetCompressStats();
+    printf("%-18s %8.0f req/s  wire=%8.1f KB/req  saved=%5.1f%%  compress cpu=%6.1f us/req  cache hits=%lu\n"
+            , name, us ? requests * 1000000.0 / us : 0.0, bytes / 1024.0 / requests
+            , stats.bytesIn ? 100.0 * (stats.bytesIn - stats.bytesOut) / stats.bytesIn : 0.0
+            , stats.cpuUs / (double)requests, (unsigned long)stats.cacheHits);
+}
+
+int main(int argc, char** argv) {
+    size_t body_size = argc > 1 ? strtoull(argv[1], nullptr, 10) : 64 * 1024;
+    int requests = argc > 2 ? atoi(argv[2]) : 2000;
+    sylar::Logger::ptr system = SYLAR_LOG_NAME("system");
+    system->setLevel(sylar::LogLevel::WARN);
+
+    // 类似 API 返回的 json 数组
+    std::mt19937 rng(1);
+    std::string body = "[";
+    for (int i = 0; body.size() < body_size; ++i) {
+        body += "{\"id\":" + std::to_string(i) + ",\"name\":\"user" + std::to_string(rng() % 10000)
+            + "\",\"score\":" + std::to_string(rng() % 1000) + ",\"active\":true},";
+    }
+    body.back() = ']';
+
+    sylar::Address::ptr addr = sylar::Address::LookupAnyIPAddress("127.0.0.1:18022");
+    sylar::IOManager iom(1, false, "server");
+    sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true, &iom, &iom));
+    if (!server->bind(addr)) {
+        perror("bind");
+        return 1;
+    }
+    auto sd = server->getServletDispatch();
+    sd->addServlet("/json", [&body](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        rsp->setHeader("Content-Type", "application/json");
+        rsp->setBody(body);
+        return 0;
+    });
+    sd->addServlet("/json_cached", [&body](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        rsp->setHeader("Content-Type", "application/json");
+        rsp->setBody(body);
+        rsp->setCacheable(true);
+        return 0;
+    });
+    server->start();
+
+    printf("body_size=%lu requests=%d\n", (unsigned long)body.size(), requests);
+    bench("identity", addr, "/json", "", requests);
+    bench("deflate", addr, "/json", "deflate", requests);
+    bench("gzip", addr, "/json", "gzip", requests);
+    bench("gzip + cache", addr, "/json_cached", "gzip", requests);
+#ifdef SYLAR_HAVE_BROTLI
+    bench("br", addr, "/json", "br", requests);
+    bench("br + cache", addr, "/json_cached", "br", requests);
+#endif
+
+    server->stop();
+    return 0;
+}
@@ -0,0 +1,204 @@
+// DnsResolver 对着本地 UDP stub DNS 服务器: 正确性、未命中/缓存命中的查询速度、并发查询合并、超时回退
+// stub 对 "nx*" 返回 NXDOMAIN, 对 "drop*" 不应答, 其余名字按名字的哈希返回一条 A / AAAA 记录
+// 用法: dns_stub_bench [names] [concurrency]
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <atomic>
+#include "sylar/dns.h"
+#include "sylar/config.h"
+#include "sylar/iomanager.h"
+#include "sylar/socket.h"
+#include "sylar/thread.h"
+#include "sylar/util.h"
+
+static std::atomic<uint64_t> s_queries(0);
+static std::atomic<bool> s_stop(false);
+
+static void PutU16(std::string& out, uint16_t v) {
+    out.push_back(v >> 8);
+    out.push_back(v & 0xFF);
+}
+
+static void PutU32(std::string& out, uint32_t v) {
+    PutU16(out, v >> 16);
+    PutU16(out, v & 0xFFFF);
+}
+
+// 构造应答, 返回 false 表示不应答
+static bool BuildAnswer(const uint8_t* data, int len, std::string& out) {
+    if (len < 12) {
+        return false;
+    }
+    // 只有一个问题, 名字不含压缩指针
+    int pos = 12;
+    std::string name;
+    while (pos < len && data[pos] != 0) {
+        int n = data[pos];
+        if (pos + 1 + n > len) {
+            return false;
+        }
+        if (!name.empty()) {
+            name.push_back('.');
+        }
+        name.append((const char*)data + pos + 1, n);
+        pos += 1 + n;
+    }
+    if (pos + 5 > len) {
+        return false;
+    }
+    pos += 1;
+    uint16_t qtype = data[pos] << 8 | data[pos + 1];
+    pos += 4;
+    if (name.compare(0, 4, "drop") == 0) {
+        return false;
+    }
+    bool nx = name.compare(0, 2, "nx") == 0;
+    bool answer = !nx && (qtype == sylar::DnsResolver::A || qtype == sylar::DnsResolver::AAAA);
+
+    out.assign((const char*)data, 2);           // id
+    PutU16(out, nx ? 0x8183 : 0x8180);          // QR RD RA, NXDOMAIN
+    PutU16(out, 1);                             // qdcount
+    PutU16(out, answer ? 1 : 0);                // ancount
+    PutU16(out, 0);
+    PutU16(out, 0);
+    out.append((const char*)data + 12, pos - 12);
+    if (answer) {
+        uint32_t h = std::hash<std::string>()(name);
+        PutU16(out, 0xC00C);                    // 指向问题中的名字
+        PutU16(out, qtype);
+        PutU16(out, 1);                         // IN
+        PutU32(out, 60);
+        if (qtype == sylar::DnsResolver::A) {
+            PutU16(out, 4);
+            PutU32(out, 0x0A000000 | (h & 0xFFFFFF));
+        } else {
+            PutU16(out, 16);
+            PutU16(out, 0xFD00);
+            out.append(10, 0);
+            PutU32(out, h);
+        }
+    }
+    return true;
+}
+
+// 在普通线程中运行 (没有 hook), 未 connect 的 UDP socket 直接用 recvfrom / sendto
+static void StubServer(sylar::Socket::ptr sock) {
+    int fd = sock->getSocket();
+    uint8_t buf[512];
+    std::string out;
+    while (!s_stop) {
+        pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;   // 超时, 检查是否退出
+        }
+        sockaddr_storage from;
+        socklen_t fromlen = sizeof(from);
+        int rt = recvfrom(fd, buf, sizeof(buf), 0, (sockaddr*)&from, &fromlen);
+        if (rt <= 0) {
+            continue;
+        }
+        ++s_queries;
+        if (BuildAnswer(buf, rt, out)) {
+            sendto(fd, out.c_str(), out.size(), 0, (sockaddr*)&from, fromlen);
+        }
+    }
+}
+
+static void print(const char* name, sylar::DnsResolver::Status status
+        , const std::vector<sylar::IPAddress::ptr>& addrs) {
+    printf("  %-14s %-10s", name, sylar::DnsResolver::StatusToString(status));
+    for (auto& i : addrs) {
+        printf(" %s", i->toString().c_str());
+    }
+    printf("\n");
+}
+
+static void report(const char* name, int count, uint64_t us, uint64_t queries) {
+    printf("%-22s %8.1fms  %10.0f lookups/s  stub queries=%lu\n", name, us / 1000.0
+            , us ? count * 1000000.0 / us : 0.0, (unsigned long)queries);
+}
+
+int main(int argc, char** argv) {
+    int names = argc > 1 ? atoi(argv[1]) : 2000;
+    int concurrency = argc > 2 ? atoi(argv[2]) : 100;
+    sylar::Logger::ptr system = SYLAR_LOG_NAME("system");
+    system->setLevel(sylar::LogLevel::WARN);
+
+    auto addr = sylar::Address::LookupAnyIPAddress("127.0.0.1:0");
+    sylar::Socket::ptr stub = sylar::Socket::CreateUDP(addr);
+    if (!stub->bind(addr)) {
+        perror("bind");
+        return 1;
+    }
+    sylar::Address::ptr stub_addr = stub->getLocalAddress();
+    sylar::Thread::ptr stub_thread(new sylar::Thread(std::bind(StubServer, stub), "dns_stub"));
+
+    sylar::IOManager iom(1, false, "dns");
+    iom.schedule([=]() {
+        sylar::DnsResolver* resolver = sylar::DnsResolverMgr::GetInstance();
+        resolver->setNameservers({stub_addr});
+        printf("nameserver %s\n", stub_addr->toString().c_str());
+
+        std::vector<sylar::IPAddress::ptr> addrs;
+        auto status = resolver->lookup(addrs, "host.test", AF_UNSPEC);
+        print("host.test", status, addrs);
+        addrs.clear();
+        status = resolver->lookup(addrs, "nx.test", AF_INET);
+        print("nx.test", status, addrs);
+
+        // 每个名字第一次查询走 stub, 第二次命中缓存
+        resolver->clearCache();
+        uint64_t queries = s_queries;
+        uint64_t begin = sylar::GetCurretUS();
+        for (int i = 0; i < names; ++i) {
+            addrs.clear();
+            resolver->lookup(addrs, "host" + std::to_string(i) + ".test", AF_INET);
+        }
+        report("miss (stub round trip)", names, sylar::GetCurretUS() - begin, s_queries - queries);
+        queries = s_queries;
+        begin = sylar::GetCurretUS();
+        for (int i = 0; i < names; ++i) {
+            addrs.clear();
+            resolver->lookup(addrs, "host" + std::to_string(i) + ".test", AF_INET);
+        }
+        report("hit (cache)", names, sylar::GetCurretUS() - begin, s_queries - queries);
+
+        // 同一个名字的并发查询只发一次
+        resolver->clearCache();
+        queries = s_queries;
+        std::shared_ptr<std::atomic<int>> done(new std::atomic<int>(0));
+        begin = sylar::GetCurretUS();
+        for (int i = 0; i < concurrency; ++i) {
+            sylar::IOManager::GetThis()->schedule([resolver, done]() {
+                std::vector<sylar::IPAddress::ptr> v;
+                resolver->lookup(v, "same.test", AF_INET);
+                ++*done;
+            });
+        }
+        while (*done < concurrency) {
+            usleep(1000);
+        }
+        report("concurrent same name", concurrency, sylar::GetCurretUS() - begin, s_queries - queries);
+
+        // nameserver 不应答: 解析器超时, Address::Lookup 回退到 getaddrinfo
+        sylar::Config::Lookup<uint32_t>("dns.timeout")->setValue(100);
+        sylar::Config::Lookup<uint32_t>("dns.attempts")->setValue(1);
+        addrs.clear();
+        begin = sylar::GetCurretUS();
+        status = resolver->lookup(addrs, "drop.test", AF_INET);
+        printf("  %-14s %-10s %.1fms\n", "drop.test", sylar::DnsResolver::StatusToString(status)
+                , (sylar::GetCurretUS() - begin) / 1000.0);
+        std::vector<sylar::Address::ptr> result;
+        bool ok = sylar::Address::Lookup(result, "drop.test:80", AF_INET);
+        printf("  Address::Lookup(drop.test) after fallback: %s, %lu addresses\n"
+                , ok ? "true" : "false", (unsigned long)result.size());
+    });
+    iom.stop();
+
+    s_stop = true;
+    stub_thread->join();
+    return 0;
+}
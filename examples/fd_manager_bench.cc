@@ -0,0 +1,149 @@
+// FdManager / do_io 快速路径多线程压测
+// 用法: fd_manager_bench [iterations] [threads,threads,...]
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <functional>
+#include <sstream>
+#include <vector>
+#include "sylar/fd_manager.h"
+#include "sylar/hook.h"
+#include "sylar/thread.h"
+#include "sylar/util.h"
+
+// 旧实现: 读写锁 + shared_ptr，用作对照
+class LockedFdTable {
+public:
+    struct Ctx {
+        typedef std::shared_ptr<Ctx> ptr;
+        uint64_t recv_timeout = -1;
+    };
+
+    LockedFdTable() { m_data.resize(64);}
+
+    Ctx::ptr get(int fd) {
+        sylar::RWMutex::ReadLock lock(m_mutex);
+        if ((int)m_data.size() <= fd) {
+            return nullptr;
+        }
+        return m_data[fd];
+    }
+
+    void add(int fd) {
+        sylar::RWMutex::WriteLock lock(m_mutex);
+        if (fd >= (int)m_data.size()) {
+            m_data.resize(fd * 1.5);
+        }
+        m_data[fd].reset(new Ctx);
+    }
+private:
+    sylar::RWMutex m_mutex;
+    std::vector<Ctx::ptr> m_data;
+};
+
+static LockedFdTable s_locked;
+static std::atomic<uint64_t> s_sink{0};
+
+// 并发运行 threads 个 fn，返回总耗时 us
+static uint64_t run(int threads, std::function<void(int)> fn) {
+    std::vector<sylar::Thread::ptr> thrs;
+    uint64_t begin = sylar::GetCurretUS();
+    for (int i = 0; i < threads; ++i) {
+        thrs.push_back(std::make_shared<sylar::Thread>(std::bind(fn, i)
+                    , "bench_" + std::to_string(i)));
+    }
+    for (auto& t : thrs) {
+        t->join();
+    }
+    return sylar::GetCurretUS() - begin;
+}
+
+static void report(const char* name, int threads, uint64_t ops, uint64_t us) {
+    printf("%-16s threads=%-3d ops=%-10lu time=%8.1fms  %8.2f Mops/s  %7.1f ns/op/thread\n"
+            , name, threads, (unsigned long)ops, us / 1000.0
+            , us ? ops / (double)us : 0.0
+            , ops ? us * 1000.0 * threads / ops : 0.0);
+}
+
+int main(int argc, char** argv) {
+    uint64_t iters = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    std::vector<int> thread_counts = {1, 8, 32};
+    if (argc > 2) {
+        thread_counts.clear();
+        std::stringstream ss(argv[2]);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            thread_counts.push_back(atoi(item.c_str()));
+        }
+    }
+
+    int max_threads = 0;
+    for (auto n : thread_counts) {
+        max_threads = std::max(max_threads, n);
+    }
+
+    // 每个线程一对 socketpair，读写不会阻塞，只测 do_io 快速路径
+    std::vector<std::pair<int, int>> socks;
+    for (int i = 0; i < max_threads; ++i) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+            perror("socketpair");
+            return 1;
+        }
+        sylar::FdMgr::GetInstance()->get(sv[0], true);
+        sylar::FdMgr::GetInstance()->get(sv[1], true);
+        s_locked.add(sv[0]);
+        s_locked.add(sv[1]);
+        socks.push_back(std::make_pair(sv[0], sv[1]));
+    }
+
+    for (auto threads : thread_counts) {
+        uint64_t us = run(threads, [&](int idx) {
+            int fd = socks[idx].first;
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < iters; ++i) {
+                auto ctx = s_locked.get(fd);
+                sum += ctx->recv_timeout;
+            }
+            s_sink += sum;
+        });
+        report("locked_get", threads, iters * threads, us);
+
+        us = run(threads, [&](int idx) {
+            int fd = socks[idx].first;
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < iters; ++i) {
+                sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(fd);
+                sum += ctx->getTimeout(SO_RCVTIMEO);
+            }
+            s_sink += sum;
+        });
+        report("fdmgr_get", threads, iters * threads, us);
+
+        // write + read 各走一次 hook 后的 do_io
+        uint64_t io_iters = iters / 10;
+        us = run(threads, [&](int idx) {
+            sylar::set_hook_enable(true);
+            int wfd = socks[idx].first;
+            int rfd = socks[idx].second;
+            char c = 'x';
+            for (uint64_t i = 0; i < io_iters; ++i) {
+                if (write(wfd, &c, 1) != 1 || read(rfd, &c, 1) != 1) {
+                    perror("do_io");
+                    break;
+                }
+            }
+            sylar::set_hook_enable(false);
+        });
+        report("do_io", threads, io_iters * threads * 2, us);
+    }
+
+    for (auto& p : socks) {
+        close(p.first);
+        close(p.second);
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+// HTTP/1.1 流水线压测: 客户端一次写出 depth 个请求再读回 depth 个响应, 对比 depth 1/16/64 的 QPS
+// 用法: http_pipeline_bench [requests] [depths...], 服务端监听 127.0.0.1:18020
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "sylar/http/http_server.h"
+#include "sylar/thread.h"
+#include "sylar/util.h"
+
+static const char* s_request = "GET /ping HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: bench\r\n\r\n";
+
+// 发出 n 个请求, 收到 n 个响应 (响应长度固定为 rsp_len) 返回 true
+static bool roundtrip(sylar::Socket::ptr sock, const std::string& reqs, size_t rsp_len, std::string& buf) {
+    if (sock->send(reqs.c_str(), reqs.size()) != (int)reqs.size()) {
+        return false;
+    }
+    size_t got = 0;
+    while (got < rsp_len) {
+        int rt = sock->recv(&buf[0], std::min(buf.size(), rsp_len - got));
+        if (rt <= 0) {
+            return false;
+        }
+        got += rt;
+    }
+    return true;
+}
+
+static void bench(sylar::Address::ptr addr, uint64_t requests, const std::vector<int>& depths) {
+    sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+    if (!sock->connect(addr)) {
+        perror("connect");
+        return;
+    }
+    // 先发一个请求得到单个响应的长度
+    std::string buf(1024 * 1024, 0);
+    std::string req(s_request);
+    if (sock->send(req.c_str(), req.size()) <= 0) {
+        perror("send");
+        return;
+    }
+    int rsp_len = sock->recv(&buf[0], buf.size());
+    if (rsp_len <= 0) {
+        perror("recv");
+        return;
+    }
+
+    for (int depth : depths) {
+        std::string reqs;
+        for (int i = 0; i < depth; ++i) {
+            reqs += s_request;
+        }
+        uint64_t rounds = requests / depth;
+        uint64_t begin = sylar::GetCurretUS();
+        for (uint64_t r = 0; r < rounds; ++r) {
+            if (!roundtrip(sock, reqs, rsp_len * depth, buf)) {
+                perror("roundtrip");
+                return;
+            }
+        }
+        uint64_t us = sylar::GetCurretUS() - begin;
+        printf("depth=%-3d requests=%-8lu time=%8.1fms  %10.0f req/s\n", depth
+                , (unsigned long)(rounds * depth), us / 1000.0, us ? rounds * depth * 1e6 / us : 0.0);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint64_t requests = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+    std::vector<int> depths;
+    for (int i = 2; i < argc; ++i) {
+        depths.push_back(atoi(argv[i]));
+    }
+    if (depths.empty()) {
+        depths = {1, 16, 64};
+    }
+    sylar::Logger::ptr system = SYLAR_LOG_NAME("system");
+    system->setLevel(sylar::LogLevel::WARN);
+
+    sylar::Address::ptr addr = sylar::Address::LookupAnyIPAddress("127.0.0.1:18020");
+    sylar::IOManager iom(1, false, "server");
+    sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true, &iom, &iom));
+    if (!server->bind(addr)) {
+        perror("bind");
+        return 1;
+    }
+    server->getServletDispatch()->addServlet("/ping", [](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        rsp->setBody("pong");
+        return 0;
+    });
+    server->start();
+
+    // 客户端在独立线程中用阻塞 socket
+    sylar::Thread client(std::bind(bench, addr, requests, depths), "client");
+    client.join();
+    server->stop();
+    return 0;
+}
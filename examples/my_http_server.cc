@@ -1,4 +1,5 @@
 #include "sylar/http/http_server.h"
+#include "sylar/http/sse_writer.h"
 #include "sylar/address.h"
 
 void run() {
@@ -21,6 +22,19 @@ void run() {
         rsp->setBody(req->toString());
         return 0;
     });
+    // 流式响应: 每秒推送一条 SSE 事件, 共 10 条
+    sd->addServlet("/events", [](sylar::http::HttpRequest::ptr req
+                                    , sylar::http::HttpResponse::ptr rsp
+                                    , sylar::http::HttpSession::ptr session){
+        auto sse = sylar::http::SSEWriter::Start(rsp, session);
+        for (int i = 0; sse && i < 10; ++i) {
+            if (sse->send("tick " + std::to_string(i), "tick", std::to_string(i)) < 0) {
+                break;
+            }
+            sleep(1);
+        }
+        return 0;
+    });
 
     http_server->start();
 }
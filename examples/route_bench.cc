@@ -0,0 +1,63 @@
+// ServletDispatch 路由查找: 1k 条 fnmatch 模糊匹配 与 1k 条 RouteTree 路由 对比
+// 用法: route_bench [routes] [lookups]
+#include <stdlib.h>
+#include <stdio.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "sylar/http/servlet.h"
+#include "sylar/util.h"
+
+static void report(const char* name, size_t count, uint64_t us, size_t hits) {
+    printf("%-24s %8.1fms  %8.2f M lookups/s  hits=%lu\n", name, us / 1000.0
+            , us ? count / (double)us : 0.0, (unsigned long)hits);
+}
+
+int main(int argc, char** argv) {
+    int routes = argc > 1 ? atoi(argv[1]) : 1000;
+    size_t lookups = argc > 2 ? strtoull(argv[2], nullptr, 10) : 1000000;
+
+    sylar::http::ServletDispatch::ptr glob(new sylar::http::ServletDispatch);
+    sylar::http::ServletDispatch::ptr route(new sylar::http::ServletDispatch);
+    auto cb = [](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        return 0;
+    };
+    for (int i = 0; i < routes; ++i) {
+        std::string base = "/api/v1/res" + std::to_string(i);
+        glob->addGlobServlet(base + "/*", cb);
+        route->addRouteServlet(base + "/:id", cb);
+    }
+
+    // 请求均匀落在各路由上, 模糊匹配平均要扫一半的 glob
+    std::mt19937 rng(1);
+    std::vector<std::string> uris(4096);
+    for (auto& i : uris) {
+        i = "/api/v1/res" + std::to_string(rng() % routes) + "/" + std::to_string(rng() % 100000);
+    }
+
+    size_t hits = 0;
+    uint64_t begin = sylar::GetCurretUS();
+    for (size_t i = 0; i < lookups; ++i) {
+        hits += glob->getMatchedServlet(uris[i % uris.size()]) != glob->getDefault();
+    }
+    report("glob (fnmatch)", lookups, sylar::GetCurretUS() - begin, hits);
+
+    hits = 0;
+    begin = sylar::GetCurretUS();
+    for (size_t i = 0; i < lookups; ++i) {
+        hits += route->getMatchedServlet(uris[i % uris.size()]) != route->getDefault();
+    }
+    report("route (radix tree)", lookups, sylar::GetCurretUS() - begin, hits);
+
+    // 带参数捕获 (写入 HttpRequest)
+    sylar::http::HttpRequest::ptr req(new sylar::http::HttpRequest);
+    hits = 0;
+    begin = sylar::GetCurretUS();
+    for (size_t i = 0; i < lookups; ++i) {
+        hits += route->getMatchedServlet(uris[i % uris.size()], req) != route->getDefault();
+    }
+    report("route + params", lookups, sylar::GetCurretUS() - begin, hits);
+    return 0;
+}
@@ -0,0 +1,212 @@
+// SYLAR_SERIALIZE 结构体序列化: 与手写的 ByteArray 调用序列对比 编码结果 / 往返 / 吞吐
+// 用法: serialize_bench [count] [rounds]
+#include <stdlib.h>
+#include <stdio.h>
+#include <random>
+#include <vector>
+#include "sylar/serialize.h"
+#include "sylar/util.h"
+
+struct Item {
+    uint32_t sku;
+    int32_t count;
+    double price;
+    SYLAR_SERIALIZE(sku, count, price)
+};
+
+struct Order {
+    uint64_t id;
+    int32_t user;
+    uint16_t flags;
+    bool paid;
+    double amount;
+    std::string symbol;
+    std::vector<uint32_t> tags;
+    std::vector<Item> items;
+    int64_t created;
+    SYLAR_SERIALIZE(id, user, flags, paid, amount, symbol, tags, items, created)
+};
+
+static bool operator==(const Item& a, const Item& b) {
+    return a.sku == b.sku && a.count == b.count && a.price == b.price;
+}
+
+static bool operator==(const Order& a, const Order& b) {
+    return a.id == b.id && a.user == b.user && a.flags == b.flags && a.paid == b.paid
+        && a.amount == b.amount && a.symbol == b.symbol && a.tags == b.tags
+        && a.items == b.items && a.created == b.created;
+}
+
+// 手写的等价编码
+static void WriteOrder(sylar::ByteArray::ptr ba, const Order& v) {
+    ba->writeFuint64(v.id);
+    ba->writeFint32(v.user);
+    ba->writeFuint16(v.flags);
+    ba->writeFuint8(v.paid);
+    ba->writeDouble(v.amount);
+    ba->writeStringVint(v.symbol);
+    ba->writeUint64(v.tags.size());
+    for (auto i : v.tags) {
+        ba->writeFuint32(i);
+    }
+    ba->writeUint64(v.items.size());
+    for (auto& i : v.items) {
+        ba->writeFuint32(i.sku);
+        ba->writeFint32(i.count);
+        ba->writeDouble(i.price);
+    }
+    ba->writeFint64(v.created);
+}
+
+static void ReadOrder(sylar::ByteArray::ptr ba, Order& v) {
+    v.id = ba->readFuint64();
+    v.user = ba->readFint32();
+    v.flags = ba->readFuint16();
+    v.paid = ba->readFuint8() != 0;
+    v.amount = ba->readDouble();
+    v.symbol = ba->readStringVint();
+    v.tags.resize(ba->readUint64());
+    for (auto& i : v.tags) {
+        i = ba->readFuint32();
+    }
+    v.items.resize(ba->readUint64());
+    for (auto& i : v.items) {
+        i.sku = ba->readFuint32();
+        i.count = ba->readFint32();
+        i.price = ba->readDouble();
+    }
+    v.created = ba->readFint64();
+}
+
+static void gen(std::vector<Order>& orders) {
+    std::mt19937_64 rng(1);
+    for (auto& o : orders) {
+        o.id = rng();
+        o.user = (int32_t)(rng() % 1000000);
+        o.flags = rng() & 0xFFFF;
+        o.paid = rng() & 1;
+        o.amount = (rng() % 100000) / 100.0;
+        o.symbol = "SYM" + std::to_string(rng() % 1000);
+        o.tags.resize(rng() % 8);
+        for (auto& i : o.tags) {
+            i = (uint32_t)rng();
+        }
+        o.items.resize(1 + rng() % 4);
+        for (auto& i : o.items) {
+            i.sku = (uint32_t)rng();
+            i.count = (int32_t)(rng() % 100);
+            i.price = (rng() % 10000) / 100.0;
+        }
+        o.created = (int64_t)(rng() >> 1);
+    }
+}
+
+static void report(const char* name, size_t count, uint64_t us, size_t bytes) {
+    printf("%-24s %8.1fms  %8.2f M structs/s  %8.1f MB/s\n", name, us / 1000.0
+            , us ? count / (double)us : 0.0, us ? bytes / (double)us : 0.0);
+}
+
+// 两种字节序下: 编码结果与手写的完全相同, 互相能解出原值
+static bool check(const std::vector<Order>& orders, bool little) {
+    for (auto& o : orders) {
+        sylar::ByteArray::ptr a(new sylar::ByteArray);
+        sylar::ByteArray::ptr b(new sylar::ByteArray);
+        a->setIsLittleEndian(little);
+        b->setIsLittleEndian(little);
+        sylar::Serialize(a, o);
+        WriteOrder(b, o);
+        a->setPosition(0);
+        b->setPosition(0);
+        if (a->getSize() != sylar::SerializedSize(o) || a->toString() != b->toString()) {
+            return false;
+        }
+        Order x;
+        Order y;
+        sylar::Deserialize(b, x);
+        ReadOrder(a, y);
+        if (!(x == o) || !(y == o) || a->getReadSize() || b->getReadSize()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+    std::vector<Order> orders(count);
+    gen(orders);
+    printf("round trip big endian: %s\n", check(orders, false) ? "OK" : "MISMATCH");
+    printf("round trip little endian: %s\n", check(orders, true) ? "OK" : "MISMATCH");
+
+    // 数据不足时抛出异常
+    {
+        sylar::ByteArray::ptr ba(new sylar::ByteArray);
+        sylar::Serialize(ba, orders[0]);
+        size_t size = ba->getSize();
+        sylar::ByteArray::ptr cut(new sylar::ByteArray);
+        cut->write(ba->toString().c_str(), size / 2);
+        cut->setPosition(0);
+        Order o;
+        bool thrown = false;
+        try {
+            sylar::Deserialize(cut, o);
+        } catch (std::out_of_range& e) {
+            thrown = true;
+        }
+        printf("truncated input: %s\n", thrown ? "out_of_range" : "NOT DETECTED");
+    }
+
+    size_t total = count * rounds;
+    size_t bytes = 0;
+    uint64_t begin = sylar::GetCurretUS();
+    for (int r = 0; r < rounds; ++r) {
+        sylar::ByteArray::ptr ba(new sylar::ByteArray);
+        for (auto& o : orders) {
+            WriteOrder(ba, o);
+        }
+        bytes += ba->getSize();
+    }
+    report("hand-written write", total, sylar::GetCurretUS() - begin, bytes);
+
+    bytes = 0;
+    begin = sylar::GetCurretUS();
+    for (int r = 0; r < rounds; ++r) {
+        sylar::ByteArray::ptr ba(new sylar::ByteArray);
+        for (auto& o : orders) {
+            sylar::Serialize(ba, o);
+        }
+        bytes += ba->getSize();
+    }
+    report("SYLAR_SERIALIZE write", total, sylar::GetCurretUS() - begin, bytes);
+
+    sylar::ByteArray::ptr ba(new sylar::ByteArray);
+    for (auto& o : orders) {
+        sylar::Serialize(ba, o);
+    }
+    std::vector<Order> out(count);
+
+    begin = sylar::GetCurretUS();
+    for (int r = 0; r < rounds; ++r) {
+        ba->setPosition(0);
+        for (auto& o : out) {
+            ReadOrder(ba, o);
+        }
+    }
+    report("hand-written read", total, sylar::GetCurretUS() - begin, ba->getSize() * rounds);
+
+    begin = sylar::GetCurretUS();
+    for (int r = 0; r < rounds; ++r) {
+        ba->setPosition(0);
+        for (auto& o : out) {
+            sylar::Deserialize(ba, o);
+        }
+    }
+    report("SYLAR_SERIALIZE read", total, sylar::GetCurretUS() - begin, ba->getSize() * rounds);
+
+    if (!(out == orders)) {
+        printf("read mismatch\n");
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+// 静态文件吞吐压测: StaticFileServlet (sendfile + fd 缓存) 与 读文件到 setBody 的 servlet 对比
+// 客户端类似 wrk: connections 个长连接各自串行 GET, 统计 QPS 和吞吐
+// 用法: static_file_bench [file_size] [connections] [seconds], 服务端监听 127.0.0.1:18021
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <vector>
+#include "sylar/http/http_server.h"
+#include "sylar/http/static_file_servlet.h"
+#include "sylar/thread.h"
+#include "sylar/util.h"
+
+static const char* s_dir = "/tmp/static_file_bench";
+
+// 收一个响应, 返回 body 长度, 出错返回 -1; buf 中多收的数据留给下一个响应
+static int64_t recv_response(sylar::Socket::ptr sock, std::string& buf) {
+    size_t hdr_end;
+    while ((hdr_end = buf.find("\r\n\r\n")) == std::string::npos) {
+        char tmp[64 * 1024];
+        int rt = sock->recv(tmp, sizeof(tmp));
+        if (rt <= 0) {
+            return -1;
+        }
+        buf.append(tmp, rt);
+    }
+    const char* cl = strcasestr(buf.c_str(), "content-length:");
+    if (!cl || cl > buf.c_str() + hdr_end) {
+        return -1;
+    }
+    int64_t length = strtoll(cl + 15, nullptr, 10);
+    size_t total = hdr_end + 4 + length;
+    while (buf.size() < total) {
+        char tmp[64 * 1024];
+        int rt = sock->recv(tmp, std::min(sizeof(tmp), total - buf.size()));
+        if (rt <= 0) {
+            return -1;
+        }
+        buf.append(tmp, rt);
+    }
+    buf.erase(0, total);
+    return length;
+}
+
+static void bench(const char* name, sylar::Address::ptr addr, const std::string& uri
+        , int connections, int seconds) {
+    std::atomic<uint64_t> requests(0);
+    std::atomic<uint64_t> bytes(0);
+    uint64_t deadline = sylar::GetCurretMS() + seconds * 1000;
+    std::string req = "GET " + uri + " HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n";
+
+    std::vector<sylar::Thread::ptr> clients;
+    for (int i = 0; i < connections; ++i) {
+        clients.push_back(std::make_shared<sylar::Thread>([&]() {
+            sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+            if (!sock->connect(addr)) {
+                perror("connect");
+                return;
+            }
+            std::string buf;
+            while (sylar::GetCurretMS() < deadline) {
+                if (sock->send(req.c_str(), req.size()) != (int)req.size()) {
+                    break;
+                }
+                int64_t n = recv_response(sock, buf);
+                if (n < 0) {
+                    break;
+                }
+                ++requests;
+                bytes += n;
+            }
+        }, "client"));
+    }
+    for (auto& i : clients) {
+        i->join();
+    }
+    printf("%-22s %10.0f req/s  %10.1f MB/s\n", name, requests / (double)seconds
+            , bytes / (double)seconds / 1024 / 1024);
+}
+
+int main(int argc, char** argv) {
+    size_t file_size = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1024 * 1024;
+    int connections = argc > 2 ? atoi(argv[2]) : 4;
+    int seconds = argc > 3 ? atoi(argv[3]) : 5;
+    sylar::Logger::ptr system = SYLAR_LOG_NAME("system");
+    system->setLevel(sylar::LogLevel::WARN);
+
+    sylar::FSUtil::Mkdir(s_dir);
+    std::string file = std::string(s_dir) + "/data.bin";
+    {
+        std::ofstream ofs(file, std::ios::binary | std::ios::trunc);
+        std::string block(64 * 1024, 'x');
+        for (size_t left = file_size; left > 0; ) {
+            size_t n = std::min(left, block.size());
+            ofs.write(block.c_str(), n);
+            left -= n;
+        }
+    }
+
+    sylar::Address::ptr addr = sylar::Address::LookupAnyIPAddress("127.0.0.1:18021");
+    sylar::IOManager iom(2, false, "server");
+    sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true, &iom, &iom));
+    if (!server->bind(addr)) {
+        perror("bind");
+        return 1;
+    }
+    auto sd = server->getServletDispatch();
+    sylar::http::StaticFileServlet::ptr sfs(new sylar::http::StaticFileServlet(s_dir, "/static/"));
+    sd->addRouteServlet("/static/*file", sfs);
+    // 对照: 每次把文件读进内存再 setBody
+    sd->addRouteServlet("/copy/*file", [](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        std::ifstream ifs(std::string(s_dir) + "/" + req->getPathParam("file"), std::ios::binary);
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        rsp->setBody(ss.str());
+        return 0;
+    });
+    server->start();
+
+    printf("file_size=%lu connections=%d seconds=%d\n", (unsigned long)file_size, connections, seconds);
+    bench("read + setBody", addr, "/copy/data.bin", connections, seconds);
+    bench("StaticFileServlet", addr, "/static/data.bin", connections, seconds);
+    auto stats = sfs->getStats();
+    printf("fd cache hits=%lu misses=%lu invalidations=%lu\n", (unsigned long)stats.hits
+            , (unsigned long)stats.misses, (unsigned long)stats.invalidations);
+
+    server->stop();
+    sylar::FSUtil::Unlink(file);
+    return 0;
+}
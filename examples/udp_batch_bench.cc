@@ -0,0 +1,108 @@
+// 回环 UDP 收发 pps 压测: 逐个 sendTo/recvFrom 与 sendBatch/recvBatch 及 GSO/GRO 对比
+// 用法: udp_batch_bench [packets] [payload] [batch]
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include "sylar/socket.h"
+#include "sylar/util.h"
+
+static void report(const char* name, uint64_t packets, uint64_t us) {
+    printf("%-12s packets=%-9lu time=%8.1fms  %8.3f Mpps\n", name, (unsigned long)packets
+            , us / 1000.0, us ? packets / (double)us : 0.0);
+}
+
+int main(int argc, char** argv) {
+    uint64_t packets = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t payload = argc > 2 ? strtoull(argv[2], nullptr, 10) : 64;
+    size_t batch_size = argc > 3 ? strtoull(argv[3], nullptr, 10) : 64;
+    uint64_t rounds = packets / batch_size;
+    packets = rounds * batch_size;
+
+    auto addr = sylar::Address::LookupAnyIPAddress("127.0.0.1:0");
+    sylar::Socket::ptr rx = sylar::Socket::CreateUDP(addr);
+    sylar::Socket::ptr tx = sylar::Socket::CreateUDP(addr);
+    if (!rx->bind(addr) || !tx->bind(addr)) {
+        perror("bind");
+        return 1;
+    }
+    int rcvbuf = 8 * 1024 * 1024;
+    rx->setOption(SOL_SOCKET, SO_RCVBUF, rcvbuf);
+    // 每轮先发 batch_size 个再收回来, 接收缓冲足够时回环不会丢包
+    if (!tx->connect(rx->getLocalAddress()) || !rx->connect(tx->getLocalAddress())) {
+        perror("connect");
+        return 1;
+    }
+
+    std::string data(payload, 'x');
+    std::string buf(65536, 0);
+    sylar::Address::ptr from = tx->getLocalAddress();
+
+    uint64_t begin = sylar::GetCurretUS();
+    for (uint64_t r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < batch_size; ++i) {
+            tx->sendTo(data.c_str(), data.size(), rx->getLocalAddress());
+        }
+        for (size_t i = 0; i < batch_size; ++i) {
+            if (rx->recvFrom(&buf[0], buf.size(), from) <= 0) {
+                perror("recvFrom");
+                return 1;
+            }
+        }
+    }
+    report("single", packets, sylar::GetCurretUS() - begin);
+
+    sylar::DatagramBatch::ptr sb(new sylar::DatagramBatch(batch_size, payload));
+    sylar::DatagramBatch::ptr rb(new sylar::DatagramBatch(batch_size, 2048));
+    begin = sylar::GetCurretUS();
+    for (uint64_t r = 0; r < rounds; ++r) {
+        sb->clear();
+        for (size_t i = 0; i < batch_size; ++i) {
+            sb->add(data.c_str(), data.size());
+        }
+        if (tx->sendBatch(sb) != (int)batch_size) {
+            perror("sendBatch");
+            return 1;
+        }
+        for (size_t got = 0; got < batch_size;) {
+            int rt = rx->recvBatch(rb);
+            if (rt <= 0) {
+                perror("recvBatch");
+                return 1;
+            }
+            got += rt;
+        }
+    }
+    report("batch", packets, sylar::GetCurretUS() - begin);
+
+    // GSO: 一次发送 batch_size 个分段; GRO: 接收端合并后一次收回
+    size_t gso_bytes = payload * batch_size;
+    if (gso_bytes > 65000 || !rx->setUdpGro(true)) {
+        printf("gso/gro      skipped\n");
+        return 0;
+    }
+    sylar::DatagramBatch::ptr gb(new sylar::DatagramBatch(1, gso_bytes));
+    sylar::DatagramBatch::ptr grb(new sylar::DatagramBatch(batch_size, 65536));
+    std::string segs(gso_bytes, 'x');
+    begin = sylar::GetCurretUS();
+    for (uint64_t r = 0; r < rounds; ++r) {
+        gb->clear();
+        gb->add(segs.c_str(), segs.size(), nullptr, payload);
+        if (tx->sendBatch(gb) != 1) {
+            perror("sendBatch gso");
+            printf("gso/gro      unsupported\n");
+            return 0;
+        }
+        for (size_t got = 0; got < gso_bytes;) {
+            int rt = rx->recvBatch(grb);
+            if (rt <= 0) {
+                perror("recvBatch gro");
+                return 1;
+            }
+            for (int i = 0; i < rt; ++i) {
+                got += grb->length(i);
+            }
+        }
+    }
+    report("gso+gro", packets, sylar::GetCurretUS() - begin);
+    return 0;
+}
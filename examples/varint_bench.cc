@@ -0,0 +1,101 @@
+// ByteArray 批量 varint 编解码 与 逐个调用 对比
+// 用法: varint_bench [count] [rounds]
+#include <stdlib.h>
+#include <stdio.h>
+#include <random>
+#include <vector>
+#include "sylar/bytearray.h"
+#include "sylar/util.h"
+
+template<class T>
+static void gen(std::vector<T>& v, int max_bits) {
+    std::mt19937_64 rng(1);
+    for (auto& i : v) {
+        int bits = rng() % (max_bits + 1);
+        i = (T)(bits >= 64 ? rng() : rng() & ((1ull << bits) - 1));
+    }
+}
+
+static void report(const char* name, size_t count, uint64_t us) {
+    printf("%-28s %8.1fms  %8.2f M values/s\n", name, us / 1000.0
+            , us ? count / (double)us : 0.0);
+}
+
+template<class T, class WriteOne, class ReadOne, class WriteBulk, class ReadBulk>
+static void bench(const char* title, std::vector<T>& values, int rounds
+        , WriteOne write_one, ReadOne read_one, WriteBulk write_bulk, ReadBulk read_bulk) {
+    size_t n = values.size();
+    std::vector<T> out(n);
+    size_t total = n * rounds;
+    std::string name(title);
+
+    uint64_t begin = sylar::GetCurretUS();
+    for (int r = 0; r < rounds; ++r) {
+        sylar::ByteArray ba;
+        for (size_t i = 0; i < n; ++i) {
+            write_one(ba, values[i]);
+        }
+    }
+    report((name + " write loop").c_str(), total, sylar::GetCurretUS() - begin);
+
+    begin = sylar::GetCurretUS();
+    for (int r = 0; r < rounds; ++r) {
+        sylar::ByteArray ba;
+        write_bulk(ba, values.data(), n);
+    }
+    report((name + " write bulk").c_str(), total, sylar::GetCurretUS() - begin);
+
+    sylar::ByteArray ba;
+    write_bulk(ba, values.data(), n);
+
+    begin = sylar::GetCurretUS();
+    for (int r = 0; r < rounds; ++r) {
+        ba.setPosition(0);
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = read_one(ba);
+        }
+    }
+    report((name + " read loop").c_str(), total, sylar::GetCurretUS() - begin);
+
+    begin = sylar::GetCurretUS();
+    for (int r = 0; r < rounds; ++r) {
+        ba.setPosition(0);
+        read_bulk(ba, out.data(), n);
+    }
+    report((name + " read bulk").c_str(), total, sylar::GetCurretUS() - begin);
+
+    if (out != values) {
+        printf("%s mismatch\n", title);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+    // 小值居多 (单字节) 与 随机位宽 两种分布
+    int dists[] = {7, 32};
+    for (int bits : dists) {
+        printf("--- uint32, values < 2^%d\n", bits);
+        std::vector<uint32_t> v32(count);
+        gen(v32, bits);
+        bench("uint32", v32, rounds
+            , [](sylar::ByteArray& ba, uint32_t v) { ba.writeUint32(v);}
+            , [](sylar::ByteArray& ba) { return ba.readUint32();}
+            , [](sylar::ByteArray& ba, const uint32_t* v, size_t n) { ba.writeUint32Array(v, n);}
+            , [](sylar::ByteArray& ba, uint32_t* v, size_t n) { ba.readUint32Array(v, n);});
+    }
+
+    int dists64[] = {7, 64};
+    for (int bits : dists64) {
+        printf("--- uint64, values < 2^%d\n", bits);
+        std::vector<uint64_t> v64(count);
+        gen(v64, bits);
+        bench("uint64", v64, rounds
+            , [](sylar::ByteArray& ba, uint64_t v) { ba.writeUint64(v);}
+            , [](sylar::ByteArray& ba) { return ba.readUint64();}
+            , [](sylar::ByteArray& ba, const uint64_t* v, size_t n) { ba.writeUint64Array(v, n);}
+            , [](sylar::ByteArray& ba, uint64_t* v, size_t n) { ba.readUint64Array(v, n);});
+    }
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include <netdb.h>
 #include <ifaddrs.h>
 #include "address.h"
+#include "dns.h"
 #include "endian.h"
 #include "log.h"
 
@@ -47,6 +48,54 @@ IPAddress::ptr Address::LookupAnyIPAddress(const std::string& host,
     return nullptr;
 }
 
+// 返回 true 表示已由 DnsResolver 给出结论，false 表示需要回退到 getaddrinfo
+static bool LookupByResolver(std::vector<Address::ptr>& result, const std::string& node
+                    , const char* service, int family) {
+    if (family != AF_INET && family != AF_INET6 && family != AF_UNSPEC) {
+        return false;
+    }
+    uint16_t port = 0;
+    if (service && *service) {
+        char* end = nullptr;
+        unsigned long v = strtoul(service, &end, 10);
+        if (*end != '\0' || v > 0xFFFF) {
+            return false;   // 服务名 (如 "http") 交给 getaddrinfo
+        }
+        port = v;
+    }
+
+    in6_addr buf;
+    if (inet_pton(AF_INET, node.c_str(), &buf) == 1
+            || inet_pton(AF_INET6, node.c_str(), &buf) == 1) {
+        return false;   // 数字地址, getaddrinfo 不会阻塞
+    }
+
+    DnsResolver* resolver = DnsResolverMgr::GetInstance();
+    if (!resolver->isAvailable()) {
+        return false;
+    }
+    std::vector<IPAddress::ptr> addrs;
+    DnsResolver::Status status = resolver->lookup(addrs, node, family);
+    switch (status) {
+        case DnsResolver::OK:
+            for (auto& addr : addrs) {
+                addr->setPort(port);
+                result.push_back(addr);
+            }
+            return true;
+        case DnsResolver::NOT_FOUND:
+            SYLAR_LOG_DEBUG(g_logger) << "Address::Lookup resolver(" << node << ", "
+                << family << ") status=" << DnsResolver::StatusToString(status);
+            return true;
+        default:
+            // 超时 (nameserver 配置错误或不可达) 等交给 getaddrinfo 再试
+            SYLAR_LOG_DEBUG(g_logger) << "Address::Lookup resolver(" << node << ", "
+                << family << ") status=" << DnsResolver::StatusToString(status)
+                << ", fallback to getaddrinfo";
+            return false;
+    }
+}
+
 bool Address::Lookup(std::vector<Address::ptr>& result, const std::string& host, 
                     int family, int type, int protocol) {
     
@@ -90,6 +139,13 @@ bool Address::Lookup(std::vector<Address::ptr>& result, const std::string& host,
     if (node.empty()) {
         node = host;
     }
+
+    // 域名且端口为数字时，在协程中走异步 DNS 解析，避免 getaddrinfo 阻塞工作线程
+    size_t old_size = result.size();
+    if (LookupByResolver(result, node, service, family)) {
+        return result.size() != old_size;
+    }
+
     int error = getaddrinfo(node.c_str(), service, &hints, &results);
     if (error) {
         SYLAR_LOG_DEBUG(g_logger) << "Address::Lookup getaddrinfo(" << host << ","
@@ -220,6 +220,8 @@ int Application::run_fiber() {
                 << LexicalCast<TcpServerConf, std::string>()(conf);
             _exit(0);
         }
+        server->setFastOpen(conf.fast_open);
+        server->setDeferAccept(conf.defer_accept);
         std::vector<Address::ptr> failed_addrs;
         if (!server->bind(p_addrs, failed_addrs, conf.ssl)) {
             for (auto& f_addr : failed_addrs) {
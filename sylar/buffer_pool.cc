@@ -0,0 +1,201 @@
+#include "buffer_pool.h"
+#include <new>
+#include <atomic>
+#include "config.h"
+#include "mutex.h"
+#include "macro.h"
+
+namespace sylar {
+
+static sylar::ConfigVar<bool>::ptr g_buffer_pool_enable =
+    sylar::Config::Lookup("buffer_pool.enable", true, "enable buffer pool for ByteArray nodes");
+
+static sylar::ConfigVar<uint64_t>::ptr g_buffer_pool_thread_cache =
+    sylar::Config::Lookup("buffer_pool.thread_cache_size", (uint64_t)(1024 * 1024)
+            , "max cached bytes per size class per thread");
+
+static sylar::ConfigVar<uint64_t>::ptr g_buffer_pool_global_cache =
+    sylar::Config::Lookup("buffer_pool.global_cache_size", (uint64_t)(16 * 1024 * 1024)
+            , "max cached bytes per size class in global pool");
+
+// 配置在任意线程修改, 分配/释放路径上只做 relaxed 读
+static std::atomic<bool> s_buffer_pool_enable(true);
+static std::atomic<uint64_t> s_buffer_pool_thread_cache(0);
+static std::atomic<uint64_t> s_buffer_pool_global_cache(0);
+
+namespace {
+
+struct _BufferPoolIniter {
+    _BufferPoolIniter() {
+        s_buffer_pool_enable.store(g_buffer_pool_enable->getValue(), std::memory_order_relaxed);
+        s_buffer_pool_thread_cache.store(g_buffer_pool_thread_cache->getValue(), std::memory_order_relaxed);
+        s_buffer_pool_global_cache.store(g_buffer_pool_global_cache->getValue(), std::memory_order_relaxed);
+
+        g_buffer_pool_enable->addListener([](const bool& old_val, const bool& new_val){
+            s_buffer_pool_enable.store(new_val, std::memory_order_relaxed);
+        });
+        g_buffer_pool_thread_cache->addListener([](const uint64_t& old_val, const uint64_t& new_val){
+            s_buffer_pool_thread_cache.store(new_val, std::memory_order_relaxed);
+        });
+        g_buffer_pool_global_cache->addListener([](const uint64_t& old_val, const uint64_t& new_val){
+            s_buffer_pool_global_cache.store(new_val, std::memory_order_relaxed);
+        });
+    }
+};
+
+static _BufferPoolIniter s_buffer_pool_initer;
+
+static const size_t MIN_SHIFT = 6;      // 64B
+static const size_t MAX_SHIFT = 16;     // 64K
+static const size_t CLASS_COUNT = MAX_SHIFT - MIN_SHIFT + 1;
+static const size_t MAX_SIZE = (size_t)1 << MAX_SHIFT;
+static const size_t BATCH_SIZE = 32;    // 与全局池之间一次搬运的块数
+
+// 空闲块的头部复用为链表指针
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct FreeList {
+    FreeBlock* head = nullptr;
+    size_t count = 0;
+
+    void push(FreeBlock* b) {
+        b->next = head;
+        head = b;
+        ++count;
+    }
+
+    FreeBlock* pop() {
+        FreeBlock* b = head;
+        head = b->next;
+        --count;
+        return b;
+    }
+};
+
+size_t ClassIndex(size_t size) {
+    if (size <= ((size_t)1 << MIN_SHIFT)) {
+        return 0;
+    }
+    return 64 - __builtin_clzll(size - 1) - MIN_SHIFT;
+}
+
+size_t ClassSize(size_t idx) {
+    return (size_t)1 << (idx + MIN_SHIFT);
+}
+
+// 全局池，不析构，避免进程退出时与线程缓存的析构顺序问题
+class GlobalPool {
+public:
+    static GlobalPool* GetInstance() {
+        static GlobalPool* s_pool = new GlobalPool;
+        return s_pool;
+    }
+
+    // 取最多 n 块到 list
+    void fetch(size_t idx, FreeList& list, size_t n) {
+        Spinlock::Lock lock(m_mutex[idx]);
+        FreeList& g = m_lists[idx];
+        while (n-- > 0 && g.head) {
+            list.push(g.pop());
+        }
+    }
+
+    // 归还 list 中的 n 块，超出全局上限的直接释放
+    void release(size_t idx, FreeList& list, size_t n) {
+        size_t max_count = s_buffer_pool_global_cache.load(std::memory_order_relaxed) / ClassSize(idx);
+        FreeBlock* overflow = nullptr;
+        {
+            Spinlock::Lock lock(m_mutex[idx]);
+            FreeList& g = m_lists[idx];
+            while (n-- > 0 && list.head) {
+                FreeBlock* b = list.pop();
+                if (g.count < max_count) {
+                    g.push(b);
+                } else {
+                    b->next = overflow;
+                    overflow = b;
+                }
+            }
+        }
+        while (overflow) {
+            FreeBlock* b = overflow;
+            overflow = overflow->next;
+            ::operator delete(b);
+        }
+    }
+private:
+    Spinlock m_mutex[CLASS_COUNT];
+    FreeList m_lists[CLASS_COUNT];
+};
+
+struct ThreadCache {
+    FreeList lists[CLASS_COUNT];
+
+    ~ThreadCache();
+};
+
+static thread_local ThreadCache t_cache;
+static thread_local bool t_cache_destroyed = false;
+
+ThreadCache::~ThreadCache() {
+    t_cache_destroyed = true;
+    for (size_t i = 0; i < CLASS_COUNT; ++i) {
+        GlobalPool::GetInstance()->release(i, lists[i], lists[i].count);
+    }
+}
+
+}
+
+size_t BufferPool::RoundUp(size_t size) {
+    if (size > MAX_SIZE) {
+        return size;
+    }
+    return ClassSize(ClassIndex(size));
+}
+
+void* BufferPool::Allocate(size_t size) {
+    if (SYLAR_UNLIKELY(size > MAX_SIZE)) {
+        return ::operator new(size);
+    }
+    // 无论是否启用都按级别大小申请，关闭后再打开也能安全放回池中
+    size_t idx = ClassIndex(size);
+    if (SYLAR_UNLIKELY(!s_buffer_pool_enable.load(std::memory_order_relaxed) || t_cache_destroyed)) {
+        return ::operator new(ClassSize(idx));
+    }
+
+    FreeList& list = t_cache.lists[idx];
+    if (SYLAR_UNLIKELY(!list.head)) {
+        GlobalPool::GetInstance()->fetch(idx, list, BATCH_SIZE);
+        if (!list.head) {
+            return ::operator new(ClassSize(idx));
+        }
+    }
+    return list.pop();
+}
+
+void BufferPool::Deallocate(void* ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+    if (SYLAR_UNLIKELY(size > MAX_SIZE)) {
+        ::operator delete(ptr);
+        return;
+    }
+    if (SYLAR_UNLIKELY(!s_buffer_pool_enable.load(std::memory_order_relaxed) || t_cache_destroyed)) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    size_t idx = ClassIndex(size);
+    FreeList& list = t_cache.lists[idx];
+    list.push((FreeBlock*)ptr);
+    if (SYLAR_UNLIKELY(list.count * ClassSize(idx)
+            > s_buffer_pool_thread_cache.load(std::memory_order_relaxed))) {
+        // 一次归还一半，避免在上限附近反复搬运
+        GlobalPool::GetInstance()->release(idx, list, list.count / 2 + 1);
+    }
+}
+
+}
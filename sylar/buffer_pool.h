@@ -0,0 +1,25 @@
+#ifndef __SYLAR_BUFFER_POOL_H__
+#define __SYLAR_BUFFER_POOL_H__
+
+#include <stddef.h>
+
+namespace sylar {
+
+/**
+ * 按 2 的幂分级的内存池, 64B ~ 64K
+ * 每个线程缓存各级的空闲块，超过上限时成批归还到全局池，全局池也满了才真正释放
+ * 超过最大级别的请求直接走 ::operator new
+ * 释放时必须传入与申请时相同的 size
+ */
+class BufferPool {
+public:
+    static void* Allocate(size_t size);
+    static void Deallocate(void* ptr, size_t size);
+
+    // size 实际占用的字节数
+    static size_t RoundUp(size_t size);
+};
+
+}
+
+#endif  // __SYLAR_BUFFER_POOL_H__
@@ -0,0 +1,223 @@
+#include "buffered_stream.h"
+#include <string.h>
+#include <algorithm>
+
+namespace sylar {
+
+BufferedStream::BufferedStream(Stream::ptr stream, size_t read_buffer_size, size_t write_buffer_size)
+    :m_stream(stream)
+    ,m_readSize(read_buffer_size)
+    ,m_writeSize(write_buffer_size)
+    ,m_readPos(0)
+    ,m_readEnd(0) {
+}
+
+int BufferedStream::fill(size_t length) {
+    while (m_readEnd - m_readPos < length) {
+        // 未读数据移到头部, 留出尽量大的连续空间
+        if (m_readPos > 0) {
+            memmove(&m_readBuf[0], &m_readBuf[m_readPos], m_readEnd - m_readPos);
+            m_readEnd -= m_readPos;
+            m_readPos = 0;
+        }
+        size_t need = std::max(length, m_readSize);
+        if (m_readBuf.size() < need) {
+            m_readBuf.resize(std::max(need, m_readBuf.size() * 2));
+        }
+        int rt = m_stream->read(&m_readBuf[m_readEnd], m_readBuf.size() - m_readEnd);
+        if (rt <= 0) {
+            return rt;
+        }
+        m_readEnd += rt;
+    }
+    return m_readEnd - m_readPos;
+}
+
+int BufferedStream::read(void* buffer, size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    if (flushBeforeRead() < 0) {
+        return -1;
+    }
+    if (m_readPos == m_readEnd) {
+        // 大块读取不经过缓冲
+        if (length >= m_readSize) {
+            return m_stream->read(buffer, length);
+        }
+        int rt = fill(1);
+        if (rt <= 0) {
+            return rt;
+        }
+    }
+    size_t n = std::min(length, m_readEnd - m_readPos);
+    memcpy(buffer, &m_readBuf[m_readPos], n);
+    m_readPos += n;
+    return n;
+}
+
+int BufferedStream::read(ByteArray::ptr ba, size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    if (flushBeforeRead() < 0) {
+        return -1;
+    }
+    if (m_readPos == m_readEnd) {
+        if (length >= m_readSize) {
+            return m_stream->read(ba, length);
+        }
+        int rt = fill(1);
+        if (rt <= 0) {
+            return rt;
+        }
+    }
+    size_t n = std::min(length, m_readEnd - m_readPos);
+    ba->write(&m_readBuf[m_readPos], n);
+    m_readPos += n;
+    return n;
+}
+
+int BufferedStream::peek(void* buffer, size_t length) {
+    if (flushBeforeRead() < 0) {
+        return -1;
+    }
+    int rt = fill(length);
+    if (rt <= 0) {
+        return rt;
+    }
+    memcpy(buffer, &m_readBuf[m_readPos], length);
+    return length;
+}
+
+int BufferedStream::readUntil(std::string& out, const std::string& delim, size_t max_size) {
+    if (delim.empty()) {
+        out.clear();
+        return 0;
+    }
+    if (flushBeforeRead() < 0) {
+        return -1;
+    }
+    size_t searched = 0;    // 已经查找过的长度, 下层读到新数据后不再从头找
+    while (true) {
+        size_t avail = m_readEnd - m_readPos;
+        if (avail >= delim.size()) {
+            const char* begin = &m_readBuf[m_readPos];
+            const char* from = begin + (searched > delim.size() - 1 ? searched - delim.size() + 1 : 0);
+            const char* pos = std::search(from, begin + avail, delim.begin(), delim.end());
+            if (pos != begin + avail) {
+                size_t n = pos - begin + delim.size();
+                out.assign(begin, n);
+                m_readPos += n;
+                return n;
+            }
+            searched = avail;
+        }
+        if (avail >= max_size) {
+            return -1;
+        }
+        int rt = fill(avail + 1);
+        if (rt <= 0) {
+            return rt;
+        }
+    }
+}
+
+void BufferedStream::unread(const void* buffer, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    if (m_readPos >= length) {
+        m_readPos -= length;
+        memcpy(&m_readBuf[m_readPos], buffer, length);
+        return;
+    }
+    std::vector<char> buf;
+    buf.reserve(std::max(length + m_readEnd - m_readPos, m_readSize));
+    buf.insert(buf.end(), (const char*)buffer, (const char*)buffer + length);
+    buf.insert(buf.end(), m_readBuf.begin() + m_readPos, m_readBuf.begin() + m_readEnd);
+    m_readEnd = buf.size();
+    m_readPos = 0;
+    buf.resize(buf.capacity());
+    m_readBuf.swap(buf);
+}
+
+int BufferedStream::write(const void* buffer, size_t length) {
+    if (m_writeBuf.size() + length <= m_writeSize) {
+        m_writeBuf.append((const char*)buffer, length);
+        return length;
+    }
+    if (m_writeBuf.empty()) {
+        return m_stream->write(buffer, length);
+    }
+    iovec iov;
+    iov.iov_base = (void*)buffer;
+    iov.iov_len = length;
+    return writev(&iov, 1);
+}
+
+int BufferedStream::write(ByteArray::ptr ba, size_t length) {
+    if (m_writeBuf.size() + length <= m_writeSize) {
+        size_t old = m_writeBuf.size();
+        m_writeBuf.resize(old + length);
+        ba->read(&m_writeBuf[old], length);
+        return length;
+    }
+    if (!m_writeBuf.empty() && flush() < 0) {
+        return -1;
+    }
+    return m_stream->write(ba, length);
+}
+
+int BufferedStream::writev(const iovec* iov, size_t iovcnt) {
+    size_t total = 0;
+    for (size_t i = 0; i < iovcnt; ++i) {
+        total += iov[i].iov_len;
+    }
+    if (m_writeBuf.size() + total <= m_writeSize) {
+        for (size_t i = 0; i < iovcnt; ++i) {
+            m_writeBuf.append((const char*)iov[i].iov_base, iov[i].iov_len);
+        }
+        return total;
+    }
+    if (m_writeBuf.empty()) {
+        return m_stream->writev(iov, iovcnt);
+    }
+    // 缓冲放不下, 连同已攒的数据一起发出, 全部写完才返回
+    std::vector<iovec> iovs;
+    iovs.reserve(iovcnt + 1);
+    iovec head;
+    head.iov_base = &m_writeBuf[0];
+    head.iov_len = m_writeBuf.size();
+    iovs.push_back(head);
+    iovs.insert(iovs.end(), iov, iov + iovcnt);
+    int rt = m_stream->writeFixSizeV(&iovs[0], iovs.size());
+    m_writeBuf.clear();
+    return rt <= 0 ? rt : total;
+}
+
+int BufferedStream::flush() {
+    if (m_writeBuf.empty()) {
+        return m_stream->flush();
+    }
+    int rt = m_stream->writeFixSize(m_writeBuf.c_str(), m_writeBuf.size());
+    m_writeBuf.clear();
+    if (rt <= 0 || m_stream->flush() < 0) {
+        return -1;
+    }
+    return rt;
+}
+
+void BufferedStream::setWriteBufferSize(size_t v) {
+    if (m_writeBuf.size() > v) {
+        flush();
+    }
+    m_writeSize = v;
+}
+
+void BufferedStream::close() {
+    flush();
+    m_stream->close();
+}
+
+}
@@ -0,0 +1,69 @@
+#ifndef __SYLAR_BUFFERED_STREAM_H__
+#define __SYLAR_BUFFERED_STREAM_H__
+
+#include <vector>
+#include "stream.h"
+
+namespace sylar {
+
+/**
+ * 带读写缓冲的 Stream 装饰器
+ * 读: 小块读取先从下层一次预读 read_buffer_size 字节, 之后从缓冲中取, 减少小头部的系统调用;
+ *     缓冲为空且请求长度不小于缓冲大小时直接读下层
+ * 写: 小块写入先攒在写缓冲, 放不下时与缓冲中的数据一起 writeFixSizeV 发出
+ *     写缓冲中的数据需要 flush() 才能保证发出, 读之前会自动 flush (请求-响应式协议不会互相等待)
+ * 缓冲大小为 0 表示该方向不缓冲
+ * 非线程安全; 读写在不同协程中同时进行时不要开启写缓冲 (读之前的 flush 会与写交错)
+ */
+class BufferedStream : public Stream {
+public:
+    typedef std::shared_ptr<BufferedStream> ptr;
+    BufferedStream(Stream::ptr stream, size_t read_buffer_size = 4096, size_t write_buffer_size = 0);
+
+    virtual int read(void* buffer, size_t length) override;
+    virtual int read(ByteArray::ptr ba, size_t length) override;
+    virtual int write(const void* buffer, size_t length) override;
+    virtual int write(ByteArray::ptr ba, size_t length) override;
+    virtual int writev(const iovec* iov, size_t iovcnt) override;
+    // 先 flush 再关闭下层
+    virtual void close() override;
+    // 发出写缓冲中的数据, 返回发送的字节数, 没有数据返回 0, 出错返回 -1
+    virtual int flush() override;
+
+    // 等到缓冲中有 length 个字节后复制到 buffer, 不移动读位置, 返回 length, <= 0 同 read()
+    int peek(void* buffer, size_t length);
+    /**
+     * 读到 delim 为止, out 包含 delim
+     * 返回 out 的长度, <= 0 同 read(), 超过 max_size 还没找到 delim 返回 -1 (已读的数据留在缓冲中)
+     */
+    int readUntil(std::string& out, const std::string& delim, size_t max_size = 64 * 1024);
+    // 把数据放回读缓冲的最前面, 下次读取时先读到
+    void unread(const void* buffer, size_t length);
+
+    void setReadBufferSize(size_t v) { m_readSize = v;}
+    void setWriteBufferSize(size_t v);
+    size_t getReadBufferSize() const { return m_readSize;}
+    size_t getWriteBufferSize() const { return m_writeSize;}
+    // 读缓冲中未读的字节数
+    size_t getReadAvailable() const { return m_readEnd - m_readPos;}
+    // 写缓冲中未发出的字节数
+    size_t getWritePending() const { return m_writeBuf.size();}
+    Stream::ptr getStream() const { return m_stream;}
+private:
+    // 保证读缓冲中至少有 length 个字节, 返回缓冲中的字节数, <= 0 同 read()
+    int fill(size_t length);
+    // 读之前发出攒着的写数据
+    int flushBeforeRead() { return m_writeBuf.empty() ? 0 : flush();}
+private:
+    Stream::ptr m_stream;
+    size_t m_readSize;
+    size_t m_writeSize;
+    std::vector<char> m_readBuf;
+    size_t m_readPos;           // 未读数据 [m_readPos, m_readEnd)
+    size_t m_readEnd;
+    std::string m_writeBuf;
+};
+
+}
+
+#endif  // __SYLAR_BUFFERED_STREAM_H__
@@ -1,32 +1,100 @@
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "bytearray.h"
+#include "buffer_pool.h"
 #include "endian.h"
 #include "log.h"
+#include "macro.h"
 
 namespace sylar {
 
 static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
+ByteArray::Chunk::Chunk(size_t s)
+    :refs(1)
+    ,data((char*)BufferPool::Allocate(s))
+    ,size(s)
+    ,releaser(nullptr)
+    ,readonly(false) {
+}
+
+ByteArray::Chunk::Chunk(char* d, size_t s, Releaser r, bool ro)
+    :refs(1)
+    ,data(d)
+    ,size(s)
+    ,releaser(r)
+    ,readonly(ro) {
+}
+
+ByteArray::Chunk::~Chunk() {
+    if (releaser) {
+        releaser(data, size);
+    } else {
+        BufferPool::Deallocate(data, size);
+    }
+}
+
+void* ByteArray::Chunk::operator new(size_t size) {
+    return BufferPool::Allocate(size);
+}
+
+void ByteArray::Chunk::operator delete(void* p, size_t size) {
+    BufferPool::Deallocate(p, size);
+}
+
 ByteArray::Node::Node(size_t s)
-    :ptr(new char[s])
+    :ptr(nullptr)
     ,next(nullptr)
-    ,size(s) {
-
+    ,size(s)
+    ,chunk(new Chunk(s)) {
+    ptr = chunk->data;
 }
 
 ByteArray::Node::Node() 
     :ptr(nullptr)
     ,next(nullptr)
-    ,size(0) {
+    ,size(0)
+    ,chunk(nullptr) {
+}
+
+ByteArray::Node::Node(Chunk* c, char* p, size_t s)
+    :ptr(p)
+    ,next(nullptr)
+    ,size(s)
+    ,chunk(c) {
+    chunk->ref();
 }
 
 ByteArray::Node::~Node() {
-    if (ptr) {
-        delete[] ptr;
+    if (chunk) {
+        chunk->unref();
+    }
+}
+
+void* ByteArray::Node::operator new(size_t size) {
+    return BufferPool::Allocate(size);
+}
+
+void ByteArray::Node::operator delete(void* p, size_t size) {
+    BufferPool::Deallocate(p, size);
+}
+
+static void ReleaseNodes(ByteArray::Node* node) {
+    while (node) {
+        ByteArray::Node* next = node->next;
+        delete node;
+        node = next;
     }
 }
 
@@ -39,17 +107,13 @@ ByteArray::ByteArray(size_t base_size)
     ,m_endian(SYLAR_BIG_ENDIAN)
     ,m_root(new Node(base_size))
     ,m_cur(m_root)
+    ,m_curBase(0)
      {
 
 }  
 
 ByteArray::~ByteArray() {
-    Node* tmp = m_root;
-    while (tmp) {
-        m_cur = tmp;
-        tmp = tmp->next;
-        delete m_cur;
-    }
+    ReleaseNodes(m_root);
 }
 
 bool ByteArray::isLittleEndian() const {
@@ -172,6 +236,178 @@ void ByteArray::writeUint64(uint64_t value) {
     write(tmp, i);
 }
 
+namespace {
+
+// 编码一个值到 p, 返回写入后的位置
+template<class T>
+uint8_t* EncodeVarint(T value, uint8_t* p) {
+    while (value >= 0x80) {
+        *p++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+/**
+ * 解码 [p, p + len) 中完整的变长整数，最多 n 个，返回解码的个数，p 后移
+ * 与 readUint32/readUint64 一致: 最多读 MaxBytes 个字节
+ * 值跨越了 len 的末尾时停下，交给调用方跨节点处理
+ */
+template<class T, int MaxBytes>
+size_t DecodeVarintBlock(const uint8_t*& p, size_t len, T* out, size_t n) {
+    const uint8_t* end = p + len;
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 每次看 16 个字节的最高位: 全为 0 时是 16 个单字节值，直接展开
+    const __m128i zero = _mm_setzero_si128();
+    while (end - p >= 16 && n - i >= 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)p);
+        uint32_t mask = _mm_movemask_epi8(x);
+        if (mask != 0) {
+            // 用掩码定位每个值的结束字节，组装这 16 个字节内的完整值
+            size_t consumed = 0;
+            while (i < n) {
+                uint32_t rest = ~(mask >> consumed);
+                size_t vlen = __builtin_ctz(rest) + 1;
+                if (vlen > (size_t)MaxBytes || consumed + vlen > 16) {
+                    break;
+                }
+                T v = 0;
+                for (size_t k = 0; k < vlen; ++k) {
+                    v |= (T)(p[consumed + k] & 0x7F) << (7 * k);
+                }
+                out[i++] = v;
+                consumed += vlen;
+            }
+            if (consumed == 0) {
+                break;      // 超长的值，交给下面的逐字节解码
+            }
+            p += consumed;
+            continue;
+        }
+
+        __m128i lo = _mm_unpacklo_epi8(x, zero);
+        __m128i hi = _mm_unpackhi_epi8(x, zero);
+        __m128i w[4] = {_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero)
+                , _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)};
+        if (sizeof(T) == 4) {
+            for (int k = 0; k < 4; ++k) {
+                _mm_storeu_si128((__m128i*)(out + i + k * 4), w[k]);
+            }
+        } else {
+            for (int k = 0; k < 4; ++k) {
+                _mm_storeu_si128((__m128i*)(out + i + k * 4), _mm_unpacklo_epi32(w[k], zero));
+                _mm_storeu_si128((__m128i*)(out + i + k * 4 + 2), _mm_unpackhi_epi32(w[k], zero));
+            }
+        }
+        p += 16;
+        i += 16;
+    }
+#endif
+    while (i < n && p < end) {
+        T v = 0;
+        const uint8_t* q = p;
+        int k = 0;
+        for (; k < MaxBytes && q < end; ++k) {
+            uint8_t b = *q++;
+            v |= (T)(b & 0x7F) << (7 * k);
+            if (b < 0x80) {
+                break;
+            }
+        }
+        if (k == MaxBytes || (q <= end && !(q[-1] & 0x80))) {
+            out[i++] = v;
+            p = q;
+        } else {
+            break;      // 值跨越了末尾
+        }
+    }
+    return i;
+}
+
+}
+
+template<class T, int MaxBytes>
+void ByteArray::writeVarintArray(const T* values, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        addCapaticy(MaxBytes);
+        size_t npos = m_position - m_curBase;
+        size_t ncap = m_cur->size - npos;
+        if (SYLAR_UNLIKELY(m_cur->chunk->readonly)) {
+            throw std::logic_error("write to readonly chunk");
+        }
+        if (ncap >= (size_t)MaxBytes) {
+            // 当前节点放得下时直接编码进节点内存
+            uint8_t* begin = (uint8_t*)m_cur->ptr + npos;
+            uint8_t* p = begin;
+            uint8_t* end = begin + ncap - MaxBytes;
+            while (i < n && p <= end) {
+                p = EncodeVarint(values[i++], p);
+            }
+            setPosition(m_position + (p - begin));
+        } else {
+            // 节点尾部不足一个最大长度，可能跨节点，走普通 write
+            uint8_t tmp[MaxBytes];
+            write(tmp, EncodeVarint(values[i++], tmp) - tmp);
+        }
+    }
+}
+
+template<class T, int MaxBytes>
+void ByteArray::readVarintArray(T* values, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        size_t read_size = getReadSize();
+        if (read_size == 0) {
+            throw std::out_of_range("not enough length");
+        }
+        size_t npos = m_position - m_curBase;
+        const uint8_t* begin = (const uint8_t*)m_cur->ptr + npos;
+        const uint8_t* p = begin;
+        i += DecodeVarintBlock<T, MaxBytes>(p, std::min(m_cur->size - npos, read_size)
+                , values + i, n - i);
+        if (p != begin) {
+            setPosition(m_position + (p - begin));
+        }
+        if (i < n && p == begin) {
+            // 值跨越了节点边界
+            values[i++] = sizeof(T) == 4 ? readUint32() : readUint64();
+        }
+    }
+}
+
+void ByteArray::writeUint32Array(const uint32_t* values, size_t n) {
+    writeVarintArray<uint32_t, 5>(values, n);
+}
+
+void ByteArray::writeUint64Array(const uint64_t* values, size_t n) {
+    writeVarintArray<uint64_t, 10>(values, n);
+}
+
+void ByteArray::writeInt32Array(const int32_t* values, size_t n) {
+    uint32_t tmp[256];
+    for (size_t i = 0; i < n; i += 256) {
+        size_t cnt = std::min(n - i, (size_t)256);
+        for (size_t k = 0; k < cnt; ++k) {
+            tmp[k] = EncodeZigzag32(values[i + k]);
+        }
+        writeVarintArray<uint32_t, 5>(tmp, cnt);
+    }
+}
+
+void ByteArray::writeInt64Array(const int64_t* values, size_t n) {
+    uint64_t tmp[256];
+    for (size_t i = 0; i < n; i += 256) {
+        size_t cnt = std::min(n - i, (size_t)256);
+        for (size_t k = 0; k < cnt; ++k) {
+            tmp[k] = EncodeZigzag64(values[i + k]);
+        }
+        writeVarintArray<uint64_t, 10>(tmp, cnt);
+    }
+}
+
 void ByteArray::writeFloat(float value) {
     uint32_t v;
     memcpy(&v, &value, sizeof(value));
@@ -284,7 +520,7 @@ int64_t  ByteArray::readInt64() {
 
 uint64_t ByteArray::readUint64() {
     uint64_t result = 0;
-    for (int i = 0; i < 32; i += 7) {
+    for (int i = 0; i < 64; i += 7) {
         uint8_t b = readFuint8();
         if (b < 0x80) {
             result |= ((uint64_t)b) << i;       // b 先左移，再与 result 或运算
@@ -310,6 +546,29 @@ double ByteArray::readDouble() {
     return value;
 }
 
+void ByteArray::readUint32Array(uint32_t* values, size_t n) {
+    readVarintArray<uint32_t, 5>(values, n);
+}
+
+void ByteArray::readUint64Array(uint64_t* values, size_t n) {
+    readVarintArray<uint64_t, 10>(values, n);
+}
+
+void ByteArray::readInt32Array(int32_t* values, size_t n) {
+    // 原地解码后再还原 zigzag
+    readVarintArray<uint32_t, 5>((uint32_t*)values, n);
+    for (size_t i = 0; i < n; ++i) {
+        values[i] = DecodeZigzag32((uint32_t)values[i]);
+    }
+}
+
+void ByteArray::readInt64Array(int64_t* values, size_t n) {
+    readVarintArray<uint64_t, 10>((uint64_t*)values, n);
+    for (size_t i = 0; i < n; ++i) {
+        values[i] = DecodeZigzag64((uint64_t)values[i]);
+    }
+}
+
 // length: int16, data
 std::string ByteArray::readStringF16() {
     uint16_t len = readFuint16();  // 先读长度
@@ -349,15 +608,18 @@ std::string ByteArray::readStringVint() {
 // 内部操作
 void ByteArray::clear() {
     m_position = 0;
-    m_capacity = m_baseSize;
-    Node* tmp = m_root->next;
-    while (tmp) {
-        m_cur = tmp;
-        tmp = tmp->next;
-        delete m_cur;
+    m_size = 0;
+    ReleaseNodes(m_root->next);
+    m_root->next = NULL;
+    // 头节点是共享的、只读的或只是某个块的一段时不能再写入，换一个新的
+    if (m_root->chunk->isShared() || m_root->chunk->readonly
+            || m_root->size != m_root->chunk->size) {
+        delete m_root;
+        m_root = new Node(m_baseSize);
     }
+    m_capacity = m_root->size;
     m_cur = m_root;
-    m_root->next = NULL;
+    m_curBase = 0;
 }   
 
 void ByteArray::write(const void* buf, size_t size) {
@@ -366,14 +628,18 @@ void ByteArray::write(const void* buf, size_t size) {
     }
 
     addCapaticy(size);                      // 如有新增 Node, 改变 m_cur
-    size_t npos = m_position % m_baseSize;  // 当前 Node::ptr 块内偏移
+    size_t npos = m_position - m_curBase;   // 当前 Node::ptr 块内偏移
     size_t ncap = m_cur->size - npos;       // 当前节点的剩余容量 = 当前节点大小 - 块内偏移
     size_t bpos = 0;                        // buf 中已写入的位置
 
     while (size > 0) {
+        if (SYLAR_UNLIKELY(m_cur->chunk->readonly)) {
+            throw std::logic_error("write to readonly chunk");
+        }
         if (ncap >= size) {
             memcpy(m_cur->ptr + npos, (const char*)buf + bpos, size);
             if (m_cur->size == (npos + size)) {
+                m_curBase += m_cur->size;
                 m_cur = m_cur->next;
             }
             m_position += size;  // 后移
@@ -385,6 +651,7 @@ void ByteArray::write(const void* buf, size_t size) {
             bpos += ncap;
             size -= ncap;
 
+            m_curBase += m_cur->size;
             m_cur = m_cur->next;
             ncap = m_cur->size;
             npos = 0;
@@ -401,13 +668,14 @@ void ByteArray::read(void* buf, size_t size) {
         throw std::out_of_range("not enough length");
     }
 
-    size_t npos = m_position % m_baseSize;
+    size_t npos = m_position - m_curBase;
     size_t ncap = m_cur->size - npos;
     size_t bpos = 0;
     while (size > 0) {
         if (ncap >= size) {
             memcpy((char*)buf + bpos, m_cur->ptr + npos, size);
             if (m_cur->size == (npos + size)) {
+                m_curBase += m_cur->size;
                 m_cur = m_cur->next;
             }
             m_position += size;
@@ -419,6 +687,7 @@ void ByteArray::read(void* buf, size_t size) {
             bpos += ncap;
             size -= ncap;
 
+            m_curBase += m_cur->size;
             m_cur = m_cur->next;
             ncap = m_cur->size;
             npos = 0;
@@ -426,28 +695,23 @@ void ByteArray::read(void* buf, size_t size) {
     }
 }
 
-// 从当前位置读指定长度的数据， 不会改成员属性, toString() 调用
+// 从指定位置读指定长度的数据， 不会改成员属性, toString() 调用
 void ByteArray::read(void* buf, size_t size, size_t position) const {
-    if (size > getReadSize()) {
+    if (position > m_size || size > m_size - position) {
         throw std::out_of_range("not enough length");
     }
 
-    size_t npos = position % m_baseSize;
-    size_t ncap = m_cur->size - npos;
+    size_t npos = 0;
+    Node* cur = findNode(position, npos);
+    size_t ncap = size ? cur->size - npos : 0;
     size_t bpos = 0;
-    Node* cur = m_cur;
     while (size > 0) {
         if (ncap >= size) {
             memcpy((char*)buf + bpos, cur->ptr + npos, size);
-            if (cur->size == (npos + size)) {
-                cur = cur->next;
-            }
-            position += size;
             bpos += size;
             size = 0;
         } else {
             memcpy((char*)buf + bpos, cur->ptr + npos, ncap);
-            position += ncap;
             bpos += ncap;
             size -= ncap;
 
@@ -458,6 +722,22 @@ void ByteArray::read(void* buf, size_t size, size_t position) const {
     }
 }
 
+ByteArray::Node* ByteArray::findNode(size_t position, size_t& npos) const {
+    // 向后查找时从当前节点开始
+    Node* cur = m_root;
+    size_t base = 0;
+    if (m_cur && position >= m_curBase) {
+        cur = m_cur;
+        base = m_curBase;
+    }
+    while (cur && position >= base + cur->size) {
+        base += cur->size;
+        cur = cur->next;
+    }
+    npos = position - base;
+    return cur;
+}
+
 void ByteArray::setPosition(size_t v) {
     if (v > m_capacity) {
         throw std::out_of_range("set_position out of range");
@@ -466,15 +746,9 @@ void ByteArray::setPosition(size_t v) {
     if (m_position > m_size) {
         m_size = m_position;
     }
-    m_cur = m_root;
-    while (v > m_cur->size) {
-        v -= m_cur->size;
-        m_cur = m_cur->next;
-    }
-
-    if (v == m_cur->size) {
-        m_cur = m_cur->next;
-    }
+    size_t npos = 0;
+    m_cur = findNode(v, npos);
+    m_curBase = v - npos;
 }
 
 // 当前数据写到文件, 调用前先调用 setPosition()
@@ -486,17 +760,10 @@ bool ByteArray::writeToFile(const std::string& name) const {
             << " error, errno=" << errno << " errstr=" << strerror(errno);
         return false;
     }
-    int64_t read_size = getReadSize();
-    int64_t pos = m_position;  // 当前位置
-    Node* cur = m_cur;
-    while (read_size > 0) {
-        int diff = pos % m_baseSize;
-        int64_t len = (read_size > (int64_t)m_baseSize ? m_baseSize : read_size) - diff;  // 一次最多写入一个块
-
-        ofs.write(cur->ptr + diff, len);
-        cur = cur->next;
-        pos += len;
-        read_size -= len;
+    std::vector<iovec> iovs;
+    getReadBuffers(iovs, getReadSize());
+    for (auto& i : iovs) {
+        ofs.write((const char*)i.iov_base, i.iov_len);  // 一次写一个块
     }
     return true;
 }
@@ -547,12 +814,124 @@ void ByteArray::addCapaticy(size_t size) {
         m_capacity += m_baseSize;
     }
 
-    // 加完之后，如果当前节点的容量为0，还需后移一个节点
+    // 加完之后，如果当前节点的容量为0，还需后移一个节点, 此时 m_curBase 已等于 m_position
     if (old_cap == 0) {
         m_cur = first;  // 移动 m_cur 到新增的头节点
     }
 }
 
+static void UnmapChunk(char* data, size_t size) {
+    munmap(data, size);
+}
+
+ByteArray::ptr ByteArray::MapFile(const std::string& name, size_t base_size) {
+    int fd = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        SYLAR_LOG_ERROR(g_logger) << "MapFile open name=" << name
+            << " error, errno=" << errno << " errstr=" << strerror(errno);
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st)) {
+        SYLAR_LOG_ERROR(g_logger) << "MapFile fstat name=" << name
+            << " error, errno=" << errno << " errstr=" << strerror(errno);
+        close(fd);
+        return nullptr;
+    }
+
+    ByteArray::ptr ba(new ByteArray(base_size));
+    size_t size = st.st_size;
+    if (size == 0) {
+        close(fd);
+        return ba;      // 长度为 0 不能 mmap
+    }
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);      // 映射建立后不再需要 fd
+    if (addr == MAP_FAILED) {
+        SYLAR_LOG_ERROR(g_logger) << "MapFile mmap name=" << name << " size=" << size
+            << " error, errno=" << errno << " errstr=" << strerror(errno);
+        return nullptr;
+    }
+    madvise(addr, size, MADV_SEQUENTIAL);
+
+    // 整个映射作为一个只读节点
+    Chunk* chunk = new Chunk((char*)addr, size, UnmapChunk, true);
+    Node* node = new Node(chunk, chunk->data, size);
+    chunk->unref();     // 节点已持有引用
+    ReleaseNodes(ba->m_root);
+    ba->m_root = node;
+    ba->m_cur = node;
+    ba->m_curBase = 0;
+    ba->m_size = size;
+    ba->m_capacity = size;
+    return ba;
+}
+
+ByteArray::ptr ByteArray::slice(size_t position, size_t len) const {
+    if (position > m_size || len > m_size - position) {
+        throw std::out_of_range("slice out of range");
+    }
+    ByteArray::ptr ba(new ByteArray(m_baseSize));
+    ba->m_endian = m_endian;
+    ba->appendRange(*this, position, len);
+    return ba;
+}
+
+void ByteArray::appendShared(const ByteArray& other) {
+    appendRange(other, other.m_position, other.getReadSize());
+}
+
+void ByteArray::append(ByteArray&& other) {
+    // 先共享再清空 other, 内存块的引用就只剩本对象
+    appendShared(other);
+    other.clear();
+}
+
+void ByteArray::appendRange(const ByteArray& other, size_t position, size_t len) {
+    if (len == 0) {
+        return;
+    }
+
+    // 拷贝出共享节点链
+    Node* head = nullptr;
+    Node* tail = nullptr;
+    size_t npos = 0;
+    Node* cur = other.findNode(position, npos);
+    size_t left = len;
+    while (left > 0) {
+        size_t n = std::min(cur->size - npos, left);
+        Node* node = new Node(cur->chunk, cur->ptr + npos, n);
+        if (tail) {
+            tail->next = node;
+        } else {
+            head = node;
+        }
+        tail = node;
+        left -= n;
+        cur = cur->next;
+        npos = 0;
+    }
+
+    // 丢掉 m_size 之后未写入的容量，数据才能连续
+    Node* last = nullptr;
+    if (m_size == 0) {
+        ReleaseNodes(m_root);
+        m_root = head;
+    } else {
+        last = findNode(m_size - 1, npos);
+        ReleaseNodes(last->next);
+        last->size = npos + 1;
+        last->next = head;
+    }
+
+    if (m_position == m_size) {
+        m_cur = head;
+        m_curBase = m_size;
+    }
+    m_size += len;
+    m_capacity = m_size;
+}
+
 std::string ByteArray::toString() const{
     std::string str;
     str.resize(getReadSize());
@@ -585,7 +964,7 @@ uint64_t ByteArray::getReadBuffers(std::vector<iovec>& buffers, uint64_t len) co
     }
     uint64_t size = len;
 
-    size_t npos = m_position % m_baseSize;
+    size_t npos = m_position - m_curBase;
     size_t ncap = m_cur->size - npos;
     struct iovec iov;
     Node* cur = m_cur;
@@ -611,20 +990,17 @@ uint64_t ByteArray::getReadBuffers(std::vector<iovec>& buffers, uint64_t len) co
 
 // 从指定位置返回指定长度的数据
 uint64_t ByteArray::getReadBuffers(std::vector<iovec>& buffers, uint64_t len, uint64_t position) const {
-    len = len > getReadSize() ? getReadSize() : len;
+    if (position > m_size) {
+        return 0;
+    }
+    len = len > m_size - position ? m_size - position : len;
     if (len == 0) {
         return 0;
     }
     uint64_t size = len;
 
-    size_t npos = position % m_baseSize;
-    size_t count = position / m_baseSize;
-    Node* cur = m_root;
-    while (count > 0 && cur) {
-        cur = cur->next;
-        --count;
-    }
-
+    size_t npos = 0;
+    Node* cur = findNode(position, npos);
     size_t ncap = cur->size - npos;
     struct iovec iov;
     while (len > 0) {
@@ -652,9 +1028,12 @@ uint64_t ByteArray::getWriteBuffers(std::vector<iovec>& buffers, uint64_t len) {
     }
 
     addCapaticy(len);
+    if (SYLAR_UNLIKELY(m_cur->chunk->readonly)) {
+        throw std::logic_error("write to readonly chunk");
+    }
     uint64_t size = len;
     
-    size_t npos = m_position % m_baseSize;
+    size_t npos = m_position - m_curBase;
     size_t ncap = m_cur->size - npos;
     struct iovec iov;
     Node* cur = m_cur;
@@ -665,7 +1044,7 @@ uint64_t ByteArray::getWriteBuffers(std::vector<iovec>& buffers, uint64_t len) {
             len = 0;
         } else {
             iov.iov_base = cur->ptr + npos;
-            iov.iov_len = len;
+            iov.iov_len = ncap;
             len -= ncap;
 
             cur = cur->next;
@@ -677,4 +1056,39 @@ uint64_t ByteArray::getWriteBuffers(std::vector<iovec>& buffers, uint64_t len) {
     return size;
 }
 
-}
\ No newline at end of file
+std::vector<iovec>& ByteArray::getReadIovecs(uint64_t len) {
+    m_iovs.clear();     // 保留容量
+    getReadBuffers(m_iovs, len);
+    return m_iovs;
+}
+
+std::vector<iovec>& ByteArray::getWriteIovecs(uint64_t len) {
+    m_iovs.clear();
+    getWriteBuffers(m_iovs, len);
+    return m_iovs;
+}
+
+std::vector<iovec>& ByteArray::getWritableIovecs(uint64_t& size) {
+    m_iovs.clear();
+    size = getCapacity();
+    if (size == 0) {
+        return m_iovs;  // 此时 m_cur 可能为空
+    }
+    if (SYLAR_UNLIKELY(m_cur->chunk->readonly)) {
+        throw std::logic_error("write to readonly chunk");
+    }
+
+    size_t npos = m_position - m_curBase;
+    struct iovec iov;
+    iov.iov_base = m_cur->ptr + npos;
+    iov.iov_len = m_cur->size - npos;
+    m_iovs.push_back(iov);
+    for (Node* cur = m_cur->next; cur; cur = cur->next) {
+        iov.iov_base = cur->ptr;
+        iov.iov_len = cur->size;
+        m_iovs.push_back(iov);
+    }
+    return m_iovs;
+}
+
+}
@@ -7,6 +7,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <vector>
+#include <atomic>
 #include "noncopyable.h"
 
 namespace sylar {
@@ -15,15 +16,48 @@ class ByteArray : public NonCopyable{
 public:
     typedef std::shared_ptr<ByteArray> ptr;
 
-    // 链表节点
+    // 引用计数的内存块，可被多个 ByteArray 的节点共享
+    struct Chunk {
+        // 释放外部内存
+        typedef void (*Releaser)(char* data, size_t size);
+
+        Chunk(size_t s);
+        // 引用外部内存, 引用计数归零时调用 releaser, readonly 的块不允许写入
+        Chunk(char* d, size_t s, Releaser r, bool ro);
+        ~Chunk();
+
+        void ref() { refs.fetch_add(1, std::memory_order_relaxed);}
+        void unref() {
+            if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete this;
+            }
+        }
+        bool isShared() const { return refs.load(std::memory_order_acquire) > 1;}
+
+        static void* operator new(size_t size);
+        static void operator delete(void* p, size_t size);
+
+        std::atomic<int> refs;
+        char* data;         // 内存块地址
+        size_t size;        // 内存块大小
+        Releaser releaser;  // 为空时归还 BufferPool
+        bool readonly;      // 只读
+    };
+
+    // 链表节点, 引用 chunk 中的 [ptr, ptr + size), 节点大小不一定等于 base_size
     struct Node {
         Node();
         Node(size_t s);
+        Node(Chunk* c, char* p, size_t s);  // 共享 c 的一段，增加引用计数
         ~Node();
 
+        static void* operator new(size_t size);
+        static void operator delete(void* p, size_t size);
+
         char* ptr;      // 内存块地址
         Node* next;     // 下一个内存块
         size_t size;    // 内存块大小
+        Chunk* chunk;   // 所属内存块
     };
     
     ByteArray(size_t base_size = 4096);  // 链表每个节点默认 4K
@@ -58,6 +92,12 @@ public:
     void writeStringWithoutLength(const std::string& value);    // 压缩长度表示
 
 
+    // 批量可变长编码, 直接编码进节点内存; 结果与逐个调用 writeUint32 等相同
+    void writeUint32Array(const uint32_t* values, size_t n);
+    void writeUint64Array(const uint64_t* values, size_t n);
+    void writeInt32Array(const int32_t* values, size_t n);      // zigzag
+    void writeInt64Array(const int64_t* values, size_t n);      // zigzag
+
     // read  
     int8_t   readFint8();
     uint8_t  readFuint8();
@@ -76,6 +116,12 @@ public:
     float  readFloat();
     double readDouble();
 
+    // 批量可变长解码, 数据不足时抛出 std::out_of_range
+    void readUint32Array(uint32_t* values, size_t n);
+    void readUint64Array(uint64_t* values, size_t n);
+    void readInt32Array(int32_t* values, size_t n);
+    void readInt64Array(int64_t* values, size_t n);
+
     // length: int16, data
     std::string readStringF16();
     // length: int32, data
@@ -100,6 +146,14 @@ public:
     bool writeToFile(const std::string& name) const;
     bool readFromFile(const std::string& name);
 
+    /**
+     * 只读映射整个文件 (mmap), 不拷贝到堆上的节点, 读接口与 getReadBuffers 照常使用
+     * 映射部分不可写入 (抛出 std::logic_error), 在末尾继续写入会追加普通节点
+     * 映射期间文件被截断时访问会产生 SIGBUS
+     * 失败返回 nullptr
+     */
+    static ByteArray::ptr MapFile(const std::string& name, size_t base_size = 4096);
+
     size_t getBaseSize() const { return  m_baseSize;}
     size_t getReadSize() const { return  m_size - m_position;}  // 剩余可读数据
     bool isLittleEndian() const;
@@ -114,10 +168,38 @@ public:
     // 增加容量，不修改 position
     uint64_t getWriteBuffers(std::vector<iovec>& buffers, uint64_t len);
 
+    // 以下三个复用内部的 iovec 缓存，稳定后不再分配内存
+    // 返回的引用在下一次调用或 ByteArray 被修改之前有效
+    std::vector<iovec>& getReadIovecs(uint64_t len = ~0ull);
+    std::vector<iovec>& getWriteIovecs(uint64_t len);
+    // 当前已分配但未写入的空间，不扩容, size 返回总长度
+    std::vector<iovec>& getWritableIovecs(uint64_t& size);
+
     size_t getSize() const { return m_size;}
+    // 保证从当前位置起至少有 size 字节可写，不修改 position
+    void reserve(size_t size) { addCapaticy(size);}
+
+    /**
+     * 零拷贝接口: 只增加内存块的引用计数，不拷贝数据
+     * 共享的内存块不应再被改写 (setPosition 回退后 write 会影响其他持有者)
+     */
+    // [position, position + len) 的切片, 切片的 position 为 0
+    ByteArray::ptr slice(size_t position, size_t len) const;
+    // 把 other 的可读数据 [position, size) 追加到数据末尾，不修改本对象的 position
+    void appendShared(const ByteArray& other);
+    // 同 appendShared, 之后 other 被清空
+    void append(ByteArray&& other);
 private:
     void addCapaticy(size_t size);
     size_t getCapacity() const { return m_capacity - m_position;}
+    // position 所在节点及节点内偏移, position 等于容量时返回 nullptr
+    Node* findNode(size_t position, size_t& npos) const;
+    void appendRange(const ByteArray& other, size_t position, size_t len);
+
+    template<class T, int MaxBytes>
+    void writeVarintArray(const T* values, size_t n);
+    template<class T, int MaxBytes>
+    void readVarintArray(T* values, size_t n);
 
 private:
     size_t m_baseSize;  // Node 大小
@@ -128,6 +210,9 @@ private:
     int8_t m_endian;
     Node* m_root;       // 链表 head
     Node* m_cur;        // 当前节点
+    size_t m_curBase;   // 当前节点起始位置
+
+    std::vector<iovec> m_iovs;  // iovec 缓存
 
 };
 
@@ -0,0 +1,593 @@
+#include "dns.h"
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <string.h>
+#include "config.h"
+#include "endian.h"
+#include "hook.h"
+#include "iomanager.h"
+#include "log.h"
+#include "socket.h"
+#include "util.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<bool>::ptr g_dns_enable =
+    sylar::Config::Lookup("dns.enable", true, "use fiber dns resolver in Address::Lookup");
+
+static sylar::ConfigVar<std::vector<std::string>>::ptr g_dns_nameservers =
+    sylar::Config::Lookup("dns.nameservers", std::vector<std::string>(), "dns nameservers, empty for /etc/resolv.conf");
+
+static sylar::ConfigVar<uint32_t>::ptr g_dns_timeout =
+    sylar::Config::Lookup("dns.timeout", (uint32_t)2000, "dns query timeout ms per nameserver");
+
+static sylar::ConfigVar<uint32_t>::ptr g_dns_attempts =
+    sylar::Config::Lookup("dns.attempts", (uint32_t)2, "dns query attempts per nameserver");
+
+static sylar::ConfigVar<uint32_t>::ptr g_dns_negative_ttl =
+    sylar::Config::Lookup("dns.negative_ttl", (uint32_t)30, "dns negative cache ttl seconds (no SOA)");
+
+static sylar::ConfigVar<uint32_t>::ptr g_dns_max_ttl =
+    sylar::Config::Lookup("dns.max_ttl", (uint32_t)3600, "dns cache max ttl seconds");
+
+static sylar::ConfigVar<uint32_t>::ptr g_dns_cache_max_size =
+    sylar::Config::Lookup("dns.cache.max_size", (uint32_t)10000, "dns cache max entries");
+
+static const char* s_resolv_conf = "/etc/resolv.conf";
+static const char* s_hosts_file = "/etc/hosts";
+
+static const uint16_t DNS_FLAG_QR = 0x8000;    // 应答
+static const uint16_t DNS_FLAG_TC = 0x0200;    // 截断
+static const uint16_t DNS_FLAG_RD = 0x0100;    // 期望递归
+static const uint16_t DNS_RCODE_NXDOMAIN = 3;
+static const uint16_t DNS_TYPE_SOA = 6;
+static const uint16_t DNS_CLASS_IN = 1;
+
+namespace {
+
+// 应答解析状态，MISMATCH 表示不是本次查询的应答，继续接收
+enum ParseResult {
+    PARSE_OK,
+    PARSE_NOT_FOUND,
+    PARSE_ERROR,
+    PARSE_MISMATCH
+};
+
+struct DnsHeader {
+    uint16_t id;
+    uint16_t flags;
+    uint16_t qdcount;
+    uint16_t ancount;
+    uint16_t nscount;
+    uint16_t arcount;
+};
+
+uint16_t ReadU16(const uint8_t* p) {
+    return ((uint16_t)p[0] << 8) | p[1];
+}
+
+uint32_t ReadU32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+            | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// 跳过 (可能被压缩的) 域名，返回新的偏移，出错返回 -1
+int SkipName(const uint8_t* data, int len, int pos) {
+    while (pos < len) {
+        uint8_t l = data[pos];
+        if ((l & 0xC0) == 0xC0) {
+            return pos + 2 <= len ? pos + 2 : -1;
+        }
+        if (l == 0) {
+            return pos + 1;
+        }
+        pos += l + 1;
+    }
+    return -1;
+}
+
+// 构造查询报文，域名不合法返回 false
+bool BuildQuery(std::string& out, uint16_t id, const std::string& name, uint16_t qtype) {
+    DnsHeader head;
+    head.id = byteswapOnLittleEndian(id);
+    head.flags = byteswapOnLittleEndian(DNS_FLAG_RD);
+    head.qdcount = byteswapOnLittleEndian((uint16_t)1);
+    head.ancount = 0;
+    head.nscount = 0;
+    head.arcount = 0;
+    out.assign((const char*)&head, sizeof(head));
+
+    // www.sylar.top -> 3www5sylar3top0
+    size_t begin = 0;
+    while (begin < name.size()) {
+        size_t end = name.find('.', begin);
+        if (end == std::string::npos) {
+            end = name.size();
+        }
+        size_t label_len = end - begin;
+        if (label_len == 0 || label_len > 63) {
+            return false;
+        }
+        out.push_back((char)label_len);
+        out.append(name, begin, label_len);
+        begin = end + 1;
+    }
+    out.push_back('\0');
+    if (out.size() - sizeof(head) > 255) {
+        return false;
+    }
+
+    uint16_t tail[2] = {byteswapOnLittleEndian(qtype), byteswapOnLittleEndian(DNS_CLASS_IN)};
+    out.append((const char*)tail, sizeof(tail));
+    return true;
+}
+
+ParseResult ParseResponse(const uint8_t* data, int len, uint16_t id, uint16_t qtype
+        , std::vector<IPAddress::ptr>& result, uint32_t& ttl) {
+    if (len < (int)sizeof(DnsHeader)) {
+        return PARSE_MISMATCH;
+    }
+    if (ReadU16(data) != id) {
+        return PARSE_MISMATCH;
+    }
+    uint16_t flags = ReadU16(data + 2);
+    if (!(flags & DNS_FLAG_QR)) {
+        return PARSE_MISMATCH;
+    }
+    uint16_t qdcount = ReadU16(data + 4);
+    uint16_t ancount = ReadU16(data + 6);
+    uint16_t nscount = ReadU16(data + 8);
+    uint16_t rcode = flags & 0x0F;
+
+    int pos = sizeof(DnsHeader);
+    for (uint16_t i = 0; i < qdcount; ++i) {
+        pos = SkipName(data, len, pos);
+        if (pos < 0 || pos + 4 > len) {
+            return PARSE_ERROR;
+        }
+        pos += 4;   // qtype + qclass
+    }
+
+    if (rcode != 0 && rcode != DNS_RCODE_NXDOMAIN) {
+        return PARSE_ERROR;     // SERVFAIL, REFUSED 等，换下一个 nameserver
+    }
+
+    ttl = ~0u;
+    for (uint16_t i = 0; i < ancount; ++i) {
+        pos = SkipName(data, len, pos);
+        if (pos < 0 || pos + 10 > len) {
+            return PARSE_ERROR;
+        }
+        uint16_t type = ReadU16(data + pos);
+        uint16_t klass = ReadU16(data + pos + 2);
+        uint32_t rttl = ReadU32(data + pos + 4);
+        uint16_t rdlen = ReadU16(data + pos + 8);
+        pos += 10;
+        if (pos + rdlen > len) {
+            return PARSE_ERROR;
+        }
+        // CNAME 链上的每条记录都会影响结果的有效期
+        ttl = std::min(ttl, rttl);
+        if (klass == DNS_CLASS_IN && type == qtype) {
+            if (type == DnsResolver::A && rdlen == 4) {
+                uint32_t addr;
+                memcpy(&addr, data + pos, sizeof(addr));
+                result.push_back(std::make_shared<IPv4Address>(byteswapOnLittleEndian(addr)));
+            } else if (type == DnsResolver::AAAA && rdlen == 16) {
+                result.push_back(std::make_shared<IPv6Address>(data + pos));
+            }
+        }
+        pos += rdlen;
+    }
+
+    if (!result.empty()) {
+        return PARSE_OK;
+    }
+
+    if (flags & DNS_FLAG_TC) {
+        return PARSE_ERROR;     // 截断且没有可用记录，交给 getaddrinfo (TCP)
+    }
+
+    // 负向应答: TTL 取 authority 中 SOA 的 min(ttl, minimum), RFC 2308
+    ttl = ~0u;
+    for (uint16_t i = 0; i < nscount; ++i) {
+        pos = SkipName(data, len, pos);
+        if (pos < 0 || pos + 10 > len) {
+            break;
+        }
+        uint16_t type = ReadU16(data + pos);
+        uint32_t rttl = ReadU32(data + pos + 4);
+        uint16_t rdlen = ReadU16(data + pos + 8);
+        pos += 10;
+        if (pos + rdlen > len) {
+            break;
+        }
+        if (type == DNS_TYPE_SOA) {
+            int rpos = SkipName(data, pos + rdlen, pos);        // mname
+            if (rpos > 0) {
+                rpos = SkipName(data, pos + rdlen, rpos);       // rname
+            }
+            if (rpos > 0 && rpos + 20 <= pos + rdlen) {
+                uint32_t minimum = ReadU32(data + rpos + 16);
+                ttl = std::min(rttl, minimum);
+            }
+        }
+        pos += rdlen;
+    }
+    return PARSE_NOT_FOUND;
+}
+
+uint16_t NextQueryId() {
+    static thread_local std::mt19937 s_rng(sylar::GetCurretUS() ^ sylar::GetThreadId());
+    return (uint16_t)s_rng();
+}
+
+// 缓存中的地址是共享的，返回给调用方的必须是副本 (调用方会 setPort)
+void AppendCopy(std::vector<IPAddress::ptr>& result, const std::vector<IPAddress::ptr>& addrs) {
+    for (auto& addr : addrs) {
+        result.push_back(std::dynamic_pointer_cast<IPAddress>(
+                Address::Create(addr->getAddr(), addr->getAddrLen())));
+    }
+}
+
+bool IsInFiber() {
+    return sylar::IOManager::GetThis() && sylar::is_hook_enable();
+}
+
+}
+
+DnsResolver::DnsResolver() {
+    loadHosts();
+    loadResolvConf();
+
+    g_dns_nameservers->addListener([this](const std::vector<std::string>& old_value
+                , const std::vector<std::string>& new_value){
+        SYLAR_LOG_INFO(g_logger) << "dns.nameservers changed";
+        loadResolvConf();
+    });
+}
+
+const char* DnsResolver::StatusToString(Status s) {
+    switch (s) {
+#define XX(name) \
+        case name: \
+            return #name;
+        XX(OK);
+        XX(NOT_FOUND);
+        XX(TIMEOUT);
+        XX(ERROR);
+        XX(UNAVAILABLE);
+#undef XX
+        default:
+            return "UNKNOWN";
+    }
+}
+
+void DnsResolver::setNameservers(const std::vector<Address::ptr>& v) {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_nameservers = v;
+    m_userNameservers = true;
+    m_cache.clear();
+}
+
+std::vector<Address::ptr> DnsResolver::getNameservers() {
+    RWMutexType::ReadLock lock(m_mutex);
+    return m_nameservers;
+}
+
+void DnsResolver::clearCache() {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_cache.clear();
+}
+
+size_t DnsResolver::getCacheSize() {
+    RWMutexType::ReadLock lock(m_mutex);
+    return m_cache.size();
+}
+
+bool DnsResolver::isAvailable() {
+    if (!g_dns_enable->getValue() || !IsInFiber()) {
+        return false;
+    }
+    RWMutexType::ReadLock lock(m_mutex);
+    return !m_nameservers.empty();
+}
+
+// 配置优先，其次 /etc/resolv.conf 中的 nameserver
+void DnsResolver::loadResolvConf() {
+    std::vector<std::string> servers = g_dns_nameservers->getValue();
+    if (servers.empty()) {
+        std::ifstream ifs(s_resolv_conf);
+        std::string line;
+        while (std::getline(ifs, line)) {
+            std::stringstream ss(line);
+            std::string key, value;
+            ss >> key >> value;
+            if (key == "nameserver" && !value.empty()) {
+                servers.push_back(value);
+            }
+        }
+    }
+
+    std::vector<Address::ptr> addrs;
+    for (auto& server : servers) {
+        std::string host = server;
+        uint16_t port = 53;
+        // 1.2.3.4:5353 或 [::1]:5353
+        if (!host.empty() && host[0] == '[') {
+            size_t end = host.find(']');
+            if (end == std::string::npos) {
+                continue;
+            }
+            if (end + 1 < host.size() && host[end + 1] == ':') {
+                port = atoi(host.c_str() + end + 2);
+            }
+            host = host.substr(1, end - 1);
+        } else if (std::count(host.begin(), host.end(), ':') == 1) {
+            size_t pos = host.find(':');
+            port = atoi(host.c_str() + pos + 1);
+            host = host.substr(0, pos);
+        }
+        size_t scope = host.find('%');      // fe80::1%eth0
+        if (scope != std::string::npos) {
+            host = host.substr(0, scope);
+        }
+        IPAddress::ptr addr = IPAddress::Create(host.c_str(), port);
+        if (!addr) {
+            SYLAR_LOG_WARN(g_logger) << "invalid dns nameserver: " << server;
+            continue;
+        }
+        addrs.push_back(addr);
+    }
+
+    RWMutexType::WriteLock lock(m_mutex);
+    if (!m_userNameservers) {
+        m_nameservers.swap(addrs);
+    }
+}
+
+void DnsResolver::loadHosts() {
+    std::ifstream ifs(s_hosts_file);
+    std::string line;
+    while (std::getline(ifs, line)) {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.resize(comment);
+        }
+        std::stringstream ss(line);
+        std::string ip;
+        if (!(ss >> ip)) {
+            continue;
+        }
+        IPAddress::ptr addr = IPAddress::Create(ip.c_str());
+        if (!addr) {
+            continue;
+        }
+        std::string name;
+        while (ss >> name) {
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            m_hosts[name].push_back(addr);
+        }
+    }
+}
+
+bool DnsResolver::lookupHosts(std::vector<IPAddress::ptr>& result, const std::string& name, int family) {
+    auto it = m_hosts.find(name);
+    if (it == m_hosts.end()) {
+        return false;
+    }
+    std::vector<IPAddress::ptr> addrs;
+    for (auto& addr : it->second) {
+        if (family == AF_UNSPEC || addr->getFamily() == family) {
+            addrs.push_back(addr);
+        }
+    }
+    AppendCopy(result, addrs);
+    return !addrs.empty();
+}
+
+DnsResolver::Status DnsResolver::lookup(std::vector<IPAddress::ptr>& result, const std::string& name, int family) {
+    if (!isAvailable()) {
+        return UNAVAILABLE;
+    }
+    std::string lname = name;
+    std::transform(lname.begin(), lname.end(), lname.begin(), ::tolower);
+    if (!lname.empty() && lname.back() == '.') {
+        lname.pop_back();
+    }
+    if (lname.empty()) {
+        return NOT_FOUND;
+    }
+
+    if (lookupHosts(result, lname, family)) {
+        return OK;
+    }
+    // 单标签域名需要 search 域补全，交给 getaddrinfo
+    if (lname.find('.') == std::string::npos) {
+        return UNAVAILABLE;
+    }
+
+    Status status = NOT_FOUND;
+    if (family == AF_INET || family == AF_UNSPEC) {
+        status = resolve(result, lname, A);
+    }
+    if (family == AF_INET6 || family == AF_UNSPEC) {
+        Status s6 = resolve(result, lname, AAAA);
+        if (family == AF_INET6 || status != OK) {
+            status = s6;
+        }
+    }
+    if (!result.empty()) {
+        return OK;
+    }
+    return status;
+}
+
+DnsResolver::Status DnsResolver::resolve(std::vector<IPAddress::ptr>& result, const std::string& name, QType qtype) {
+    std::string key = std::to_string((int)qtype) + ":" + name;
+    uint64_t now = sylar::GetCurretMS();
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        auto it = m_cache.find(key);
+        if (it != m_cache.end() && it->second.expire > now) {
+            AppendCopy(result, it->second.addrs);
+            return it->second.status;
+        }
+    }
+
+    Pending::ptr pending;
+    bool owner = false;
+    {
+        MutexType::Lock lock(m_pendingMutex);
+        auto it = m_pendings.find(key);
+        if (it != m_pendings.end()) {
+            pending = it->second;
+        } else {
+            pending = std::make_shared<Pending>();
+            m_pendings[key] = pending;
+            owner = true;
+        }
+    }
+
+    if (!owner) {
+        // 相同查询已在进行，挂起等待其结果
+        MutexType::Lock lock(pending->mutex);
+        if (!pending->done) {
+            pending->waiters.push_back(std::make_pair(Scheduler::GetThis(), Fiber::GetThis()));
+            lock.unlock();
+            Fiber::YieldToHold();
+            lock.lock();
+        }
+        AppendCopy(result, pending->addrs);
+        return pending->status;
+    }
+
+    std::vector<IPAddress::ptr> addrs;
+    uint32_t ttl = 0;
+    Status status = query(addrs, ttl, name, qtype);
+
+    if (status == OK || status == NOT_FOUND) {
+        uint32_t max_ttl = g_dns_max_ttl->getValue();
+        if (status == NOT_FOUND && ttl == ~0u) {
+            ttl = g_dns_negative_ttl->getValue();
+        }
+        ttl = std::min(ttl, max_ttl);
+        if (ttl > 0) {
+            CacheEntry entry;
+            entry.addrs = addrs;
+            entry.status = status;
+            entry.expire = sylar::GetCurretMS() + ttl * 1000ull;
+
+            RWMutexType::WriteLock lock(m_mutex);
+            size_t max_size = g_dns_cache_max_size->getValue();
+            if (m_cache.size() >= max_size) {
+                for (auto it = m_cache.begin(); it != m_cache.end();) {
+                    if (it->second.expire <= now) {
+                        m_cache.erase(it++);
+                    } else {
+                        ++it;
+                    }
+                }
+                while (!m_cache.empty() && m_cache.size() >= max_size) {
+                    m_cache.erase(m_cache.begin());
+                }
+            }
+            m_cache[key] = entry;
+        }
+    }
+
+    std::list<std::pair<Scheduler*, Fiber::ptr>> waiters;
+    {
+        MutexType::Lock lock(pending->mutex);
+        pending->done = true;
+        pending->status = status;
+        pending->addrs = addrs;
+        waiters.swap(pending->waiters);
+    }
+    {
+        MutexType::Lock lock(m_pendingMutex);
+        m_pendings.erase(key);
+    }
+    for (auto& waiter : waiters) {
+        waiter.first->schedule(waiter.second);
+    }
+
+    AppendCopy(result, addrs);
+    return status;
+}
+
+DnsResolver::Status DnsResolver::query(std::vector<IPAddress::ptr>& result, uint32_t& ttl
+        , const std::string& name, QType qtype) {
+    std::vector<Address::ptr> servers = getNameservers();
+    if (servers.empty()) {
+        return UNAVAILABLE;
+    }
+
+    Status status = ERROR;
+    uint32_t attempts = std::max(g_dns_attempts->getValue(), (uint32_t)1);
+    for (uint32_t i = 0; i < attempts; ++i) {
+        for (auto& server : servers) {
+            status = queryServer(server, result, ttl, name, qtype);
+            if (status == OK || status == NOT_FOUND) {
+                return status;
+            }
+            SYLAR_LOG_DEBUG(g_logger) << "dns query name=" << name << " type=" << qtype
+                    << " server=" << *server << " status=" << StatusToString(status);
+        }
+    }
+    return status;
+}
+
+DnsResolver::Status DnsResolver::queryServer(Address::ptr server, std::vector<IPAddress::ptr>& result
+        , uint32_t& ttl, const std::string& name, QType qtype) {
+    uint16_t id = NextQueryId();
+    std::string req;
+    if (!BuildQuery(req, id, name, qtype)) {
+        return NOT_FOUND;
+    }
+
+    // connect 后只接收该 nameserver 的应答
+    Socket::ptr sock = Socket::CreateUDP(server);
+    if (!sock->connect(server)) {
+        return ERROR;
+    }
+    if (sock->send(req.c_str(), req.size()) != (int)req.size()) {
+        SYLAR_LOG_DEBUG(g_logger) << "dns send to " << *server << " errno=" << errno
+                << " errstr=" << strerror(errno);
+        return ERROR;
+    }
+
+    uint64_t timeout = g_dns_timeout->getValue();
+    uint64_t deadline = sylar::GetCurretMS() + timeout;
+    uint8_t buf[4096];
+    while (true) {
+        uint64_t now = sylar::GetCurretMS();
+        if (now >= deadline) {
+            return TIMEOUT;
+        }
+        sock->setRecvTimeout(deadline - now);
+        int rt = sock->recv(buf, sizeof(buf));
+        if (rt < 0) {
+            return errno == ETIMEDOUT ? TIMEOUT : ERROR;
+        }
+        std::vector<IPAddress::ptr> addrs;
+        switch (ParseResponse(buf, rt, id, qtype, addrs, ttl)) {
+            case PARSE_OK:
+                result.insert(result.end(), addrs.begin(), addrs.end());
+                return OK;
+            case PARSE_NOT_FOUND:
+                return NOT_FOUND;
+            case PARSE_ERROR:
+                return ERROR;
+            case PARSE_MISMATCH:
+                break;
+        }
+    }
+    return ERROR;
+}
+
+}
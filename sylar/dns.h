@@ -0,0 +1,103 @@
+#ifndef __SYLAR_DNS_H__
+#define __SYLAR_DNS_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include "address.h"
+#include "mutex.h"
+#include "singleton.h"
+#include "noncopyable.h"
+
+namespace sylar {
+
+class Scheduler;
+
+/**
+ * 协程版 DNS 解析器
+ * 通过 hook 后的 UDP socket 向 nameserver 发起查询，等待应答期间让出协程，不阻塞工作线程
+ * 1. 正向/负向缓存，按应答中的 TTL 过期
+ * 2. 相同 (name, type) 的并发查询只发一次，其余协程挂起等待结果
+ */
+class DnsResolver : NonCopyable {
+public:
+    typedef std::shared_ptr<DnsResolver> ptr;
+    typedef RWMutex RWMutexType;
+    typedef Mutex MutexType;
+
+    enum QType {
+        A = 1,
+        AAAA = 28
+    };
+
+    enum Status {
+        OK = 0,             // 解析成功
+        NOT_FOUND = 1,      // 域名不存在或无该类型记录 (可缓存)
+        TIMEOUT = 2,        // 所有 nameserver 均超时
+        ERROR = 3,          // 应答异常、socket 错误等
+        UNAVAILABLE = 4     // 无可用 nameserver 或不在协程环境，调用方应回退到 getaddrinfo
+    };
+
+    DnsResolver();
+
+    /**
+     * 解析域名，结果中的端口均为 0
+     * family: AF_INET 查 A，AF_INET6 查 AAAA，AF_UNSPEC 两者都查
+     */
+    Status lookup(std::vector<IPAddress::ptr>& result, const std::string& name, int family = AF_INET);
+
+    // 指定 nameserver，为空时读取 /etc/resolv.conf
+    void setNameservers(const std::vector<Address::ptr>& v);
+    std::vector<Address::ptr> getNameservers();
+
+    void clearCache();
+    size_t getCacheSize();
+
+    // 是否可以在当前上下文中使用 (处于 IOManager 协程中且有 nameserver)
+    bool isAvailable();
+
+    static const char* StatusToString(Status s);
+private:
+    struct CacheEntry {
+        std::vector<IPAddress::ptr> addrs;
+        uint64_t expire = 0;    // 过期时间 ms
+        Status status = OK;     // OK 或 NOT_FOUND
+    };
+
+    // 正在进行的查询，后来的相同查询挂在 waiters 上
+    struct Pending {
+        typedef std::shared_ptr<Pending> ptr;
+        MutexType mutex;
+        bool done = false;
+        Status status = ERROR;
+        std::vector<IPAddress::ptr> addrs;
+        std::list<std::pair<Scheduler*, Fiber::ptr>> waiters;
+    };
+
+    Status resolve(std::vector<IPAddress::ptr>& result, const std::string& name, QType qtype);
+    Status query(std::vector<IPAddress::ptr>& result, uint32_t& ttl, const std::string& name, QType qtype);
+    Status queryServer(Address::ptr server, std::vector<IPAddress::ptr>& result, uint32_t& ttl
+            , const std::string& name, QType qtype);
+
+    bool lookupHosts(std::vector<IPAddress::ptr>& result, const std::string& name, int family);
+    void loadResolvConf();
+    void loadHosts();
+private:
+    RWMutexType m_mutex;
+    std::vector<Address::ptr> m_nameservers;
+    bool m_userNameservers = false;                             // 是否通过 setNameservers 指定
+    std::map<std::string, std::vector<IPAddress::ptr>> m_hosts; // /etc/hosts
+    std::unordered_map<std::string, CacheEntry> m_cache;        // "type:name" -> 结果
+
+    MutexType m_pendingMutex;
+    std::unordered_map<std::string, Pending::ptr> m_pendings;   // "type:name" -> 进行中的查询
+};
+
+typedef sylar::Singleton<DnsResolver> DnsResolverMgr;
+
+}
+
+#endif  // __SYLAR_DNS_H__
@@ -2,21 +2,21 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <sched.h>
 #include "hook.h"
+#include "macro.h"
 
 namespace sylar {
 
-FdCtx::FdCtx(int fd) 
+FdCtx::FdCtx() 
         :m_isInit(false)
         ,m_isSocket(false)
         ,m_sysNonblock(false)
         ,m_userNonblock(false)
         ,m_isClosed(false)
-        ,m_fd(fd)
+        ,m_fd(-1)
         ,m_recvTimeout(-1)
         ,m_sendTimeout(-1) {
-    
-    init();
 }
 
 FdCtx::~FdCtx() {
@@ -53,6 +53,16 @@ bool FdCtx::init() {
     return m_isInit;
 }
 
+void FdCtx::reset(int fd) {
+    m_fd = fd;
+    m_isInit = false;
+    m_isSocket = false;
+    m_sysNonblock = false;
+    m_userNonblock = false;
+    m_isClosed = false;
+    init();
+}
+
 void FdCtx::setTimeout(int type, uint64_t v) {
     if (type == SO_RCVTIMEO) {
         m_recvTimeout = v;
@@ -70,42 +80,80 @@ uint64_t FdCtx::getTimeout(int type) {
 }
 
 FdManager::FdManager() {
-    m_data.resize(64);
+    for (int i = 0; i < MAX_SEGMENTS; ++i) {
+        m_segments[i].store(nullptr, std::memory_order_relaxed);
+    }
 }
 
-FdCtx::ptr FdManager::get(int fd, bool auto_create) {
-    if (fd == -1) {
+FdManager::~FdManager() {
+    for (int i = 0; i < MAX_SEGMENTS; ++i) {
+        delete [] m_segments[i].load(std::memory_order_relaxed);
+    }
+}
+
+FdManager::Slot* FdManager::getSegment(int idx, bool auto_create) {
+    Slot* seg = m_segments[idx].load(std::memory_order_acquire);
+    if (SYLAR_LIKELY(seg) || !auto_create) {
+        return seg;
+    }
+
+    // 多个线程同时分配同一段时，只有一个能装上，其余的释放掉自己的
+    Slot* new_seg = new Slot[SEGMENT_SIZE];
+    if (m_segments[idx].compare_exchange_strong(seg, new_seg
+                , std::memory_order_acq_rel, std::memory_order_acquire)) {
+        return new_seg;
+    }
+    delete [] new_seg;
+    return seg;
+}
+
+FdCtx* FdManager::get(int fd, bool auto_create) {
+    if (SYLAR_UNLIKELY(fd < 0 || fd >= MAX_SEGMENTS * SEGMENT_SIZE)) {
         return nullptr;
     }
 
-    RWMuteType::ReadLock rd_lock(m_mutex);
-    if ((int)m_data.size() <= fd) {
-        if (!auto_create) {
-            return nullptr;
-        }
-    } else {
-        if (m_data[fd] || !auto_create) {
-            return m_data[fd];
-        }
+    Slot* seg = getSegment(fd >> SEGMENT_SHIFT, auto_create);
+    if (!seg) {
+        return nullptr;
+    }
+    Slot& slot = seg[fd & SEGMENT_MASK];
+    int state = slot.state.load(std::memory_order_acquire);
+    if (SYLAR_LIKELY(state == READY)) {
+        return &slot.ctx;
+    }
+    if (!auto_create) {
+        return nullptr;
     }
-    rd_lock.unlock();
 
-    RWMuteType::WriteLock wt_lock(m_mutex);
-    FdCtx::ptr ctx(new FdCtx(fd));
-    if (fd >= (int)m_data.size()) {
-        m_data.resize(fd * 1.5);
+    while (true) {
+        if (state == EMPTY) {
+            if (slot.state.compare_exchange_weak(state, INITING
+                        , std::memory_order_acquire, std::memory_order_acquire)) {
+                slot.ctx.reset(fd);
+                slot.state.store(READY, std::memory_order_release);
+                return &slot.ctx;
+            }
+        } else if (state == READY) {
+            return &slot.ctx;
+        } else {
+            // 其他线程正在初始化，初始化只有一次 fstat/fcntl，很快结束
+            sched_yield();
+            state = slot.state.load(std::memory_order_acquire);
+        }
     }
-    m_data[fd] = ctx;
-    return ctx;
 }
 
 void FdManager::del(int fd) {
-    RWMuteType::WriteLock lock(m_mutex);
-    if ((int)m_data.size() <= fd) {
+    if (fd < 0 || fd >= MAX_SEGMENTS * SEGMENT_SIZE) {
         return;
     }
-    m_data[fd].reset();
-
+    Slot* seg = getSegment(fd >> SEGMENT_SHIFT, false);
+    if (!seg) {
+        return;
+    }
+    int state = READY;
+    seg[fd & SEGMENT_MASK].state.compare_exchange_strong(state, EMPTY
+            , std::memory_order_release, std::memory_order_relaxed);
 }
 
-}
\ No newline at end of file
+}
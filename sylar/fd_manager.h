@@ -3,19 +3,19 @@
 
 #include <memory>
 #include <vector>
+#include <atomic>
 #include "thread.h"
 #include "iomanager.h"
 #include "singleton.h"
+#include "noncopyable.h"
 
 namespace sylar {
 
 // 文件句柄上下文
-class FdCtx : public std::enable_shared_from_this<FdCtx> {
+// 存放在 FdManager 的分段数组中，地址在进程生命周期内不变，以裸指针访问
+class FdCtx : NonCopyable {
 public:
-    typedef std::shared_ptr<FdCtx> ptr;
-    // typedef MutexType;
-
-    FdCtx(int fd);
+    FdCtx();
     ~FdCtx();
 
     bool init();
@@ -33,6 +33,11 @@ public:
     void setTimeout(int type, uint64_t v);
     uint64_t getTimeout(int type);
 
+    int getFd() const { return m_fd;}
+private:
+    friend class FdManager;
+    // 槽位被 fd 复用时重新初始化
+    void reset(int fd);
 
 private:
     bool m_isInit: 1;           // 是否初始化
@@ -46,21 +51,46 @@ private:
 
 };
 
-class FdManager {
+/**
+ * 文件句柄管理
+ * 两级分段数组: 段按需分配且不再释放，get() 不加锁、不增加引用计数，
+ * hook 的每次 I/O 都会调用，必须足够轻
+ */
+class FdManager : NonCopyable {
 public:
-    typedef RWMutex RWMuteType;
     typedef std::shared_ptr<FdManager> ptr;
 
     FdManager();
-    FdCtx::ptr get(int fd, bool auto_create = false);
+    ~FdManager();
+
+    // 返回的指针一直有效，但 fd 被 close 后槽位可能被新的同号 fd 复用
+    FdCtx* get(int fd, bool auto_create = false);
     void del(int fd);
 
 private:
-    RWMuteType m_mutex;                 // 读写锁
-    std::vector<FdCtx::ptr> m_data;     // 文件句柄集合
+    enum SlotState {
+        EMPTY = 0,
+        INITING = 1,
+        READY = 2
+    };
+
+    struct Slot {
+        std::atomic<int> state{EMPTY};
+        FdCtx ctx;
+    };
+
+    static const int SEGMENT_SHIFT = 12;
+    static const int SEGMENT_SIZE = 1 << SEGMENT_SHIFT;        // 每段 4096 个 fd
+    static const int SEGMENT_MASK = SEGMENT_SIZE - 1;
+    static const int MAX_SEGMENTS = 1024;                       // 最多管理 4M 个 fd
+
+    Slot* getSegment(int idx, bool auto_create);
+
+private:
+    std::atomic<Slot*> m_segments[MAX_SEGMENTS];
 };
 
 typedef Singleton<FdManager> FdMgr;
 
 }
-#endif // __SYLAR_FD_MANAGER_H__
\ No newline at end of file
+#endif // __SYLAR_FD_MANAGER_H__
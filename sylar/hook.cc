@@ -30,11 +30,14 @@ static thread_local bool t_hook_enable = false;  // 线程级别的 hook
     XX(recv) \
     XX(recvfrom) \
     XX(recvmsg) \
+    XX(recvmmsg) \
     XX(write) \
     XX(writev) \
     XX(send) \
     XX(sendto) \
     XX(sendmsg) \
+    XX(sendmmsg) \
+    XX(sendfile) \
     XX(close) \
     XX(fcntl) \
     XX(ioctl) \
@@ -97,7 +100,7 @@ static ssize_t do_io(int fd, OriginalFun fun, const char* hook_fun_name
 
     // SYLAR_LOG_DEBUG(g_logger) << "< do_io " << hook_fun_name << " >";
 
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+    sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(fd);
     if (!ctx) {
         return fun(fd, std::forward<Args>(args)...); // 不是 socket, 按原来的方法走 
     }
@@ -112,7 +115,7 @@ static ssize_t do_io(int fd, OriginalFun fun, const char* hook_fun_name
     }
 
     uint64_t to = ctx->getTimeout(timeout_so);
-    std::shared_ptr<timer_info> tinfo(new timer_info);
+    std::shared_ptr<timer_info> tinfo;  // 真正需要等待时才创建
 
 retry:
     ssize_t n = fun(fd, std::forward<Args>(args)...);
@@ -124,6 +127,9 @@ retry:
 
         sylar::IOManager* iom = sylar::IOManager::GetThis();
         sylar::Timer::ptr timer;
+        if (!tinfo) {
+            tinfo.reset(new timer_info);
+        }
         std::weak_ptr<timer_info> winfo(tinfo);
 
         if (to != (uint64_t)-1) {
@@ -239,7 +245,7 @@ int connect_with_timeout(int fd, const struct sockaddr* addr, socklen_t addrlen,
     if (!sylar::t_hook_enable) {
         return connect_f(fd, addr, addrlen);
     }
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+    sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(fd);
     if (!ctx || ctx->isClose()) {
         errno = EBADF;
         return -1;
@@ -340,6 +346,10 @@ ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags) {
     return do_io(sockfd, recvmsg_f, "recvmsg", sylar::IOManager::READ, SO_RCVTIMEO, msg, flags);
 }
 
+int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout) {
+    return do_io(sockfd, recvmmsg_f, "recvmmsg", sylar::IOManager::READ, SO_RCVTIMEO, msgvec, vlen, flags, timeout);
+}
+
 // write 
 ssize_t write(int fd, const void *buf, size_t count) {
     return do_io(fd, write_f, "write", sylar::IOManager::WRITE, SO_SNDTIMEO, buf, count);
@@ -361,12 +371,20 @@ ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags) {
     return do_io(sockfd, sendmsg_f, "sendmsg", sylar::IOManager::WRITE, SO_SNDTIMEO, msg, flags);
 }
 
+int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags) {
+    return do_io(sockfd, sendmmsg_f, "sendmmsg", sylar::IOManager::WRITE, SO_SNDTIMEO, msgvec, vlen, flags);
+}
+
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+    return do_io(out_fd, sendfile_f, "sendfile", sylar::IOManager::WRITE, SO_SNDTIMEO, in_fd, offset, count);
+}
+
 int close(int fd) {
     if (!sylar::t_hook_enable) {
         return close_f(fd);
     }
 
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+    sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(fd);
     if (ctx) {
         auto iom = sylar::IOManager::GetThis();
         if (iom) {
@@ -386,7 +404,7 @@ int fcntl(int fd, int cmd, ... /* arg */ ) {
             {
                 int arg = va_arg(va, int);
                 va_end(va);
-                sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+                sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(fd);
                 if (!ctx || ctx->isClose() || !ctx->isSocket()) {
                     return fcntl_f(fd, cmd, arg);
                 }
@@ -418,7 +436,7 @@ int fcntl(int fd, int cmd, ... /* arg */ ) {
             {
                 va_end(va);
                 int arg = fcntl_f(fd, cmd);
-                sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+                sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(fd);
                 if (!ctx || ctx->isClose() || !ctx->isSocket()) {
                     return arg;
                 }
@@ -474,7 +492,7 @@ int ioctl(int d, unsigned long int request, ...) {
 
     if (FIONBIO == request) {
         bool user_nonblock = !!*(int*)arg;
-        sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(d);
+        sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(d);
         if (!ctx || ctx->isClose() || !ctx->isSocket()) {
             return ioctl_f(d, request, arg);
         }
@@ -493,7 +511,7 @@ int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t
     }
     if (level == SOL_SOCKET) {  // socket 相关
         if (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO) {
-            sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(sockfd);
+            sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(sockfd);
             if (ctx) {
                 const timeval* tv = (const timeval*)optval;
                 ctx->setTimeout(optname, tv->tv_sec * 1000 + tv->tv_usec / 1000);
@@ -6,6 +6,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <unistd.h>
 #include <time.h>
 
@@ -58,6 +59,9 @@ extern recvfrom_fun recvfrom_f;
 typedef ssize_t (*recvmsg_fun)(int sockfd, struct msghdr *msg, int flags);
 extern recvmsg_fun recvmsg_f;
 
+typedef int (*recvmmsg_fun)(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout);
+extern recvmmsg_fun recvmmsg_f;
+
 // write 
 typedef ssize_t (*write_fun)(int fd, const void *buf, size_t count);
 extern write_fun write_f;
@@ -74,6 +78,12 @@ extern sendto_fun sendto_f;
 typedef ssize_t (*sendmsg_fun)(int sockfd, const struct msghdr *msg, int flags);
 extern sendmsg_fun sendmsg_f;
 
+typedef int (*sendmmsg_fun)(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+extern sendmmsg_fun sendmmsg_f;
+
+typedef ssize_t (*sendfile_fun)(int out_fd, int in_fd, off_t *offset, size_t count);
+extern sendfile_fun sendfile_f;
+
 typedef int (*close_fun)(int fd);
 extern close_fun close_f;
 
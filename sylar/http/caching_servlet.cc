@@ -0,0 +1,316 @@
+#include "caching_servlet.h"
+#include <string.h>
+#include <strings.h>
+#include "sylar/scheduler.h"
+#include "sylar/util.h"
+
+namespace sylar {
+namespace http {
+
+// 在 Cache-Control 中找指令, 有值时写入 val
+static bool FindDirective(const std::string& cc, const char* name, std::string* val = nullptr) {
+    size_t len = strlen(name);
+    size_t pos = 0;
+    while (pos < cc.size()) {
+        size_t end = cc.find(',', pos);
+        if (end == std::string::npos) {
+            end = cc.size();
+        }
+        while (pos < end && isspace(cc[pos])) {
+            ++pos;
+        }
+        if (end - pos >= len && strncasecmp(cc.c_str() + pos, name, len) == 0
+                && (pos + len == end || cc[pos + len] == '=' || isspace(cc[pos + len]))) {
+            if (val) {
+                size_t eq = pos + len;
+                val->clear();
+                if (eq < end && cc[eq] == '=') {
+                    *val = cc.substr(eq + 1, end - eq - 1);
+                }
+            }
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+CachingServlet::CachingServlet(Servlet::ptr servlet, uint64_t default_ttl_ms
+        , uint64_t max_bytes, size_t shards
+        , const std::vector<std::string>& vary_headers)
+    :Servlet("CachingServlet")
+    ,m_servlet(servlet)
+    ,m_defaultTtl(default_ttl_ms)
+    ,m_varyHeaders(vary_headers)
+    ,m_hits(0)
+    ,m_misses(0)
+    ,m_collapsed(0)
+    ,m_stores(0)
+    ,m_evictions(0)
+    ,m_bytes(0) {
+    if (shards == 0) {
+        shards = 1;
+    }
+    m_shardBytes = max_bytes / shards;
+    for (size_t i = 0; i < shards; ++i) {
+        m_shards.emplace_back(new Shard);
+    }
+    setStreamingBody(servlet->isStreamingBody());
+}
+
+std::string CachingServlet::makeKey(HttpRequest::ptr req) const {
+    std::string key = HttpMethodToString(req->getMethod());
+    key.append(" ");
+    StringPiece path = req->getPathView();
+    key.append(path.data(), path.size());
+    StringPiece query = req->getQueryView();
+    if (!query.empty()) {
+        key.append("?");
+        key.append(query.data(), query.size());
+    }
+    for (auto& i : m_varyHeaders) {
+        StringPiece v;
+        key.append("\n");
+        if (req->getHeaderView(i, v)) {
+            key.append(v.data(), v.size());
+        }
+    }
+    return key;
+}
+
+bool CachingServlet::isVaryCovered(const std::string& vary) const {
+    size_t pos = 0;
+    while (pos < vary.size()) {
+        size_t end = vary.find(',', pos);
+        if (end == std::string::npos) {
+            end = vary.size();
+        }
+        size_t b = pos;
+        size_t e = end;
+        while (b < e && isspace(vary[b])) {
+            ++b;
+        }
+        while (e > b && isspace(vary[e - 1])) {
+            --e;
+        }
+        pos = end + 1;
+        if (b == e) {
+            continue;
+        }
+        std::string name = vary.substr(b, e - b);
+        if (name == "*") {
+            return false;
+        }
+        // 压缩在 CachingServlet 之后 (HttpServer 发送前) 按请求进行, 缓存的是原文
+        if (strcasecmp(name.c_str(), "Accept-Encoding") == 0) {
+            continue;
+        }
+        bool found = false;
+        for (auto& i : m_varyHeaders) {
+            if (strcasecmp(i.c_str(), name.c_str()) == 0) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CachingServlet::Entry::ptr CachingServlet::makeEntry(const std::string& key, int32_t rt
+        , HttpResponse::ptr rsp, HttpSession::ptr session) const {
+    if (rt != 0 || (session && session->isResponseStarted())) {
+        return nullptr;
+    }
+    switch (rsp->getStatus()) {
+        case HttpStatus::OK:
+        case HttpStatus::NON_AUTHORITATIVE_INFORMATION:
+        case HttpStatus::MOVED_PERMANENTLY:
+        case HttpStatus::NOT_FOUND:
+        case HttpStatus::GONE:
+            break;
+        default:
+            return nullptr;
+    }
+    if (!rsp->getHeader("Set-Cookie").empty() || !isVaryCovered(rsp->getHeader("Vary"))) {
+        return nullptr;
+    }
+    uint64_t ttl = m_defaultTtl;
+    std::string cc = rsp->getHeader("Cache-Control");
+    if (!cc.empty()) {
+        std::string v;
+        if (FindDirective(cc, "no-store") || FindDirective(cc, "no-cache")
+                || FindDirective(cc, "private")) {
+            return nullptr;
+        }
+        if (FindDirective(cc, "s-maxage", &v) || FindDirective(cc, "max-age", &v)) {
+            ttl = strtoull(v.c_str(), nullptr, 10) * 1000;
+        }
+    }
+    if (ttl == 0) {
+        return nullptr;
+    }
+
+    std::shared_ptr<Entry> entry(new Entry);
+    entry->status = rsp->getStatus();
+    entry->reason = rsp->getReason();
+    entry->headers = rsp->getHeaders();
+    entry->body = rsp->getBody();
+    entry->created = sylar::GetCurretMS();
+    entry->expire = entry->created + ttl;
+    entry->size = sizeof(Entry) + key.size() * 2 + entry->body.size();
+    for (auto& i : entry->headers) {
+        entry->size += i.first.size() + i.second.size();
+    }
+    if (entry->size > m_shardBytes) {
+        return nullptr;
+    }
+    return entry;
+}
+
+void CachingServlet::store(Shard& shard, const std::string& key, Entry::ptr entry) {
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end()) {
+        shard.bytes -= it->second->second->size;
+        m_bytes -= it->second->second->size;
+        shard.lru.erase(it->second);
+        shard.entries.erase(it);
+    }
+    shard.lru.push_front(std::make_pair(key, entry));
+    shard.entries[key] = shard.lru.begin();
+    shard.bytes += entry->size;
+    m_bytes += entry->size;
+    ++m_stores;
+    while (shard.bytes > m_shardBytes && !shard.lru.empty()) {
+        auto& last = shard.lru.back();
+        shard.bytes -= last.second->size;
+        m_bytes -= last.second->size;
+        shard.entries.erase(last.first);
+        shard.lru.pop_back();
+        ++m_evictions;
+    }
+}
+
+void CachingServlet::apply(Entry::ptr entry, HttpResponse::ptr rsp) {
+    rsp->setStatus(entry->status);
+    rsp->setReason(entry->reason);
+    // 保留 HttpServer 预先设置的头 (Server 等)
+    for (auto& i : entry->headers) {
+        rsp->setHeader(i.first, i.second);
+    }
+    rsp->setHeader("Age", std::to_string((sylar::GetCurretMS() - entry->created) / 1000));
+    rsp->setBody(entry->body);
+    rsp->setCacheable(true);
+}
+
+int32_t CachingServlet::handle(sylar::http::HttpRequest::ptr request
+                            ,sylar::http::HttpResponse::ptr response
+                            ,sylar::http::HttpSession::ptr session) {
+    HttpMethod method = request->getMethod();
+    if ((method != HttpMethod::GET && method != HttpMethod::HEAD)
+            || request->hasHeader("Authorization")) {
+        return m_servlet->handle(request, response, session);
+    }
+    std::string cc = request->getHeader("Cache-Control");
+    std::string max_age;
+    if (!cc.empty() && FindDirective(cc, "no-store")) {
+        return m_servlet->handle(request, response, session);
+    }
+    bool refresh = !cc.empty() && (FindDirective(cc, "no-cache")
+            || (FindDirective(cc, "max-age", &max_age) && max_age == "0"));
+
+    std::string key = makeKey(request);
+    Shard& shard = *m_shards[std::hash<std::string>()(key) % m_shards.size()];
+    Flight::ptr flight;
+    bool leader = false;
+    {
+        MutexType::Lock lock(shard.mutex);
+        if (!refresh) {
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.end()) {
+                Entry::ptr entry = it->second->second;
+                if (entry->expire > sylar::GetCurretMS()) {
+                    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                    lock.unlock();
+                    ++m_hits;
+                    apply(entry, response);
+                    return 0;
+                }
+                shard.bytes -= entry->size;
+                m_bytes -= entry->size;
+                shard.lru.erase(it->second);
+                shard.entries.erase(it);
+            }
+        }
+        // 不在协程中无法挂起等待, 直接执行
+        if (Scheduler::GetThis()) {
+            auto it = shard.flights.find(key);
+            if (it == shard.flights.end()) {
+                flight.reset(new Flight);
+                shard.flights[key] = flight;
+                leader = true;
+            } else if (!refresh) {
+                flight = it->second;
+                ++flight->waiters;
+            }
+        }
+    }
+
+    if (flight && !leader) {
+        ++m_collapsed;
+        flight->sem.wait();
+        if (flight->result) {
+            apply(flight->result, response);
+            return 0;
+        }
+    }
+
+    ++m_misses;
+    int32_t rt = m_servlet->handle(request, response, session);
+    Entry::ptr entry = makeEntry(key, rt, response, session);
+    if (entry) {
+        response->setCacheable(true);
+    }
+    size_t waiters = 0;
+    {
+        MutexType::Lock lock(shard.mutex);
+        if (entry) {
+            store(shard, key, entry);
+        }
+        if (leader) {
+            shard.flights.erase(key);
+            flight->result = entry;
+            waiters = flight->waiters;
+        }
+    }
+    for (size_t i = 0; i < waiters; ++i) {
+        flight->sem.notify();
+    }
+    return rt;
+}
+
+void CachingServlet::clear() {
+    for (auto& i : m_shards) {
+        MutexType::Lock lock(i->mutex);
+        m_bytes -= i->bytes;
+        i->bytes = 0;
+        i->entries.clear();
+        i->lru.clear();
+    }
+}
+
+CachingServlet::Stats CachingServlet::getStats() const {
+    Stats rt;
+    rt.hits = m_hits;
+    rt.misses = m_misses;
+    rt.collapsed = m_collapsed;
+    rt.stores = m_stores;
+    rt.evictions = m_evictions;
+    rt.bytes = m_bytes;
+    return rt;
+}
+
+}
+}
@@ -0,0 +1,107 @@
+#ifndef __SYLAR_HTTP_CACHING_SERVLET_H__
+#define __SYLAR_HTTP_CACHING_SERVLET_H__
+
+#include <list>
+#include <unordered_map>
+#include <atomic>
+#include "servlet.h"
+#include "sylar/mutex.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * 响应缓存, 包装任意 servlet, 相同的 GET / HEAD 直接用缓存的响应, 不再执行 servlet
+ * 1. key 为 method + path + query + 构造时指定的请求头 (vary_headers) 的值
+ * 2. 有效期取响应的 Cache-Control: s-maxage / max-age, 没有时用 default_ttl_ms;
+ *    no-store / no-cache / private、Set-Cookie、Vary 含 vary_headers 以外的头 (Accept-Encoding 除外) 或 *、
+ *    非 200/203/301/404/410、servlet 返回非 0 或已经流式发出的响应不缓存
+ * 3. 请求带 Authorization 或 Cache-Control: no-store 时不走缓存;
+ *    Cache-Control: no-cache / max-age=0 时重新执行 servlet 并刷新缓存
+ * 4. 按 key 的哈希分成 shards 个分片, 每片一个 LRU 和一把锁, 总内存不超过 max_bytes
+ * 5. 同一个 key 同时未命中时只有第一个请求执行 servlet, 其余协程挂起等它的结果 (single-flight);
+ *    结果不能缓存时等待者各自再执行一次
+ */
+class CachingServlet : public Servlet {
+public:
+    typedef std::shared_ptr<CachingServlet> ptr;
+    typedef Mutex MutexType;
+
+    CachingServlet(Servlet::ptr servlet, uint64_t default_ttl_ms = 1000
+            , uint64_t max_bytes = 64 * 1024 * 1024, size_t shards = 16
+            , const std::vector<std::string>& vary_headers = {});
+
+    virtual int32_t handle(sylar::http::HttpRequest::ptr request
+                            ,sylar::http::HttpResponse::ptr response
+                            ,sylar::http::HttpSession::ptr session) override;
+
+    Servlet::ptr getServlet() const { return m_servlet;}
+    // 清空缓存
+    void clear();
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;        // 执行了 servlet 的次数
+        uint64_t collapsed;     // 等待其他请求结果的次数
+        uint64_t stores;
+        uint64_t evictions;     // 因内存预算淘汰
+        uint64_t bytes;         // 当前占用
+    };
+    Stats getStats() const;
+private:
+    // 缓存的响应, 发布后不再修改
+    struct Entry {
+        typedef std::shared_ptr<const Entry> ptr;
+        HttpStatus status;
+        std::string reason;
+        HttpResponse::MapType headers;
+        std::string body;
+        uint64_t created;       // ms
+        uint64_t expire;        // ms
+        size_t size;            // 计入内存预算的大小
+    };
+
+    // 正在执行 servlet 的 key
+    struct Flight {
+        typedef std::shared_ptr<Flight> ptr;
+        FiberSemaphore sem;
+        size_t waiters = 0;
+        Entry::ptr result;
+    };
+
+    struct Shard {
+        typedef std::list<std::pair<std::string, Entry::ptr>> EntryList;    // 最近使用的在前
+        MutexType mutex;
+        EntryList lru;
+        std::unordered_map<std::string, EntryList::iterator> entries;
+        std::unordered_map<std::string, Flight::ptr> flights;
+        uint64_t bytes = 0;
+    };
+
+    std::string makeKey(HttpRequest::ptr req) const;
+    // 响应的 Vary 列出的头是否都在 key 中
+    bool isVaryCovered(const std::string& vary) const;
+    // servlet 的结果可缓存时返回新的 Entry
+    Entry::ptr makeEntry(const std::string& key, int32_t rt, HttpResponse::ptr rsp
+            , HttpSession::ptr session) const;
+    void store(Shard& shard, const std::string& key, Entry::ptr entry);
+    static void apply(Entry::ptr entry, HttpResponse::ptr rsp);
+private:
+    Servlet::ptr m_servlet;
+    uint64_t m_defaultTtl;
+    uint64_t m_shardBytes;      // 每个分片的内存预算
+    std::vector<std::string> m_varyHeaders;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<uint64_t> m_collapsed;
+    std::atomic<uint64_t> m_stores;
+    std::atomic<uint64_t> m_evictions;
+    std::atomic<uint64_t> m_bytes;
+};
+
+}
+}
+
+#endif  // __SYLAR_HTTP_CACHING_SERVLET_H__
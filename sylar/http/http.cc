@@ -1,4 +1,5 @@
 #include "http.h"
+#include "sylar/stream.h"
 
 namespace sylar {
 namespace http {
@@ -53,6 +54,10 @@ bool CaseInsensitiveLess::operator() (const std::string& lhs, const std::string&
     return strcasecmp(lhs.c_str(), rhs.c_str()) < 0;  // 不区分大小写比较
 }
 
+bool CaseInsensitiveEqual(const StringPiece& lhs, const StringPiece& rhs) {
+    return lhs.size() == rhs.size() && strncasecmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+}
+
 HttpRequest::HttpRequest(uint8_t version, bool close) 
     :m_method(HttpMethod::GET)
     ,m_version(version)
@@ -67,10 +72,68 @@ std::shared_ptr<HttpResponse> HttpRequest::createResponse() {
     return rsp;
 }
 
+const std::string& HttpRequest::getPath() const {
+    if (m_pathView.data()) {
+        m_pathView.CopyToString(&m_path);
+        m_pathView.clear();
+    }
+    return m_path;
+}
+
+const std::string& HttpRequest::getQuery() const {
+    if (m_queryView.data()) {
+        m_queryView.CopyToString(&m_query);
+        m_queryView.clear();
+    }
+    return m_query;
+}
+
+const std::string& HttpRequest::getFragment() const {
+    if (m_fragmentView.data()) {
+        m_fragmentView.CopyToString(&m_fragment);
+        m_fragmentView.clear();
+    }
+    return m_fragment;
+}
+
+HttpRequest::MapType HttpRequest::getHeaders() const {
+    MapType headers = m_headers;
+    for (auto& i : m_headerViews) {
+        headers[i.first.as_string()] = i.second.as_string();
+    }
+    return headers;
+}
+
+bool HttpRequest::getHeaderView(const StringPiece& key, StringPiece& val) const {
+    // 同名请求头取最后一个, 与 map 的覆盖语义一致
+    for (auto it = m_headerViews.rbegin(); it != m_headerViews.rend(); ++it) {
+        if (CaseInsensitiveEqual(it->first, key)) {
+            val = it->second;
+            return true;
+        }
+    }
+    if (m_headers.empty()) {
+        return false;
+    }
+    auto it = m_headers.find(key.as_string());
+    if (it == m_headers.end()) {
+        return false;
+    }
+    val = it->second;
+    return true;
+}
+
+void HttpRequest::materializeHeaders() {
+    for (auto& i : m_headerViews) {
+        m_headers[i.first.as_string()] = i.second.as_string();
+    }
+    m_headerViews.clear();
+}
+
 // 从 Headers 取数据
 std::string HttpRequest::getHeader(const std::string& key, const std::string& def) const {
-    auto it = m_headers.find(key);
-    return it == m_headers.end() ? def : it->second;
+    StringPiece val;
+    return getHeaderView(key, val) ? val.as_string() : def;
 }
 
 std::string HttpRequest::getParam(const std::string& key, const std::string& def) const {
@@ -83,8 +146,63 @@ std::string HttpRequest::getCookie(const std::string& key, const std::string& de
     return it == m_headers.end() ? def : it->second;
 }
 
+int HttpRequest::loadBody(uint64_t max_size) {
+    if (!m_bodyStream) {
+        return 0;
+    }
+    uint64_t length = getHeaderAs<uint64_t>("content-length", 0);
+    if (length > max_size) {
+        return -2;
+    }
+    std::string body;
+    body.reserve(length);
+    size_t block = 16 * 1024;
+    while (true) {
+        size_t old = body.size();
+        body.resize(old + block);
+        int rt = m_bodyStream->read(&body[old], block);
+        if (rt < 0) {
+            return -1;
+        }
+        body.resize(old + rt);
+        if (rt == 0) {
+            break;
+        }
+        if (body.size() > max_size) {
+            return -2;
+        }
+    }
+    m_body.swap(body);
+    m_bodyStream.reset();
+    return 0;
+}
+
+bool HttpRequest::discardBody(uint64_t max_size) {
+    if (!m_bodyStream) {
+        return true;
+    }
+    char buf[4096];
+    uint64_t total = 0;
+    int rt = 0;
+    while ((rt = m_bodyStream->read(buf, sizeof(buf))) > 0) {
+        total += rt;
+        if (total > max_size) {
+            rt = -1;
+            break;
+        }
+    }
+    m_bodyStream.reset();
+    return rt == 0;
+}
+
+std::string HttpRequest::getPathParam(const std::string& key, const std::string& def) const {
+    auto it = m_pathParams.find(key);
+    return it == m_pathParams.end() ? def : it->second;
+}
+
 // 从 Headers 取数据
 void HttpRequest::setHeader(const std::string& key, const std::string& val) {
+    materializeHeaders();
     m_headers[key] = val;
 }
 
@@ -99,6 +217,7 @@ void HttpRequest::setCookie(const std::string& key, const std::string& val) {
 }
 
 void HttpRequest::delHeader(const std::string& key) {
+    materializeHeaders();
     m_headers.erase(key);
 }
 
@@ -111,12 +230,12 @@ void HttpRequest::delCookie(const std::string& key) {
 }
 
 bool HttpRequest::hasHeader(const std::string& key, std::string* val) const {
-    auto it = m_headers.find(key);
-    if (it == m_headers.end()) {
+    StringPiece v;
+    if (!getHeaderView(key, v)) {
         return false;
     }
     if (val) {
-        *val = it->second;
+        v.CopyToString(val);
     }
     return true;
 }
@@ -143,37 +262,81 @@ bool HttpRequest::hasCookie(const std::string& key, std::string* val) const {
     return true;
 }
 
+// 追加十进制数, 不经过 stringstream
+static void AppendUint(std::string& out, uint64_t v) {
+    char buf[24];
+    char* p = buf + sizeof(buf);
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    out.append(p, buf + sizeof(buf) - p);
+}
+
+static void AppendHeader(std::string& out, const StringPiece& key, const StringPiece& val) {
+    out.append(key.data(), key.size());
+    out.append(": ", 2);
+    out.append(val.data(), val.size());
+    out.append("\r\n", 2);
+}
+
 // 序列化
-std::ostream& HttpRequest::dump(std::ostream& os) const{
+void HttpRequest::encodeHead(std::string& out) const {
     // GET /uri HTTP/1.1
     // host: www.sylar.top
     //
     //
 
     // 按照上述格式进行拼接
-    os << HttpMethodToString(m_method) << " " << m_path << (m_query.empty() ? "" : "?") << m_query
-            <<(m_fragment.empty() ? "" : "#") << m_fragment
-            << " HTTP/" << ((uint32_t)(m_version >> 4)) << "." << ((uint32_t)(m_version & 0x0F))
-            << "\r\n";
+    StringPiece path = getPathView();
+    StringPiece query = getQueryView();
+    StringPiece fragment = m_fragmentView.data() ? m_fragmentView : StringPiece(m_fragment);
+    out.append(HttpMethodToString(m_method));
+    out.append(" ", 1);
+    out.append(path.data(), path.size());
+    if (!query.empty()) {
+        out.append("?", 1);
+        out.append(query.data(), query.size());
+    }
+    if (!fragment.empty()) {
+        out.append("#", 1);
+        out.append(fragment.data(), fragment.size());
+    }
+    out.append(" HTTP/", 6);
+    AppendUint(out, m_version >> 4);
+    out.append(".", 1);
+    AppendUint(out, m_version & 0x0F);
+    out.append("\r\n", 2);
 
     if (!m_websocket) {
-        os << "connect: " << (m_close ? "close" : "keep-alive") << "\r\n";
+        AppendHeader(out, "connect", m_close ? "close" : "keep-alive");
     }
 
     for (auto& header : m_headers) {
         if (!m_websocket && strcasecmp(header.first.c_str(), "connection") == 0) {
             continue;
         }
-        os << header.first << ": " << header.second << "\r\n";
+        AppendHeader(out, header.first, header.second);
+    }
+    for (auto& header : m_headerViews) {
+        if (!m_websocket && CaseInsensitiveEqual(header.first, "connection")) {
+            continue;
+        }
+        AppendHeader(out, header.first, header.second);
     }
 
     if (!m_body.empty()) {
-        os << "content-length: " << m_body.size() << "\r\n\r\n" << m_body;
-    } else {
-        os << "\r\n";
+        out.append("content-length: ");
+        AppendUint(out, m_body.size());
+        out.append("\r\n");
     }
+    out.append("\r\n", 2);
+}
 
-    return os;
+std::ostream& HttpRequest::dump(std::ostream& os) const{
+    std::string head;
+    encodeHead(head);
+    return os << head << m_body;
 }
 
 std::string HttpRequest::toString() const {
@@ -183,9 +346,9 @@ std::string HttpRequest::toString() const {
 }
 
 void HttpRequest::init() {
-    std::string conn = getHeader("connection");
-    if(!conn.empty()) {
-        if(strcasecmp(conn.c_str(), "keep-alive") == 0) {
+    StringPiece conn;
+    if(getHeaderView("connection", conn) && !conn.empty()) {
+        if(CaseInsensitiveEqual(conn, "keep-alive")) {
             m_close = false;
         } else {
             m_close = true;
@@ -197,7 +360,8 @@ HttpResponse::HttpResponse(uint8_t version, bool close)
     :m_status(HttpStatus::OK)
     ,m_version(version)
     ,m_close(close)
-    ,m_websocket(false) {
+    ,m_websocket(false)
+    ,m_cacheable(false) {
 }
 
 // 从 Headers 取数据
@@ -214,28 +378,40 @@ void HttpResponse::delHeader(const std::string& key) {
     m_headers.erase(key);
 }
 
-std::ostream& HttpResponse::dump(std::ostream& os) const {
-    os << "HTTP/" << ((uint32_t)m_version >> 4) << "." << ((uint32_t)m_version & 0x0F) << " " 
-        << (uint32_t)m_status << " " <<  (m_reason.empty() ? HttpStatusToString(m_status) : m_reason) << "\r\n";
+void HttpResponse::encodeHead(std::string& out) const {
+    out.append("HTTP/", 5);
+    AppendUint(out, m_version >> 4);
+    out.append(".", 1);
+    AppendUint(out, m_version & 0x0F);
+    out.append(" ", 1);
+    AppendUint(out, (uint32_t)m_status);
+    out.append(" ", 1);
+    out.append(m_reason.empty() ? HttpStatusToString(m_status) : m_reason.c_str());
+    out.append("\r\n", 2);
 
     for (auto& header : m_headers) {
         if (!m_websocket && strcasecmp(header.first.c_str(), "connection") == 0) {
             continue;
         }
-        os << header.first << ": " << header.second << "\r\n";
+        AppendHeader(out, header.first, header.second);
     }
 
     if (!m_websocket) {
-        os << "connection: " << (m_close ? "close" : "keep-alive") << "\r\n";
+        AppendHeader(out, "connection", m_close ? "close" : "keep-alive");
     }
 
     if (!m_body.empty()) {
-        os << "content-length: " << m_body.size() << "\r\n\r\n" 
-            << m_body;
-    } else {
-        os << "\r\n";
+        out.append("content-length: ");
+        AppendUint(out, m_body.size());
+        out.append("\r\n");
     }
-    return os;
+    out.append("\r\n", 2);
+}
+
+std::ostream& HttpResponse::dump(std::ostream& os) const {
+    std::string head;
+    encodeHead(head);
+    return os << head << m_body;
 }
 
 std::string HttpResponse::toString() const {
@@ -4,14 +4,18 @@
 #include <memory>
 #include <string>
 #include <map>
+#include <vector>
 #include <iostream>
 #include <sstream>
 #include <boost/lexical_cast.hpp>
 
+#include "sylar/stringpiece.h"
 #include "http11_parser.h"
 #include "httpclient_parser.h"
 
 namespace sylar {
+class Stream;
+
 namespace http {
 
 /* Request Methods */
@@ -146,6 +150,9 @@ struct CaseInsensitiveLess {
     bool operator() (const std::string& lhs, const std::string& rhs) const;
 };
 
+// 大小写无关的相等比较
+bool CaseInsensitiveEqual(const StringPiece& lhs, const StringPiece& rhs);
+
 // 检查并取参
 template <class MapType, class T>
 bool checkGetAs(const MapType& m, const std::string& key, T& val, const T& def = T()) {
@@ -182,10 +189,17 @@ T getAs(const MapType& m, const std::string& key, const T& def = T()) {
 }
 
 class HttpResponse;
+/**
+ * HTTP 请求
+ * 零拷贝解析 (http.request.zero_copy) 时 path/query/fragment 和请求头只是指向原始请求头缓冲的 StringPiece,
+ * 请求持有该缓冲 (setRawBuffer); 请求头放在按到达顺序的小数组中, 查找时线性地大小写无关比较,
+ * 第一次修改请求头 (setHeader/delHeader) 时才转成 map
+ */
 class HttpRequest {
 public:
     typedef std::shared_ptr<HttpRequest> ptr;
     typedef std::map<std::string, std::string, CaseInsensitiveLess> MapType;      
+    typedef std::vector<std::pair<StringPiece, StringPiece> > ViewVec;
     
     HttpRequest(uint8_t version = 0x11, bool close = true);
 
@@ -193,29 +207,57 @@ public:
 
     HttpMethod getMethod() const { return m_method;}
     uint8_t getVersion() const { return m_version;}
-    const std::string& getPath() const { return m_path;}
-    const std::string& getQuery() const { return m_query;}
+    // 视图模式下第一次调用时才生成 std::string
+    const std::string& getPath() const;
+    const std::string& getQuery() const;
+    const std::string& getFragment() const;
     const std::string& getBody() const { return m_body;}
 
-    MapType getHeaders() const { return m_headers;}
+    // 不分配内存的访问, 返回值在请求存活期间有效
+    StringPiece getPathView() const { return m_pathView.data() ? m_pathView : StringPiece(m_path);}
+    StringPiece getQueryView() const { return m_queryView.data() ? m_queryView : StringPiece(m_query);}
+
+    MapType getHeaders() const;
     MapType getParams() const { return m_params;}
     MapType getCookies() const { return m_cookies;}
+    const MapType& getPathParams() const { return m_pathParams;}
 
     void setMethod(HttpMethod v) { m_method = v;}
     void setVersion(uint8_t v) { m_version = v;}
 
-    void setPath(const std::string& v) { m_path = v;}
-    void setQuery(const std::string& v) { m_query = v;}
-    void setFragment(const std::string& v) { m_fragment = v;}
+    void setPath(const std::string& v) { m_path = v; m_pathView.clear();}
+    void setQuery(const std::string& v) { m_query = v; m_queryView.clear();}
+    void setFragment(const std::string& v) { m_fragment = v; m_fragmentView.clear();}
     void setBody(const std::string& v) { m_body = v;}
 
+    /**
+     * 流式 body (HttpSession::recvRequest(true)), 为空表示没有 body 或 body 已在 getBody() 中
+     * 流式 servlet (Servlet::setStreamingBody) 自己从中读取
+     */
+    std::shared_ptr<sylar::Stream> getBodyStream() const { return m_bodyStream;}
+    void setBodyStream(std::shared_ptr<sylar::Stream> v) { m_bodyStream = v;}
+    // 把流式 body 读完放入 getBody(), 返回 0 成功, -1 读取出错, -2 超过 max_size
+    int loadBody(uint64_t max_size);
+    // 丢弃流式 body 中未读的部分, 保证连接上的下一个请求从正确的位置开始
+    // 出错或剩余部分超过 max_size 时返回 false (调用方应关闭连接, 不再读下去)
+    bool discardBody(uint64_t max_size);
+
+    // 零拷贝解析: 持有原始请求头缓冲, 下面的 view 都指向该缓冲
+    void setRawBuffer(std::shared_ptr<std::string> v) { m_raw = v;}
+    void setPathView(const StringPiece& v) { m_pathView = v;}
+    void setQueryView(const StringPiece& v) { m_queryView = v;}
+    void setFragmentView(const StringPiece& v) { m_fragmentView = v;}
+    void addHeaderView(const StringPiece& key, const StringPiece& val) { m_headerViews.push_back(std::make_pair(key, val));}
+    // 查找请求头, 不分配内存, 找不到返回 false
+    bool getHeaderView(const StringPiece& key, StringPiece& val) const;
+
     bool isClose() const { return m_close;}
     void setClose(bool v) { m_close = v;}
 
     bool isWebsocket() const { return m_websocket;}
     void setWebsocket(bool v) { m_websocket = v;}
 
-    void setHeaders(const MapType& v) { m_headers = v;}
+    void setHeaders(const MapType& v) { m_headers = v; m_headerViews.clear();}
     void setParams(const MapType& v) { m_params = v;}
     void setCookies(const MapType& v) { m_cookies = v;}
 
@@ -227,6 +269,10 @@ public:
     void setParam(const std::string& key, const std::string& val);
     void setCookie(const std::string& key, const std::string& val);
 
+    // 路由 (ServletDispatch::addRouteServlet) 捕获的路径参数, ":id" -> "id", "*file" -> "file"
+    std::string getPathParam(const std::string& key, const std::string& def = "") const;
+    void setPathParam(const std::string& key, const std::string& val) { m_pathParams[key] = val;}
+
     void delHeader(const std::string& key);
     void delParam(const std::string& key);
     void delCookie(const std::string& key);
@@ -237,12 +283,25 @@ public:
 
     template<class T> 
     bool checkGetHeaderAs(const std::string& key, T& val, const T& def = T()) {
-        return checkGetAs(m_headers, key, val, def);
+        StringPiece v;
+        if (!getHeaderView(key, v)) {
+            val = def;
+            return false;
+        }
+        try {
+            val = boost::lexical_cast<T>(v.data(), v.size());
+            return true;
+        } catch(...) {
+            val = def;
+        }
+        return false;
     }
     
     template <class T>
     T getHeaderAs(const std::string& key, const T& def = T()) {
-        return getAs(m_headers, key, def);
+        T val;
+        checkGetHeaderAs(key, val, def);
+        return val;
     }
 
     template<class T> 
@@ -267,22 +326,35 @@ public:
 
     std::ostream& dump(std::ostream& os) const;
     std::string toString() const;
+    // 把请求行和头部 (到空行为止) 追加到 out, 不含 body; dump() = encodeHead() + body
+    void encodeHead(std::string& out) const;
 
     void init();
+private:
+    // 请求头视图转存到 m_headers
+    void materializeHeaders();
 private:
     HttpMethod m_method;
     uint8_t m_version;          // 一个字节表示版本: 0x11 -> 1.1, 0x10 -> 1.0
     bool m_close;               // 是否长连接
     bool m_websocket;           // 是否为 websocket
 
-    std::string m_path;         // 请求路径
-    std::string m_query;        // 请求参数
-    std::string m_fragment;     // 请求 fragment
+    mutable std::string m_path;         // 请求路径
+    mutable std::string m_query;        // 请求参数
+    mutable std::string m_fragment;     // 请求 fragment
     std::string m_body;         // 请求体
 
+    std::shared_ptr<sylar::Stream> m_bodyStream;    // 未读的流式 body
+    std::shared_ptr<std::string> m_raw;     // 零拷贝解析时的原始请求头
+    mutable StringPiece m_pathView;         // 非空时优先于 m_path
+    mutable StringPiece m_queryView;
+    mutable StringPiece m_fragmentView;
+    ViewVec m_headerViews;                  // 未修改过的请求头 (按到达顺序)
+
     MapType m_headers;          // 请求头部 map
     MapType m_params;           // 请求参数
     MapType m_cookies;          // 请求 Cookies map
+    MapType m_pathParams;       // 路由捕获的路径参数
 };
 
 class HttpResponse {
@@ -309,6 +381,10 @@ public:
 
     bool isWebsocket() const { return m_websocket;}
     void setWebsocket(bool v) { m_websocket = v;}
+
+    // 同一 uri 的 body 基本不变, 压缩结果等可以缓存复用
+    bool isCacheable() const { return m_cacheable;}
+    void setCacheable(bool v) { m_cacheable = v;}
     
     std::string getHeader(const std::string& key, const std::string& def = "") const;  // 从 Headers 取数据
     void setHeader(const std::string& key, const std::string& v);
@@ -326,12 +402,15 @@ public:
 
     std::ostream& dump(std::ostream& os) const;
     std::string toString() const;
+    // 把状态行和头部 (到空行为止) 追加到 out, 不含 body; dump() = encodeHead() + body
+    void encodeHead(std::string& out) const;
 
 private:
     HttpStatus m_status;            // 响应状态
     uint8_t m_version;              // HTTP 版本
     bool m_close;                   // 是否长连接
     bool m_websocket;               // 是否为 websocket
+    bool m_cacheable;               // body 是否可缓存
     std::string m_body;             // 响应体
     std::string m_reason;           // 响应原因
     MapType m_headers;              // 响应头 map
@@ -0,0 +1,399 @@
+#include "http_compress.h"
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#ifdef SYLAR_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+#include "sylar/config.h"
+#include "sylar/log.h"
+#include "sylar/mutex.h"
+#include "sylar/util.h"
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<bool>::ptr g_compress_enable =
+    sylar::Config::Lookup("http.server.compress.enable", true, "http server compress response body");
+
+static sylar::ConfigVar<uint32_t>::ptr g_compress_min_size =
+    sylar::Config::Lookup("http.server.compress.min_size", (uint32_t)1024
+            , "http server compress body not less than min_size");
+
+static sylar::ConfigVar<int32_t>::ptr g_compress_level =
+    sylar::Config::Lookup("http.server.compress.level", (int32_t)6, "http server gzip/deflate level 1-9");
+
+static sylar::ConfigVar<int32_t>::ptr g_compress_brotli_quality =
+    sylar::Config::Lookup("http.server.compress.brotli_quality", (int32_t)5
+            , "http server brotli quality 0-11");
+
+static sylar::ConfigVar<uint64_t>::ptr g_compress_cache_size =
+    sylar::Config::Lookup("http.server.compress.cache_size", (uint64_t)(16 * 1024 * 1024)
+            , "http server compressed body cache size in bytes, 0 disable");
+
+const char* ContentEncodingToString(ContentEncoding v) {
+    switch (v) {
+        case ContentEncoding::GZIP:
+            return "gzip";
+        case ContentEncoding::DEFLATE:
+            return "deflate";
+        case ContentEncoding::BR:
+            return "br";
+        default:
+            return "identity";
+    }
+}
+
+ContentEncoding NegotiateEncoding(const std::string& accept_encoding) {
+    // 下标按 ContentEncoding, -1 表示没出现
+    float q[4] = {-1, -1, -1, -1};
+    float q_any = -1;
+    size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', pos);
+        if (end == std::string::npos) {
+            end = accept_encoding.size();
+        }
+        size_t b = pos;
+        size_t e = accept_encoding.find(';', pos);
+        if (e == std::string::npos || e > end) {
+            e = end;
+        }
+        while (b < e && isspace(accept_encoding[b])) {
+            ++b;
+        }
+        while (e > b && isspace(accept_encoding[e - 1])) {
+            --e;
+        }
+        float v = 1;
+        size_t qpos = accept_encoding.find("q=", e);
+        if (qpos != std::string::npos && qpos < end) {
+            v = atof(accept_encoding.c_str() + qpos + 2);
+        }
+        std::string token = accept_encoding.substr(b, e - b);
+        if (strcasecmp(token.c_str(), "gzip") == 0 || strcasecmp(token.c_str(), "x-gzip") == 0) {
+            q[(int)ContentEncoding::GZIP] = v;
+        } else if (strcasecmp(token.c_str(), "deflate") == 0) {
+            q[(int)ContentEncoding::DEFLATE] = v;
+        } else if (strcasecmp(token.c_str(), "br") == 0) {
+            q[(int)ContentEncoding::BR] = v;
+        } else if (token == "*") {
+            q_any = v;
+        }
+        pos = end + 1;
+    }
+
+    static const ContentEncoding s_prefer[] = {
+#ifdef SYLAR_HAVE_BROTLI
+        ContentEncoding::BR,
+#endif
+        ContentEncoding::GZIP,
+        ContentEncoding::DEFLATE,
+    };
+    ContentEncoding rt = ContentEncoding::IDENTITY;
+    float best = 0;
+    for (auto i : s_prefer) {
+        float v = q[(int)i] < 0 ? q_any : q[(int)i];
+        if (v > best) {
+            best = v;
+            rt = i;
+        }
+    }
+    return rt;
+}
+
+ZlibCompressor::ZlibCompressor(bool gzip, int level)
+    :m_gzip(gzip)
+    ,m_level(level) {
+    memset(&m_zs, 0, sizeof(m_zs));
+    // windowBits + 16 输出 gzip 头和 trailer
+    m_ok = deflateInit2(&m_zs, level, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    if (!m_ok) {
+        SYLAR_LOG_ERROR(g_logger) << "deflateInit2 fail, level=" << level;
+    }
+}
+
+ZlibCompressor::~ZlibCompressor() {
+    if (m_ok) {
+        deflateEnd(&m_zs);
+    }
+}
+
+void ZlibCompressor::reset() {
+    if (m_ok) {
+        deflateReset(&m_zs);
+    }
+}
+
+bool ZlibCompressor::update(const void* data, size_t len, std::string& out, int flush) {
+    if (!m_ok) {
+        return false;
+    }
+    m_zs.next_in = (Bytef*)data;
+    m_zs.avail_in = len;
+    do {
+        size_t old = out.size();
+        size_t room = deflateBound(&m_zs, m_zs.avail_in) + 64;
+        out.resize(old + room);
+        m_zs.next_out = (Bytef*)&out[old];
+        m_zs.avail_out = room;
+        int rt = deflate(&m_zs, flush);
+        out.resize(old + room - m_zs.avail_out);
+        if (rt == Z_STREAM_END) {
+            break;
+        }
+        if (rt != Z_OK && rt != Z_BUF_ERROR) {
+            SYLAR_LOG_ERROR(g_logger) << "deflate fail, rt=" << rt;
+            return false;
+        }
+        // 输出区没写满说明这一步的输出已经全部拿到
+        if (m_zs.avail_in == 0 && m_zs.avail_out != 0) {
+            break;
+        }
+    } while (true);
+    return true;
+}
+
+ZlibCompressor* ZlibCompressor::GetThreadLocal(bool gzip, int level) {
+    static thread_local std::unique_ptr<ZlibCompressor> t_gzip;
+    static thread_local std::unique_ptr<ZlibCompressor> t_deflate;
+    auto& c = gzip ? t_gzip : t_deflate;
+    if (!c || c->getLevel() != level) {
+        c.reset(new ZlibCompressor(gzip, level));
+    } else {
+        c->reset();
+    }
+    return c.get();
+}
+
+bool CompressBody(ContentEncoding enc, const std::string& in, std::string& out) {
+    out.clear();
+    switch (enc) {
+        case ContentEncoding::GZIP:
+        case ContentEncoding::DEFLATE: {
+            auto c = ZlibCompressor::GetThreadLocal(enc == ContentEncoding::GZIP
+                    , g_compress_level->getValue());
+            return c->update(in.c_str(), in.size(), out, Z_FINISH);
+        }
+#ifdef SYLAR_HAVE_BROTLI
+        case ContentEncoding::BR: {
+            size_t len = BrotliEncoderMaxCompressedSize(in.size());
+            if (len == 0) {
+                return false;
+            }
+            out.resize(len);
+            if (!BrotliEncoderCompress(g_compress_brotli_quality->getValue(), BROTLI_DEFAULT_WINDOW
+                        , BROTLI_MODE_TEXT, in.size(), (const uint8_t*)in.c_str()
+                        , &len, (uint8_t*)&out[0])) {
+                out.clear();
+                return false;
+            }
+            out.resize(len);
+            return true;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+static std::atomic<uint64_t> s_responses(0);
+static std::atomic<uint64_t> s_cache_hits(0);
+static std::atomic<uint64_t> s_bytes_in(0);
+static std::atomic<uint64_t> s_bytes_out(0);
+static std::atomic<uint64_t> s_cpu_us(0);
+
+CompressStats GetCompressStats() {
+    CompressStats rt;
+    rt.responses = s_responses;
+    rt.cacheHits = s_cache_hits;
+    rt.bytesIn = s_bytes_in;
+    rt.bytesOut = s_bytes_out;
+    rt.cpuUs = s_cpu_us;
+    return rt;
+}
+
+void ResetCompressStats() {
+    s_responses = 0;
+    s_cache_hits = 0;
+    s_bytes_in = 0;
+    s_bytes_out = 0;
+    s_cpu_us = 0;
+}
+
+namespace {
+
+// 压缩结果缓存, key 为 编码 + uri; body 的哈希和长度用来发现内容变化
+class CompressCache {
+public:
+    typedef Mutex MutexType;
+
+    bool get(const std::string& key, size_t hash, size_t size, std::string& out) {
+        MutexType::Lock lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it == m_entries.end()) {
+            return false;
+        }
+        if (it->second->hash != hash || it->second->size != size) {
+            erase(it->second);
+            return false;
+        }
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        out = it->second->data;
+        return true;
+    }
+
+    void put(const std::string& key, size_t hash, size_t size, const std::string& data, uint64_t budget) {
+        if (data.size() + key.size() > budget) {
+            return;
+        }
+        MutexType::Lock lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            erase(it->second);
+        }
+        m_lru.push_front(Entry{key, hash, size, data});
+        m_entries[key] = m_lru.begin();
+        m_bytes += key.size() + data.size();
+        while (m_bytes > budget && !m_lru.empty()) {
+            erase(--m_lru.end());
+        }
+    }
+private:
+    struct Entry {
+        std::string key;
+        size_t hash;
+        size_t size;
+        std::string data;
+    };
+    typedef std::list<Entry> EntryList;     // 最近使用的在前
+
+    void erase(EntryList::iterator it) {
+        m_bytes -= it->key.size() + it->data.size();
+        m_entries.erase(it->key);
+        m_lru.erase(it);
+    }
+private:
+    MutexType m_mutex;
+    EntryList m_lru;
+    std::unordered_map<std::string, EntryList::iterator> m_entries;
+    uint64_t m_bytes = 0;
+};
+
+}
+
+static CompressCache& GetCompressCache() {
+    static CompressCache s_cache;
+    return s_cache;
+}
+
+static bool IsCompressibleType(const std::string& type) {
+    if (type.empty()) {
+        return false;
+    }
+    std::string t = type.substr(0, type.find(';'));
+    while (!t.empty() && isspace(t.back())) {
+        t.pop_back();
+    }
+    std::transform(t.begin(), t.end(), t.begin(), ::tolower);
+    if (t.compare(0, 5, "text/") == 0) {
+        return true;
+    }
+    static const char* s_types[] = {
+        "application/json",
+        "application/javascript",
+        "application/x-javascript",
+        "application/xml",
+        "application/xhtml+xml",
+        "image/svg+xml",
+    };
+    for (auto i : s_types) {
+        if (t == i) {
+            return true;
+        }
+    }
+    return (t.size() > 5 && t.compare(t.size() - 5, 5, "+json") == 0)
+        || (t.size() > 4 && t.compare(t.size() - 4, 4, "+xml") == 0);
+}
+
+bool CompressResponse(HttpRequest::ptr req, HttpResponse::ptr rsp) {
+    if (!g_compress_enable->getValue()) {
+        return false;
+    }
+    const std::string& body = rsp->getBody();
+    if (body.size() < g_compress_min_size->getValue()) {
+        return false;
+    }
+    HttpStatus status = rsp->getStatus();
+    if (status == HttpStatus::NO_CONTENT || status == HttpStatus::PARTIAL_CONTENT
+            || status == HttpStatus::NOT_MODIFIED) {
+        return false;
+    }
+    if (!rsp->getHeader("Content-Encoding").empty()
+            || !IsCompressibleType(rsp->getHeader("Content-Type"))) {
+        return false;
+    }
+    // 是否压缩取决于 Accept-Encoding, 共享缓存要按它区分
+    std::string vary = rsp->getHeader("Vary");
+    if (vary.empty()) {
+        rsp->setHeader("Vary", "Accept-Encoding");
+    } else if (strcasestr(vary.c_str(), "accept-encoding") == nullptr) {
+        rsp->setHeader("Vary", vary + ", Accept-Encoding");
+    }
+    ContentEncoding enc = NegotiateEncoding(req->getHeader("Accept-Encoding"));
+    if (enc == ContentEncoding::IDENTITY) {
+        return false;
+    }
+
+    std::string out;
+    std::string key;
+    size_t hash = 0;
+    uint64_t budget = g_compress_cache_size->getValue();
+    bool cache = rsp->isCacheable() && budget > 0;
+    bool hit = false;
+    if (cache) {
+        key = ContentEncodingToString(enc);
+        key.append(" ");
+        StringPiece path = req->getPathView();
+        StringPiece query = req->getQueryView();
+        key.append(path.data(), path.size());
+        if (!query.empty()) {
+            key.append("?");
+            key.append(query.data(), query.size());
+        }
+        hash = std::hash<std::string>()(body);
+        hit = GetCompressCache().get(key, hash, body.size(), out);
+    }
+    if (hit) {
+        ++s_cache_hits;
+    } else {
+        uint64_t begin = sylar::GetCurretUS();
+        bool ok = CompressBody(enc, body, out);
+        s_cpu_us += sylar::GetCurretUS() - begin;
+        // 压缩后没有变小 (已压缩过的数据) 就发原文
+        if (!ok || out.size() >= body.size()) {
+            return false;
+        }
+        if (cache) {
+            GetCompressCache().put(key, hash, body.size(), out, budget);
+        }
+    }
+    ++s_responses;
+    s_bytes_in += body.size();
+    s_bytes_out += out.size();
+    rsp->setHeader("Content-Encoding", ContentEncodingToString(enc));
+    // 压缩后的表示与原文不同, 强 ETag 要改成弱的
+    std::string etag = rsp->getHeader("ETag");
+    if (!etag.empty() && etag.compare(0, 2, "W/") != 0) {
+        rsp->setHeader("ETag", "W/" + etag);
+    }
+    rsp->setBody(out);
+    return true;
+}
+
+}
+}
@@ -0,0 +1,84 @@
+#ifndef __SYLAR_HTTP_COMPRESS_H__
+#define __SYLAR_HTTP_COMPRESS_H__
+
+#include <memory>
+#include <string>
+#include <zlib.h>
+#include "http.h"
+#include "sylar/noncopyable.h"
+
+namespace sylar {
+namespace http {
+
+enum class ContentEncoding {
+    IDENTITY = 0,
+    GZIP,
+    DEFLATE,        // zlib 格式 (RFC 1950)
+    BR,             // 编译时找到 libbrotlienc 才可用 (SYLAR_HAVE_BROTLI)
+};
+
+const char* ContentEncodingToString(ContentEncoding v);
+
+/**
+ * 按 Accept-Encoding (含 q 值和 "*") 选择编码, q 相同时 br > gzip > deflate
+ * 没有可用的编码返回 IDENTITY
+ */
+ContentEncoding NegotiateEncoding(const std::string& accept_encoding);
+
+/**
+ * 流式 zlib 压缩器 (gzip / deflate)
+ * 一个实例可以反复 reset() 复用, 省去每次 deflateInit 分配的约 256K 状态
+ */
+class ZlibCompressor : NonCopyable {
+public:
+    ZlibCompressor(bool gzip, int level);
+    ~ZlibCompressor();
+
+    // 开始新的一段压缩流
+    void reset();
+    /**
+     * 压缩 data 追加到 out
+     * flush: Z_NO_FLUSH 攒着, Z_SYNC_FLUSH 已输入的数据全部输出 (流式响应每块用),
+     *        Z_FINISH 结束流并写 trailer
+     */
+    bool update(const void* data, size_t len, std::string& out, int flush = Z_NO_FLUSH);
+
+    bool isGzip() const { return m_gzip;}
+    int getLevel() const { return m_level;}
+
+    // 当前线程复用的压缩器, 已 reset; level 变化时重建
+    static ZlibCompressor* GetThreadLocal(bool gzip, int level);
+private:
+    z_stream m_zs;
+    bool m_gzip;
+    int m_level;
+    bool m_ok;
+};
+
+// 一次压缩整个 body, 失败或不支持的编码返回 false
+bool CompressBody(ContentEncoding enc, const std::string& in, std::string& out);
+
+struct CompressStats {
+    uint64_t responses;     // 压缩的响应数 (含缓存命中)
+    uint64_t cacheHits;
+    uint64_t bytesIn;       // 压缩前的字节
+    uint64_t bytesOut;      // 压缩后的字节
+    uint64_t cpuUs;         // 花在压缩上的时间 (微秒, 不含缓存命中)
+};
+CompressStats GetCompressStats();
+void ResetCompressStats();
+
+/**
+ * HttpServer 发送响应前调用: 按 Accept-Encoding 压缩 rsp 的 body
+ * 跳过: 未开启 (http.server.compress.enable)、body 小于 http.server.compress.min_size、
+ * 已有 Content-Encoding、非文本类 Content-Type、204/206/304
+ * rsp->isCacheable() 时压缩结果按 (编码, uri) 放入 LRU (http.server.compress.cache_size 字节),
+ * body 的哈希和长度不变时直接复用
+ * 返回是否压缩了
+ */
+bool CompressResponse(HttpRequest::ptr req, HttpResponse::ptr rsp);
+
+}
+}
+
+#endif  // __SYLAR_HTTP_COMPRESS_H__
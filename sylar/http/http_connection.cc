@@ -1,12 +1,17 @@
 #include "http_connection.h"
 #include "http_parser.h"
 #include "sylar/log.h"
+#include "sylar/config.h"
 
 namespace sylar {
 namespace http {
 
 static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
+static sylar::ConfigVar<bool>::ptr g_http_client_fast_open =
+    sylar::Config::Lookup("http.client.fast_open", false
+            , "connect with tcp fast open, the request goes out with SYN");
+
 HttpResult::HttpResult(int res, HttpResponse::ptr rsp, const std::string& err)
         :result(res), response(rsp), error(err) {
 }
@@ -123,6 +128,12 @@ HttpResponse::ptr HttpConnection::recvResponse() {
 
     } else {  // 未 chunked 响应体
         int64_t body_length = parser->getContentLength();  // 获得 header 中 "content-length" 对应的 body 长度
+        if (m_buffer && offset > body_length) {
+            // 多读到的数据 (如 websocket 握手后服务端紧接着发的帧) 放回缓冲
+            int64_t used = body_length > 0 ? body_length : 0;
+            m_buffer->unread(data + used, offset - used);
+            offset = used;
+        }
         if (body_length > 0) {
             body.resize(body_length);
 
@@ -150,10 +161,20 @@ HttpResponse::ptr HttpConnection::recvResponse() {
 }
 
 int HttpConnection::sendRequest(HttpRequest::ptr req) {
-    std::stringstream ss;
-    ss << *req;
-    std::string data = ss.str();
-    return writeFixSize(data.c_str(), data.size());
+    // 头部写进复用的 m_headBuf, body 不拷贝, 两者一次 writev 发出
+    m_headBuf.clear();
+    req->encodeHead(m_headBuf);
+    const std::string& body = req->getBody();
+    iovec iov[2];
+    iov[0].iov_base = &m_headBuf[0];
+    iov[0].iov_len = m_headBuf.size();
+    iov[1].iov_base = (void*)body.data();
+    iov[1].iov_len = body.size();
+    int rt = writeFixSizeV(iov, 2);
+    if (rt > 0 && flush() < 0) {   // 开启了写缓冲时保证整个消息发出
+        return -1;
+    }
+    return rt;
 }
 
 // Get 请求 url -> Uri
@@ -255,6 +276,11 @@ HttpResult::ptr HttpConnection::DoRequest(HttpRequest::ptr req
                 "create socket failure: " + addr->toString() +
                 ", errno=" + std::to_string(errno) + " errstr=" + std::string(strerror(errno)));
     }
+    if (is_ssl) {
+        std::static_pointer_cast<SSLSocket>(sock)->setHostName(uri->getHost());
+    }
+    // Fast Open 时握手推迟到 sendRequest, 请求随 SYN 发出
+    sock->setFastOpenConnect(g_http_client_fast_open->getValue());
     if (!sock->connect(addr, timeout_ms)) {
         return std::make_shared<HttpResult>((int)HttpResult::Status::CONNECT_FAILURE, nullptr,
                  "connect_failure: " + addr->toString());
@@ -337,6 +363,11 @@ HttpConnection::ptr HttpConnectionPool::getConnection() {
             SYLAR_LOG_ERROR(g_logger) << "create sock failure: " << *addr;
             return nullptr;
         }
+        if (m_isHttps) {
+            // 池中的连接按 host:port 复用 TLS 会话
+            std::static_pointer_cast<SSLSocket>(sock)->setHostName(m_host);
+        }
+        sock->setFastOpenConnect(g_http_client_fast_open->getValue());
         if (!sock->connect(addr)) {
             SYLAR_LOG_ERROR(g_logger) << "socket connect failure: " << *addr;
             return nullptr;
@@ -82,6 +82,7 @@ public:
 private:
     uint64_t m_createdTime = 0;         // 创建时间, 供连接池用
     uint64_t m_request = 0;             // request 计数，供连接池用
+    std::string m_headBuf;              // 请求头序列化缓冲, 连接池复用连接时跨请求复用
 };
 
 // http connecion 连接池
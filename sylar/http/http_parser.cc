@@ -14,6 +14,12 @@ static sylar::ConfigVar<uint64_t>::ptr g_http_request_buffer_size =
 static sylar::ConfigVar<uint64_t>::ptr g_http_request_max_body_size = 
     sylar::Config::Lookup("http.request.max_body_size", (uint64_t)(64 * 1024 * 1024), "http request max body size");
 
+static sylar::ConfigVar<uint64_t>::ptr g_http_request_max_discard_size = 
+    sylar::Config::Lookup("http.request.max_discard_size", (uint64_t)(64 * 1024), "http request max unread body size to discard before closing");
+
+static sylar::ConfigVar<bool>::ptr g_http_request_zero_copy = 
+    sylar::Config::Lookup("http.request.zero_copy", true, "http request keep raw header buffer and parse into views");
+
 static sylar::ConfigVar<uint64_t>::ptr g_http_response_buffer_size = 
     sylar::Config::Lookup("http.response.buffer.size", (uint64_t)(4 * 1024), "http response buffer_size");
 
@@ -22,6 +28,8 @@ static sylar::ConfigVar<uint64_t>::ptr g_http_response_max_body_size =
     
 static uint64_t s_http_request_buffer_size = 0;
 static uint64_t s_http_request_max_body_size = 0;
+static uint64_t s_http_request_max_discard_size = 0;
+static bool s_http_request_zero_copy = true;
 static uint64_t s_http_response_buffer_size = 0;
 static uint64_t s_http_response_max_body_size = 0;
 
@@ -33,6 +41,14 @@ uint64_t HttpRequestParser::GetHttpRequestMaxBodySize() {
     return s_http_request_max_body_size;
 }
 
+uint64_t HttpRequestParser::GetHttpRequestMaxDiscardSize() {
+    return s_http_request_max_discard_size;
+}
+
+bool HttpRequestParser::IsHttpRequestZeroCopy() {
+    return s_http_request_zero_copy;
+}
+
 uint64_t HttpResponseParser::GetHttpResponseBufferSize() {
     return s_http_response_buffer_size;
 }
@@ -46,6 +62,8 @@ struct _RequestSizeIniter {
     _RequestSizeIniter() {
         s_http_request_buffer_size = g_http_request_buffer_size->getValue();
         s_http_request_max_body_size = g_http_request_max_body_size->getValue();
+        s_http_request_max_discard_size = g_http_request_max_discard_size->getValue();
+        s_http_request_zero_copy = g_http_request_zero_copy->getValue();
         s_http_response_buffer_size = g_http_response_buffer_size->getValue();
         s_http_response_max_body_size = g_http_response_max_body_size->getValue();
 
@@ -60,6 +78,16 @@ struct _RequestSizeIniter {
                 s_http_request_max_body_size = new_val;
         });
 
+        g_http_request_max_discard_size->addListener(
+            [](const uint64_t& old_val, const uint64_t& new_val){
+                s_http_request_max_discard_size = new_val;
+        });
+
+        g_http_request_zero_copy->addListener(
+            [](const bool& old_val, const bool& new_val){
+                s_http_request_zero_copy = new_val;
+        });
+
         g_http_response_buffer_size->addListener(
             [](const uint64_t& old_val, const uint64_t& new_val){
                 s_http_response_buffer_size = new_val;
@@ -97,16 +125,28 @@ void on_request_uri(void *data, const char *at, size_t length) {
 
 void on_request_fragment(void *data, const char *at, size_t length) {
     HttpRequestParser* parser = static_cast<HttpRequestParser*> (data);
+    if (parser->isZeroCopy()) {
+        parser->getData()->setFragmentView(StringPiece(at, length));
+        return;
+    }
     parser->getData()->setFragment(std::string(at, length));
 }
 
 void on_request_path(void *data, const char *at, size_t length) {
     HttpRequestParser* parser = static_cast<HttpRequestParser*> (data);
+    if (parser->isZeroCopy()) {
+        parser->getData()->setPathView(StringPiece(at, length));
+        return;
+    }
     parser->getData()->setPath(std::string(at, length));
 }
 
 void on_request_query(void *data, const char *at, size_t length) {
     HttpRequestParser* parser = static_cast<HttpRequestParser*> (data);
+    if (parser->isZeroCopy()) {
+        parser->getData()->setQueryView(StringPiece(at, length));
+        return;
+    }
     parser->getData()->setQuery(std::string(at, length));
 
 }
@@ -142,12 +182,17 @@ void on_request_http_field(void *data, const char *field, size_t flen, const cha
         // parser->setError(1002);
         return;     
     }
+    if (parser->isZeroCopy()) {
+        parser->getData()->addHeaderView(StringPiece(field, flen), StringPiece(value, vlen));
+        return;
+    }
     parser->getData()->setHeader(std::string(field, flen), std::string(value, vlen));
 }
 
 
 HttpRequestParser::HttpRequestParser()
-    :m_error(0) {
+    :m_error(0)
+    ,m_zeroCopy(false) {
     m_data.reset(new sylar::http::HttpRequest);
     http_parser_init(&m_parser);
     m_parser.request_method = on_request_method;
@@ -168,12 +213,20 @@ uint64_t HttpRequestParser::getContentLength() {
 
 // http_parser_execute() 解析函数
 // 1: success, -1: error, >0: 已处理的字节数，且 data 有效数据为 len - offset
-size_t HttpRequestParser::execute(char* data, size_t len) {
+size_t HttpRequestParser::execute(char* data, size_t len, bool move_remain) {
     size_t offset = http_parser_execute(&m_parser, data, len, 0);
-    memmove(data, data + offset, len - offset);  // 剩余数据拷贝到内存起始位置
+    if (move_remain) {
+        memmove(data, data + offset, len - offset);  // 剩余数据拷贝到内存起始位置
+    }
     return offset;
 }   
 
+void HttpRequestParser::reset() {
+    m_data.reset(new sylar::http::HttpRequest);
+    m_error = 0;
+    http_parser_init(&m_parser);    // 只重置状态, 回调与 data 保持不变
+}
+
 // 是否结束，与 http_parser_finish() 有关
 int HttpRequestParser::isFinished() {
     return http_parser_finish(&m_parser);
@@ -14,8 +14,10 @@ public:
     typedef std::shared_ptr<HttpRequestParser> ptr;
     HttpRequestParser();
 
-    // http_parser_execute()
-    size_t execute(char* data, size_t len);   
+    // http_parser_execute(), move_remain 为 true 时把未解析的数据移到 data 起始位置
+    size_t execute(char* data, size_t len, bool move_remain = true);   
+    // 重置解析状态并换一个新的 HttpRequest, 同一连接上解析下一个请求时复用解析器
+    void reset();
 
     // 是否结束，与 http_parser_finish() 有关
     int isFinished(); 
@@ -28,14 +30,25 @@ public:
 
     uint64_t getContentLength();
     const http_parser& getParser() const { return m_parser;}
+
+    /**
+     * 零拷贝模式: 回调只记录指向 data 的 StringPiece, 不构造 std::string
+     * 调用者需保证 execute() 的 data 在 HttpRequest 存活期间有效 (一般交给 HttpRequest::setRawBuffer 持有)
+     */
+    bool isZeroCopy() const { return m_zeroCopy;}
+    void setZeroCopy(bool v) { m_zeroCopy = v;}
 public:
     static uint64_t GetHttpRequestBufferSize();
     static uint64_t GetHttpRequestMaxBodySize();
+    // servlet 没读完的 body 最多丢弃多少字节, 超过时关闭连接
+    static uint64_t GetHttpRequestMaxDiscardSize();
+    static bool IsHttpRequestZeroCopy();
 private:    
     http_parser m_parser;
     HttpRequest::ptr m_data;            // 作为结果
     // 1000: invalid method, 1001: invalid version, 1002: invalid filed
     int m_error;                        // 是否有误, 
+    bool m_zeroCopy;                    // 是否零拷贝解析
 
 };
 
@@ -1,4 +1,5 @@
 #include "http_server.h"
+#include "http_compress.h"
 #include "sylar/log.h"
 
 namespace sylar {
@@ -6,6 +7,10 @@ namespace http {
 
 static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
+static sylar::ConfigVar<uint32_t>::ptr g_http_server_write_buffer_size =
+    sylar::Config::Lookup("http.server.write_buffer_size", (uint32_t)(64 * 1024)
+            , "http server response write buffer size, 0 disable");
+
 HttpServer::HttpServer(bool keepalive, sylar::IOManager*  worker, sylar::IOManager* accept_worker) 
         :TcpServer(worker, accept_worker)
         ,m_isKeepalive(keepalive) {
@@ -21,8 +26,12 @@ void HttpServer::setName(const std::string& v) {
 void HttpServer::handleClient(Socket::ptr client)  {
     // SYLAR_LOG_DEBUG(g_logger) << "handleClient " << *client;
     sylar::http::HttpSession::ptr session(new HttpSession(client));
+    // 流水线请求的响应先留在写缓冲, 缓冲中的请求处理完后一次发出
+    if (m_isKeepalive && g_http_server_write_buffer_size->getValue()) {
+        session->setBuffer(0, g_http_server_write_buffer_size->getValue());
+    }
     do {
-        auto req = session->recvRequest();
+        auto req = session->recvRequest(true);  // body 由 ServletDispatch 按 servlet 是否流式处理
         if (!req) {
             SYLAR_LOG_DEBUG(g_logger) << "recv http request failture, errno=" 
                     << errno << " errstr=" << strerror(errno)
@@ -32,7 +41,23 @@ void HttpServer::handleClient(Socket::ptr client)  {
         HttpResponse::ptr rsp(new HttpResponse(req->getVersion(), req->isClose() || !m_isKeepalive));
         rsp->setHeader("Server", getName());
         m_dispatch->handle(req, rsp, session);
-        session->sendResponse(rsp);
+        // servlet 没读完的 body 丢掉, 否则下一个请求会从 body 中间开始解析; 剩余太多时直接关闭连接
+        if (!rsp->isClose() && !req->discardBody(HttpRequestParser::GetHttpRequestMaxDiscardSize())) {
+            rsp->setClose(true);
+        }
+        if (session->isResponseStarted()) {     // servlet 已经流式发出了响应
+            if (session->endResponse() < 0) {
+                break;
+            }
+        } else {
+            CompressResponse(req, rsp);
+            if (session->sendResponse(rsp, !session->hasPendingRequest()) < 0) {
+                break;
+            }
+        }
+        if (rsp->isClose()) {
+            break;
+        }
 
         if(!m_isKeepalive || req->isClose()) {
             break;
@@ -1,80 +1,416 @@
 #include "http_session.h"
-#include "http_parser.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
 
 namespace sylar {
 namespace http {
 
+HttpBodyStream::HttpBodyStream(HttpSession* session, int64_t length)
+    :m_session(session)
+    ,m_length(length)
+    ,m_left(length > 0 ? length : 0)
+    ,m_chunked(length < 0)
+    ,m_finished(length == 0) {
+}
+
+int HttpBodyStream::read(void* buffer, size_t length) {
+    if (m_finished || length == 0) {
+        return 0;
+    }
+    if (m_chunked && m_left == 0) {
+        int rt = nextChunk();
+        if (rt <= 0) {
+            return rt;
+        }
+    }
+    size_t n = std::min((uint64_t)length, m_left);
+    int rt = m_session->read(buffer, n);
+    if (rt <= 0) {      // body 没收完连接就断了
+        return -1;
+    }
+    m_left -= rt;
+    if (m_left == 0) {
+        if (!m_chunked) {
+            m_finished = true;
+        } else {        // chunk 数据后的 \r\n
+            std::string line;
+            if (m_session->readLine(line, 2) <= 0 || !line.empty()) {
+                return -1;
+            }
+        }
+    }
+    return rt;
+}
+
+int HttpBodyStream::read(ByteArray::ptr ba, size_t length) {
+    char buf[16 * 1024];
+    int rt = read(buf, std::min(length, sizeof(buf)));
+    if (rt > 0) {
+        ba->write(buf, rt);
+    }
+    return rt;
+}
+
+int HttpBodyStream::nextChunk() {
+    // chunk-size [; chunk-ext] CRLF
+    std::string line;
+    if (m_session->readLine(line, 1024) <= 0) {
+        return -1;
+    }
+    char* end = nullptr;
+    uint64_t size = strtoull(line.c_str(), &end, 16);
+    if (end == line.c_str() || (*end && *end != ';' && *end != ' ' && *end != '\t')) {
+        return -1;
+    }
+    if (size > 0) {
+        m_left = size;
+        return 1;
+    }
+    // last-chunk 之后是 trailer, 以空行结束
+    do {
+        if (m_session->readLine(line, 8 * 1024) <= 0) {
+            return -1;
+        }
+    } while (!line.empty());
+    m_finished = true;
+    return 0;
+}
+
+HttpResponseStream::HttpResponseStream(HttpSession* session, int64_t length, bool head)
+    :m_session(session)
+    ,m_left(length > 0 ? length : 0)
+    ,m_chunked(length < 0)
+    ,m_head(head)
+    ,m_finished(false)
+    ,m_error(false)
+    ,m_corked(true) {
+}
+
+int HttpResponseStream::write(const void* buffer, size_t length) {
+    iovec iov;
+    iov.iov_base = (void*)buffer;
+    iov.iov_len = length;
+    return writev(&iov, 1);
+}
+
+int HttpResponseStream::write(ByteArray::ptr ba, size_t length) {
+    std::vector<iovec> iovs;
+    length = ba->getReadBuffers(iovs, length);
+    int rt = writev(&iovs[0], iovs.size());
+    if (rt > 0) {
+        ba->setPosition(ba->getPosition() + rt);
+    }
+    return rt;
+}
+
+// 全部写完才返回; chunked 时 iov 合成一个 chunk: 长度行 + 数据 + \r\n
+int HttpResponseStream::writev(const iovec* iov, size_t iovcnt) {
+    size_t total = 0;
+    for (size_t i = 0; i < iovcnt; ++i) {
+        total += iov[i].iov_len;
+    }
+    if (m_finished || m_error) {
+        return -1;
+    }
+    if (total == 0) {
+        return 0;   // 空 chunk 表示结束, 不能发
+    }
+    if (m_head) {
+        return total;
+    }
+    int rt = 0;
+    if (!m_chunked) {
+        if (total > m_left) {
+            return -1;
+        }
+        rt = m_session->writeFixSizeV(iov, iovcnt);
+        if (rt > 0) {
+            m_left -= total;
+        }
+    } else {
+        char head[24];
+        std::vector<iovec> iovs;
+        iovs.reserve(iovcnt + 2);
+        iovec i;
+        i.iov_base = head;
+        i.iov_len = snprintf(head, sizeof(head), "%zx\r\n", total);
+        iovs.push_back(i);
+        iovs.insert(iovs.end(), iov, iov + iovcnt);
+        i.iov_base = (void*)"\r\n";
+        i.iov_len = 2;
+        iovs.push_back(i);
+        rt = m_session->writeFixSizeV(&iovs[0], iovs.size());
+    }
+    if (rt <= 0) {
+        m_error = true;
+        return -1;
+    }
+    return total;
+}
+
+int HttpResponseStream::flush() {
+    if (m_error) {
+        return -1;
+    }
+    // 发出 cork 中攒的数据, 之后继续合并
+    if ((m_corked && m_session->uncork() < 0) || m_session->flush() < 0) {
+        m_error = true;
+        return -1;
+    }
+    if (m_corked) {
+        m_session->cork();
+    }
+    return 0;
+}
+
+int64_t HttpResponseStream::sendFile(int fd, off_t offset, size_t count) {
+    if (m_finished || m_error || (!m_chunked && count > m_left)) {
+        return -1;
+    }
+    if (count == 0 || m_head) {
+        return count;
+    }
+    if (m_chunked) {
+        char head[24];
+        int n = snprintf(head, sizeof(head), "%zx\r\n", count);
+        if (m_session->writeFixSize(head, n) <= 0) {
+            m_error = true;
+            return -1;
+        }
+    }
+    // 攒着的数据 (响应头, chunk 头) 必须先于文件内容发出
+    if (flush() < 0) {
+        return -1;
+    }
+    Socket::ptr sock = m_session->getSocket();
+    size_t left = count;
+    while (left > 0) {
+        ssize_t rt = sock->sendFile(fd, offset, left);
+        if (rt <= 0) {
+            m_error = true;
+            return -1;
+        }
+        offset += rt;
+        left -= rt;
+    }
+    if (m_chunked) {
+        if (m_session->writeFixSize("\r\n", 2) <= 0) {
+            m_error = true;
+            return -1;
+        }
+    } else {
+        m_left -= count;
+    }
+    return count;
+}
+
+int HttpResponseStream::finish() {
+    if (m_finished) {
+        return m_error ? -1 : 0;
+    }
+    m_finished = true;
+    if (!m_error && !m_head) {
+        if (m_chunked) {
+            if (m_session->writeFixSize("0\r\n\r\n", 5) <= 0) {
+                m_error = true;
+            }
+        } else if (m_left > 0) {
+            m_error = true;     // 客户端还在等剩下的 body
+        }
+    }
+    // 出错时也要去掉 cork, 连接上不能留着计数
+    if (m_corked) {
+        m_corked = false;
+        if (m_session->uncork() < 0) {
+            m_error = true;
+        }
+    }
+    if (!m_error && m_session->flush() < 0) {
+        m_error = true;
+    }
+    return m_error ? -1 : 0;
+}
+
 HttpSession::HttpSession(Socket::ptr sock, bool owner) 
-    : SocketStream(sock, owner) {
+    : SocketStream(sock, owner)
+    , m_parser(new HttpRequestParser)
+    , m_inPos(0)
+    , m_inEnd(0)
+    , m_method(HttpMethod::GET) {
 }
 
 // 获取 HTTP Request 结构体
-HttpRequest::ptr HttpSession::recvRequest() {
-    HttpRequestParser::ptr parser(new HttpRequestParser);
-    
-    // 申请一块缓冲区
+HttpRequest::ptr HttpSession::recvRequest(bool stream_body) {
     uint64_t buff_size = HttpRequestParser::GetHttpRequestBufferSize();
-    // uint64_t buff_size = 100;
-    std::shared_ptr<char> buffer(new char[buff_size], 
-        [](char* ptr){ delete[] ptr;});
-    
-    char* data = buffer.get();
-    int offset = 0;  // execute 解析后 data 的剩余长度，
-    do {
-        int len = read(data + offset, buff_size - offset);  // 在 offset 后继续读取数据
-        if (len <= 0) {
-            close();
-            return nullptr;
+    if (m_inBuf.size() < buff_size) {
+        m_inBuf.resize(buff_size);
+    }
+    m_parser->reset();
+    m_parser->setZeroCopy(HttpRequestParser::IsHttpRequestZeroCopy());
+
+    // 请求头收齐 (出现空行) 后一次解析; 缓冲中已有完整请求时不再读 socket
+    while (true) {
+        size_t avail = m_inEnd - m_inPos;
+        char* data = &m_inBuf[m_inPos];
+        const char* hdr_end = (const char*)memmem(data, avail, "\r\n\r\n", 4);
+        if (hdr_end) {
+            size_t nparse = 0;
+            if (m_parser->isZeroCopy()) {
+                // 请求头拷贝一次交给 HttpRequest 持有, 各字段只是指向它的 view
+                std::shared_ptr<std::string> raw = std::make_shared<std::string>(data, hdr_end + 4 - data);
+                m_parser->getData()->setRawBuffer(raw);
+                nparse = m_parser->execute(&(*raw)[0], raw->size(), false);
+            } else {
+                nparse = m_parser->execute(data, avail, false);
+            }
+            if (m_parser->hasError() || !m_parser->isFinished()) {
+                close();
+                return nullptr;
+            }
+            m_inPos += nparse;
+            break;
         }
-        len += offset;      // 当前 data 长度 = 当前读取的 data 长度 + 上次剩余的数据长度
-        size_t nparse = parser->execute(data, len);  // nparse 为成功解析的字节数，且 data 会向前移动 nparse 个字节
-        if (parser->hasError()) {
+        // 缓冲区满还未收齐请求头, 或连接断开
+        if (fillInput() <= 0) {
             close();
             return nullptr;
         }
-        offset = len - nparse;  // 此时 data 剩余的数据为：当前 data 长度 (len) - execute 移除的数据长度 (nparse)
-        if (offset == (int)buff_size) {  // 缓冲区满还未解析完
+    }
+
+    HttpRequest::ptr req = m_parser->getData();
+    req->init();
+    m_method = req->getMethod();
+    // Transfer-Encoding: chunked 优先于 Content-Length
+    StringPiece te;
+    bool chunked = req->getHeaderView("transfer-encoding", te)
+            && strcasestr(te.as_string().c_str(), "chunked");
+    int64_t body_length = chunked ? -1 : m_parser->getContentLength();  // 获得 header 中 "content-length" 对应的 body 长度
+    if (body_length != 0) {
+        req->setBodyStream(std::make_shared<HttpBodyStream>(this, body_length));
+        if (!stream_body
+                && req->loadBody(HttpRequestParser::GetHttpRequestMaxBodySize()) != 0) {
             close();
             return nullptr;
         }
-        if (parser->isFinished()) {  // 解析结束
-            break;
-        }
-    } while (true);
+    }
+    if (m_inPos == m_inEnd) {
+        m_inPos = m_inEnd = 0;
+    }
+    return req;  // 返回解析后的 HttpRequest
+}   
 
-    int64_t body_length = parser->getContentLength();  // 获得 header 中 "content-length" 对应的 body 长度
-    if (body_length > 0) {
-        std::string body;
-        body.resize(body_length);
+int HttpSession::fillInput() {
+    if (m_inPos > 0) {   // 剩余的半个请求移到缓冲头部
+        memmove(&m_inBuf[0], &m_inBuf[m_inPos], m_inEnd - m_inPos);
+        m_inEnd -= m_inPos;
+        m_inPos = 0;
+    }
+    if (m_inEnd == m_inBuf.size()) {
+        return -1;
+    }
+    int len = SocketStream::read(&m_inBuf[m_inEnd], m_inBuf.size() - m_inEnd);
+    if (len > 0) {
+        m_inEnd += len;
+    }
+    return len;
+}
 
-        int len = 0;
-        if (body_length >= offset) {     // body 长度 > 缓冲区剩余大小，将 data 中的数据全部复制到 body
-            memcpy(&body[0], data, offset);
-            len = offset;
-        } else {                    // 否则，直接取 body_length
-            memcpy(&body[0], data, body_length);
-            len = body_length;
-        }
-        body_length -= offset;
-        if (body_length > 0) {      // 缓冲区中的数据 < body_length，再从缓冲区读取数据直到满足 body_length
-            if (readFixSize(&body[len], body_length) <= 0) {
-                close();
-                return nullptr;
+int HttpSession::readLine(std::string& line, size_t max_size) {
+    while (true) {
+        size_t avail = m_inEnd - m_inPos;
+        const char* data = &m_inBuf[m_inPos];
+        const char* nl = (const char*)memchr(data, '\n', avail);
+        if (nl) {
+            size_t n = nl + 1 - data;
+            size_t len = n - 1;
+            if (len > 0 && data[len - 1] == '\r') {
+                --len;
             }
+            line.assign(data, len);
+            m_inPos += n;
+            return n;
+        }
+        if (avail > max_size) {
+            return -1;
+        }
+        int rt = fillInput();
+        if (rt <= 0) {
+            return rt;
         }
-        parser->getData()->setBody(body);   // 设置 body
     }
-    parser->getData()->init();
-    return parser->getData();  // 返回解析后的 HttpRequest
+}
 
-}   
+int HttpSession::read(void* buffer, size_t length) {
+    if (m_inPos < m_inEnd) {
+        size_t n = std::min(length, m_inEnd - m_inPos);
+        memcpy(buffer, &m_inBuf[m_inPos], n);
+        m_inPos += n;
+        return n;
+    }
+    return SocketStream::read(buffer, length);
+}
 
-int HttpSession::sendResponse(HttpResponse::ptr rsp) {
-    std::stringstream ss;
-    ss << *rsp;
-    std::string data = ss.str();
-    return writeFixSize(data.c_str(), data.size());
+int HttpSession::read(ByteArray::ptr ba, size_t length) {
+    if (m_inPos < m_inEnd) {
+        size_t n = std::min(length, m_inEnd - m_inPos);
+        ba->write(&m_inBuf[m_inPos], n);
+        m_inPos += n;
+        return n;
+    }
+    return SocketStream::read(ba, length);
 }
 
+int HttpSession::sendResponse(HttpResponse::ptr rsp, bool flush_now) {
+    // 头部写进复用的 m_headBuf, body 不拷贝, 两者一次 writev 发出
+    m_headBuf.clear();
+    rsp->encodeHead(m_headBuf);
+    const std::string& body = rsp->getBody();
+    iovec iov[2];
+    iov[0].iov_base = &m_headBuf[0];
+    iov[0].iov_len = m_headBuf.size();
+    iov[1].iov_base = (void*)body.data();
+    iov[1].iov_len = m_method == HttpMethod::HEAD ? 0 : body.size();    // HEAD 只发头部, Content-Length 照常
+    int rt = writeFixSizeV(iov, 2);
+    if (rt > 0 && flush_now && flush() < 0) {   // 开启了写缓冲时保证整个消息发出
+        return -1;
+    }
+    return rt;
+}
+HttpResponseStream::ptr HttpSession::beginResponse(HttpResponse::ptr rsp, int64_t content_length) {
+    rsp->setBody("");       // body 不随头部发出
+    rsp->delHeader("content-length");
+    rsp->delHeader("transfer-encoding");
+    int64_t length = content_length;
+    if (content_length >= 0) {
+        rsp->setHeader("Content-Length", std::to_string(content_length));
+    } else if (rsp->getVersion() >= 0x11) {
+        rsp->setHeader("Transfer-Encoding", "chunked");
+    } else if (m_method != HttpMethod::HEAD) {
+        rsp->setClose(true);    // HTTP/1.0 没有分块, 以关闭连接结束 body
+        length = INT64_MAX;
+    }
+
+    // 头部不单独发一次, 由 HttpResponseStream 在 flush/finish 时去掉 cork
+    m_headBuf.clear();
+    rsp->encodeHead(m_headBuf);
+    cork();
+    if (writeFixSize(m_headBuf.c_str(), m_headBuf.size()) <= 0) {
+        uncork();
+        return nullptr;
+    }
+    m_rspStream = std::make_shared<HttpResponseStream>(this, length, m_method == HttpMethod::HEAD);
+    return m_rspStream;
+}
+
+int HttpSession::endResponse() {
+    if (!m_rspStream) {
+        return 0;
+    }
+    int rt = m_rspStream->finish();
+    m_rspStream.reset();
+    return rt;
+}
+
+}
 }
-}
\ No newline at end of file
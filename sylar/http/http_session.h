@@ -1,24 +1,158 @@
 #ifndef __SYLAR_HTTP_SESSION_H__
 #define __SYLAR_HTTP_SESSION_H__
 
+#include <vector>
 #include "sylar/socket_stream.h"
 #include "http.h"
+#include "http_parser.h"
  
 namespace sylar {
 namespace http {
 
+class HttpSession;
+
+/**
+ * 请求 body 的只读流, 按 Content-Length 截断或解码 Transfer-Encoding: chunked
+ * 读到 body 结尾返回 0, body 不完整 (连接断开、chunk 格式错误) 返回 -1
+ * 只在所属 HttpSession 存活期间有效, close() 不关闭连接
+ */
+class HttpBodyStream : public Stream {
+public:
+    typedef std::shared_ptr<HttpBodyStream> ptr;
+    // length 为 -1 表示 chunked
+    HttpBodyStream(HttpSession* session, int64_t length);
+
+    virtual int read(void* buffer, size_t length) override;
+    virtual int read(ByteArray::ptr ba, size_t length) override;
+    virtual int write(const void* buffer, size_t length) override { return -1;}
+    virtual int write(ByteArray::ptr ba, size_t length) override { return -1;}
+    virtual void close() override {}
+
+    bool isChunked() const { return m_chunked;}
+    bool isFinished() const { return m_finished;}
+    // Content-Length, chunked 时为 -1
+    int64_t getLength() const { return m_chunked ? -1 : m_length;}
+private:
+    // 读下一个 chunk 的长度行, 返回 1 有数据, 0 最后一个 chunk (已读完 trailer), -1 出错
+    int nextChunk();
+private:
+    HttpSession* m_session;
+    int64_t m_length;
+    uint64_t m_left;            // 当前 (chunk) 剩余未读的字节
+    bool m_chunked;
+    bool m_finished;
+};
+
+/**
+ * 流式响应的 body, 由 HttpSession::beginResponse 创建
+ * chunked 时每次 write 发一个 chunk, 否则按 Content-Length 原样发送, 超出长度的写入返回 -1
+ * 写直接走连接 (阻塞当前协程直到 socket 可写), 慢客户端会反压到 servlet
+ * 响应期间连接处于 cork 状态: 响应头、chunk 头尾等小块先攒着, 与下一块 body 一次 writev 发出;
+ * 需要及时送达的 (如 SSE) 调用 flush(), finish() 时全部发出
+ * HEAD 请求的响应只发头部, body 的写入直接返回成功
+ */
+class HttpResponseStream : public Stream {
+public:
+    typedef std::shared_ptr<HttpResponseStream> ptr;
+    // length 为 -1 表示 chunked, head 为 true 时丢弃 body
+    HttpResponseStream(HttpSession* session, int64_t length, bool head = false);
+
+    virtual int read(void* buffer, size_t length) override { return -1;}
+    virtual int read(ByteArray::ptr ba, size_t length) override { return -1;}
+    virtual int write(const void* buffer, size_t length) override;
+    virtual int write(ByteArray::ptr ba, size_t length) override;
+    virtual int writev(const iovec* iov, size_t iovcnt) override;
+    virtual int flush() override;
+    /**
+     * 把文件 fd 从 offset 开始的 count 个字节作为 body 发出 (chunked 时作为一个 chunk)
+     * 先 flush 写缓冲, 再用 Socket::sendFile (sendfile), 数据不经过用户态
+     * 全部发完返回 count, 出错返回 -1
+     */
+    int64_t sendFile(int fd, off_t offset, size_t count);
+    // 同 finish(), 不关闭连接
+    virtual void close() override { finish();}
+
+    /**
+     * 结束响应: chunked 时发出最后的空 chunk; 返回 0 成功,
+     * -1 写出错或 Content-Length 没有写够 (连接只能关闭)
+     */
+    int finish();
+
+    bool isChunked() const { return m_chunked;}
+    bool isFinished() const { return m_finished;}
+    bool isHead() const { return m_head;}
+private:
+    HttpSession* m_session;
+    uint64_t m_left;            // Content-Length 剩余的字节
+    bool m_chunked;
+    bool m_head;
+    bool m_finished;
+    bool m_error;
+    bool m_corked;              // 是否还持有连接的 cork (beginResponse 中加上)
+};
+
+/**
+ * 服务端 HTTP 连接
+ * 每个连接一块常驻的输入缓冲 (http.request.buffer.size) 和一个可重置的解析器:
+ * 读多了的数据 (流水线中的下一个请求, 升级后的 websocket 帧) 留在缓冲中, 下次 recvRequest/read 先取缓冲
+ */
 class HttpSession : public SocketStream{
 public:
     typedef std::shared_ptr<HttpSession> ptr;
     HttpSession(Socket::ptr sock, bool owner = true);
 
-    HttpRequest::ptr recvRequest();  // 获取 HTTP Request 结构体
-    int sendResponse(HttpResponse::ptr rsp);
-    
+    /**
+     * 获取 HTTP Request 结构体
+     * stream_body 为 false 时收完整个 body (Content-Length 或 chunked) 放入 getBody();
+     * 为 true 时只收请求头, body 通过 req->getBodyStream() (HttpBodyStream) 读取, 无 body 时为 nullptr
+     */
+    HttpRequest::ptr recvRequest(bool stream_body = false);
+    /**
+     * 发送响应, 当前请求是 HEAD 时不发 body, flush_now 为 false 时 (开启了写缓冲) 响应可以留在写缓冲中, 与后面的响应一起发出
+     */
+    int sendResponse(HttpResponse::ptr rsp, bool flush_now = true);
+
+    /**
+     * 流式响应: 写出 rsp 的状态行和头部 (忽略 rsp 的 body), 之后通过返回的流写 body
+     * 头部攒在 cork 缓冲中, 与第一块 body 一起发出 (或在返回的流 flush/finish 时发出)
+     * content_length >= 0 时带 Content-Length, 否则 HTTP/1.1 用 Transfer-Encoding: chunked,
+     * HTTP/1.0 不分块, 以关闭连接结束 body
+     * 当前请求是 HEAD 时只发头部 (头部照常带 Content-Length / chunked), 写入的 body 被丢弃
+     * servlet 在 handle() 中写完, handle() 返回后由 HttpServer 调用 endResponse() 结束
+     * 发送头部失败返回 nullptr
+     */
+    HttpResponseStream::ptr beginResponse(HttpResponse::ptr rsp, int64_t content_length = -1);
+    // 当前请求是否已经开始流式响应
+    bool isResponseStarted() const { return (bool)m_rspStream;}
+    // 结束当前的流式响应, 返回值同 HttpResponseStream::finish()
+    int endResponse();
+
+    // 输入缓冲中已经有下一个请求的数据 (客户端流水线发送)
+    bool hasPendingRequest() const { return m_inEnd > m_inPos;}
+
+    // 先读输入缓冲中剩余的数据
+    virtual int read(void* buffer, size_t length) override;
+    virtual int read(ByteArray::ptr ba, size_t length) override;
+
+    /**
+     * 从输入缓冲读一行, line 不含行尾的 \r\n; 缓冲中没有完整的行时从 socket 补充
+     * 返回消耗的字节数 (含换行), <= 0 同 read(), 超过 max_size 还没有换行返回 -1
+     */
+    int readLine(std::string& line, size_t max_size);
+private:
+    // 把未处理的数据移到缓冲头部后从 socket 读一次, 返回读到的字节数, 缓冲已满返回 -1
+    int fillInput();
 private:
+    HttpRequestParser::ptr m_parser;
+    std::vector<char> m_inBuf;
+    size_t m_inPos;             // 未处理的数据 [m_inPos, m_inEnd)
+    size_t m_inEnd;
+    std::string m_headBuf;      // 响应头序列化缓冲, 跨响应复用
+    HttpMethod m_method;        // 最近一次 recvRequest 的请求方法, 决定响应是否带 body
+    HttpResponseStream::ptr m_rspStream;    // 当前的流式响应
 };
 
 }
 }
 
-#endif  // __SYLAR_HTTP_SESSION_H__
\ No newline at end of file
+#endif  // __SYLAR_HTTP_SESSION_H__
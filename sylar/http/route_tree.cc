@@ -0,0 +1,169 @@
+#include "route_tree.h"
+#include <string.h>
+#include <algorithm>
+
+namespace sylar {
+namespace http {
+
+RouteTree::Node::~Node() {
+    for (auto& i : children) {
+        delete i;
+    }
+    delete param;
+}
+
+RouteTree::RouteTree()
+    :m_size(0) {
+}
+
+RouteTree::~RouteTree() {
+}
+
+// ':' 和 '*' 只有出现在段首时才是参数/通配
+static bool IsSegmentStart(const std::string& pattern, size_t pos) {
+    return (pattern[pos] == ':' || pattern[pos] == '*') && pos > 0 && pattern[pos - 1] == '/';
+}
+
+bool RouteTree::insert(const std::string& pattern, std::shared_ptr<Servlet> slt) {
+    if (pattern.empty() || pattern[0] != '/' || !slt) {
+        return false;
+    }
+    Node* n = &m_root;
+    size_t pos = 0;
+    size_t len = pattern.size();
+    while (pos < len) {
+        size_t k = pos;
+        while (k < len && !IsSegmentStart(pattern, k)) {
+            ++k;
+        }
+        if (k > pos) {
+            n = InsertStatic(n, StringPiece(pattern.data() + pos, k - pos));
+        }
+        if (k == len) {
+            break;
+        }
+
+        size_t e = pattern.find('/', k);
+        if (e == std::string::npos) {
+            e = len;
+        }
+        std::string name = pattern.substr(k + 1, e - k - 1);
+        if (pattern[k] == '*') {
+            if (e != len) {     // 通配只能在结尾
+                return false;
+            }
+            if (!n->wildcard) {
+                ++m_size;
+            }
+            n->wildcard = slt;
+            n->wildcardName = name.empty() ? "*" : name;
+            return true;
+        }
+
+        if (name.empty()) {
+            return false;
+        }
+        if (!n->param) {
+            n->param = new Node;
+            n->paramName = name;
+        } else if (n->paramName != name) {
+            return false;
+        }
+        n = n->param;
+        pos = e;
+    }
+    if (!n->servlet) {
+        ++m_size;
+    }
+    n->servlet = slt;
+    return true;
+}
+
+RouteTree::Node* RouteTree::InsertStatic(Node* n, StringPiece s) {
+    while (!s.empty()) {
+        size_t i = n->indices.find(s[0]);
+        if (i == std::string::npos) {
+            Node* c = new Node;
+            c->prefix = s.as_string();
+            n->indices.push_back(s[0]);
+            n->children.push_back(c);
+            return c;
+        }
+
+        Node* c = n->children[i];
+        size_t max = std::min(c->prefix.size(), (size_t)s.size());
+        size_t common = 0;
+        while (common < max && c->prefix[common] == s[common]) {
+            ++common;
+        }
+        if (common < c->prefix.size()) {
+            // 拆分: 公共前缀成为新的中间节点, c 保留剩下的部分
+            Node* mid = new Node;
+            mid->prefix = c->prefix.substr(0, common);
+            c->prefix.erase(0, common);
+            mid->indices.push_back(c->prefix[0]);
+            mid->children.push_back(c);
+            n->children[i] = mid;
+            c = mid;
+        }
+        s.remove_prefix(common);
+        n = c;
+    }
+    return n;
+}
+
+bool RouteTree::Match(const Node* n, StringPiece path, Params* params, std::shared_ptr<Servlet>& out) {
+    if (path.empty() && n->servlet) {
+        out = n->servlet;
+        return true;
+    }
+
+    if (!path.empty()) {
+        size_t i = n->indices.find(path[0]);
+        if (i != std::string::npos) {
+            const Node* c = n->children[i];
+            if (path.starts_with(c->prefix)
+                    && Match(c, StringPiece(path.data() + c->prefix.size()
+                            , path.size() - c->prefix.size()), params, out)) {
+                return true;
+            }
+        }
+
+        if (n->param) {
+            const char* e = (const char*)memchr(path.data(), '/', path.size());
+            int seg = e ? e - path.data() : path.size();
+            if (seg > 0) {
+                size_t old = params ? params->size() : 0;
+                if (params) {
+                    params->push_back(std::make_pair(StringPiece(n->paramName), StringPiece(path.data(), seg)));
+                }
+                if (Match(n->param, StringPiece(path.data() + seg, path.size() - seg), params, out)) {
+                    return true;
+                }
+                if (params) {
+                    params->resize(old);    // 回溯
+                }
+            }
+        }
+    }
+
+    if (n->wildcard) {
+        if (params) {
+            params->push_back(std::make_pair(StringPiece(n->wildcardName), path));
+        }
+        out = n->wildcard;
+        return true;
+    }
+    return false;
+}
+
+std::shared_ptr<Servlet> RouteTree::match(const StringPiece& path, Params* params) const {
+    std::shared_ptr<Servlet> out;
+    if (m_size && Match(&m_root, path, params, out)) {
+        return out;
+    }
+    return nullptr;
+}
+
+}
+}
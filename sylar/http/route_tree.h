@@ -0,0 +1,67 @@
+#ifndef __SYLAR_HTTP_ROUTE_TREE_H__
+#define __SYLAR_HTTP_ROUTE_TREE_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "sylar/stringpiece.h"
+#include "sylar/noncopyable.h"
+
+namespace sylar {
+namespace http {
+
+class Servlet;
+
+/**
+ * 压缩前缀树 (radix tree) 路由
+ * 路由格式: 静态部分逐字节匹配; ":name" 占一整段, 匹配到下一个 '/' 为止;
+ * 结尾的 "*name" (或 "*") 匹配剩余的全部路径 (可以为空, 可以含 '/')
+ * 例: "/user/:id/posts"; "/static/" 之后接 "*file" 匹配其下的所有文件
+ * 匹配优先级: 静态 > :param > 通配, 失败时回溯, 与路由添加顺序无关
+ * 查找只读, 不分配内存 (捕获的参数指向树中的名字和传入的 path)
+ */
+class RouteTree : NonCopyable {
+public:
+    typedef std::shared_ptr<RouteTree> ptr;
+    // (参数名, 参数值), 通配未命名时参数名为 "*"
+    typedef std::vector<std::pair<StringPiece, StringPiece> > Params;
+
+    RouteTree();
+    ~RouteTree();
+
+    /**
+     * 添加路由, 同一路由再次添加时覆盖
+     * 路由不以 '/' 开头、通配不在结尾、同一位置的 :param 名字冲突时返回 false
+     */
+    bool insert(const std::string& pattern, std::shared_ptr<Servlet> slt);
+    // 匹配 path, 未匹配返回 nullptr; params 不为空时追加捕获的参数
+    std::shared_ptr<Servlet> match(const StringPiece& path, Params* params = nullptr) const;
+
+    bool empty() const { return m_size == 0;}
+    size_t size() const { return m_size;}
+private:
+    struct Node {
+        std::string prefix;                 // 静态前缀 (:param 节点为空)
+        std::string indices;                // 各静态子节点前缀的首字节, 与 children 一一对应
+        std::vector<Node*> children;        // 静态子节点
+        Node* param = nullptr;              // ":name" 子节点
+        std::string paramName;
+        std::shared_ptr<Servlet> wildcard;  // "*name" 结尾的路由
+        std::string wildcardName;
+        std::shared_ptr<Servlet> servlet;   // 恰好在此结束的路由
+
+        ~Node();
+    };
+
+    // 在 n 之下插入静态串 s, 返回 s 结束处的节点
+    static Node* InsertStatic(Node* n, StringPiece s);
+    static bool Match(const Node* n, StringPiece path, Params* params, std::shared_ptr<Servlet>& out);
+private:
+    Node m_root;
+    size_t m_size;
+};
+
+}
+}
+
+#endif  // __SYLAR_HTTP_ROUTE_TREE_H__
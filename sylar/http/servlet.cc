@@ -16,75 +16,187 @@ int32_t FunctionServlet::handle(sylar::http::HttpRequest::ptr request
 }
 
 
+static std::atomic<uint64_t> s_dispatch_id(0);
+
 ServletDispatch::ServletDispatch()
-    :Servlet("ServletDispatch") {
-    m_default.reset(new NotFoundServlet("sylar/1.0"));
+    :Servlet("ServletDispatch")
+    ,m_version(0)
+    ,m_id(++s_dispatch_id) {
+    std::shared_ptr<Table> t = std::make_shared<Table>();
+    t->routeTree.reset(new RouteTree);
+    t->deflt.reset(new NotFoundServlet("sylar/1.0"));
+    setTable(t);
 }
 
 int32_t ServletDispatch::handle(sylar::http::HttpRequest::ptr request
         ,sylar::http::HttpResponse::ptr response
         ,sylar::http::HttpSession::ptr session) {
     
-    auto slt = getMatchedServlet(request->getPath());
+    // 零拷贝解析时 path 是指向请求头缓冲的 view, 路由不必先物化成 string
+    auto slt = getMatchedServlet(request->getPathView(), request);
     if (slt) {
+        // 非流式 servlet 先收完 body
+        if (!slt->isStreamingBody()) {
+            int rt = request->loadBody(HttpRequestParser::GetHttpRequestMaxBodySize());
+            if (rt != 0) {
+                response->setStatus(rt == -2 ? HttpStatus::PAYLOAD_TOO_LARGE : HttpStatus::BAD_REQUEST);
+                response->setClose(true);
+                return -1;
+            }
+        }
         slt->handle(request, response,session);
     }
     return 0;
 }
 
+const ServletDispatch::Table& ServletDispatch::getTable() const {
+    // 线程退出时释放; ServletDispatch 析构后残留的项持有其最后的快照, 直到线程退出
+    struct Cached {
+        uint64_t id;
+        uint64_t version;
+        Table::ptr table;
+    };
+    static thread_local std::vector<Cached> t_tables;
+
+    uint64_t version = m_version.load(std::memory_order_acquire);
+    Cached* c = nullptr;
+    for (auto& i : t_tables) {
+        if (i.id == m_id) {
+            if (i.version == version) {
+                return *i.table;
+            }
+            c = &i;
+            break;
+        }
+    }
+    if (!c) {
+        t_tables.push_back(Cached{m_id, 0, nullptr});
+        c = &t_tables.back();
+    }
+    MutexType::Lock lock(m_mutex);
+    c->table = m_table;
+    c->version = m_version.load(std::memory_order_relaxed);
+    return *c->table;
+}
+
+void ServletDispatch::setTable(std::shared_ptr<Table> v) {
+    m_table = v;
+    m_version.fetch_add(1, std::memory_order_release);
+}
+
 // 添加到 精准匹配
 void  ServletDispatch::addServlet(const std::string& uri, Servlet::ptr slt) {
-    RWMutexType::WriteLock lock(m_mutex);
-    m_data[uri] = slt;
+    MutexType::Lock lock(m_mutex);
+    std::shared_ptr<Table> t = copyTable();
+    t->data[uri] = slt;
+    setTable(t);
 }   
 
 void  ServletDispatch::addServlet(const std::string& uri, FunctionServlet::callback cb) {
-    RWMutexType::WriteLock lock(m_mutex);
-    m_data[uri].reset(new FunctionServlet(cb));
+    addServlet(uri, FunctionServlet::ptr(new FunctionServlet(cb)));
 }
 
 // 添加到 模糊匹配
 void  ServletDispatch::addGlobServlet(const std::string& uri, Servlet::ptr slt) {
-    RWMutexType::WriteLock lock(m_mutex);
-    for (auto it = m_globs.begin(); it != m_globs.end(); ++it) {
+    MutexType::Lock lock(m_mutex);
+    std::shared_ptr<Table> t = copyTable();
+    for (auto it = t->globs.begin(); it != t->globs.end(); ++it) {
         if (it->first == uri) {
-            m_globs.erase(it);
+            t->globs.erase(it);
             break;
         }
     }
-    m_globs.push_back(std::make_pair(uri, slt));
+    t->globs.push_back(std::make_pair(uri, slt));
+    setTable(t);
 }              
 
 void ServletDispatch::addGlobServlet(const std::string& uri, FunctionServlet::callback cb) {
     addGlobServlet(uri, FunctionServlet::ptr(new FunctionServlet(cb)));
 }
 
+// 添加到 路由匹配, 已发布的树不能修改, 连同已有路由重建一棵
+bool ServletDispatch::addRouteServlet(const std::string& pattern, Servlet::ptr slt) {
+    MutexType::Lock lock(m_mutex);
+    std::shared_ptr<Table> t = copyTable();
+    RouteTree::ptr tree(new RouteTree);
+    for (auto& i : t->routes) {
+        tree->insert(i.first, i.second);
+    }
+    if (!tree->insert(pattern, slt)) {
+        return false;
+    }
+    for (auto it = t->routes.begin(); it != t->routes.end(); ++it) {
+        if (it->first == pattern) {
+            t->routes.erase(it);
+            break;
+        }
+    }
+    t->routes.push_back(std::make_pair(pattern, slt));
+    t->routeTree = tree;
+    setTable(t);
+    return true;
+}
+
+bool ServletDispatch::addRouteServlet(const std::string& pattern, FunctionServlet::callback cb) {
+    return addRouteServlet(pattern, FunctionServlet::ptr(new FunctionServlet(cb)));
+}
+
 void ServletDispatch::delServlet(const std::string& uri) {
-    RWMutexType::WriteLock lock(m_mutex);
-    m_data.erase(uri);
+    MutexType::Lock lock(m_mutex);
+    std::shared_ptr<Table> t = copyTable();
+    if (t->data.erase(uri)) {
+        setTable(t);
+    }
 }
 
 void ServletDispatch::delGlobServlet(const std::string& uri) {
-    RWMutexType::WriteLock lock(m_mutex);
-    for (auto it = m_globs.begin(); it != m_globs.end(); ++it) {
+    MutexType::Lock lock(m_mutex);
+    std::shared_ptr<Table> t = copyTable();
+    for (auto it = t->globs.begin(); it != t->globs.end(); ++it) {
         if (it->first == uri) {
-            m_globs.erase(it);
+            t->globs.erase(it);
+            setTable(t);
+            break;
+        }
+    }
+}
+
+// 树不支持删除节点, 用剩下的路由重建
+void ServletDispatch::delRouteServlet(const std::string& pattern) {
+    MutexType::Lock lock(m_mutex);
+    std::shared_ptr<Table> t = copyTable();
+    for (auto it = t->routes.begin(); it != t->routes.end(); ++it) {
+        if (it->first == pattern) {
+            t->routes.erase(it);
+            RouteTree::ptr tree(new RouteTree);
+            for (auto& i : t->routes) {
+                tree->insert(i.first, i.second);
+            }
+            t->routeTree = tree;
+            setTable(t);
             break;
         }
     }
 }
 
+void ServletDispatch::setDefault(Servlet::ptr v) {
+    MutexType::Lock lock(m_mutex);
+    std::shared_ptr<Table> t = copyTable();
+    t->deflt = v;
+    setTable(t);
+}
+
 // 得到 精准匹配结果
 Servlet::ptr ServletDispatch::getServlet(const std::string& uri) {
-    RWMutexType::ReadLock lock(m_mutex);
-    auto it = m_data.find(uri);
-    return it == m_data.end() ? nullptr : it->second;
+    const Table& t = getTable();
+    auto it = t.data.find(uri);
+    return it == t.data.end() ? nullptr : it->second;
 }
 
 // 得到 模糊匹配结果                            
 Servlet::ptr ServletDispatch::getGlobServlet(const std::string& uri) {
-    RWMutexType::ReadLock lock(m_mutex);
-    for (auto it = m_globs.begin(); it != m_globs.end(); ++it) {
+    const Table& t = getTable();
+    for (auto it = t.globs.begin(); it != t.globs.end(); ++it) {
         if (it->first == uri) {
             return it->second;
         }
@@ -92,19 +204,35 @@ Servlet::ptr ServletDispatch::getGlobServlet(const std::string& uri) {
     return nullptr;
 }                        
 
-Servlet::ptr ServletDispatch::getMatchedServlet(const std::string& uri) {
-    RWMutexType::ReadLock lock(m_mutex);
-    auto mit = m_data.find(uri);
-    if (mit != m_data.end()) {
+// 版本没变时不加锁: 整个查找过程使用当前线程缓存的同一个快照, 期间的修改不可见也不会释放它
+Servlet::ptr ServletDispatch::getMatchedServlet(const StringPiece& uri, HttpRequest::ptr req) {
+    // 精准匹配的 key 和 fnmatch 需要 string, 复用线程内的缓冲, 预热后不再分配
+    static thread_local std::string t_uri;
+    t_uri.assign(uri.data(), uri.size());
+
+    const Table& t = getTable();
+    auto mit = t.data.find(t_uri);
+    if (mit != t.data.end()) {
         return mit->second;
     }   
 
-    for (auto it = m_globs.begin(); it != m_globs.end(); ++it) {
-        if (!fnmatch(it->first.c_str(), uri.c_str(), 0)) {
+    if (!t.routeTree->empty()) {
+        RouteTree::Params params;
+        auto slt = t.routeTree->match(uri, req ? &params : nullptr);
+        if (slt) {
+            for (auto& i : params) {    // 参数名指向快照中的树, 返回前转成 string
+                req->setPathParam(i.first.as_string(), i.second.as_string());
+            }
+            return slt;
+        }
+    }
+
+    for (auto it = t.globs.begin(); it != t.globs.end(); ++it) {
+        if (!fnmatch(it->first.c_str(), t_uri.c_str(), 0)) {
             return it->second;
         }
     }
-    return m_default;
+    return t.deflt;
 }
 
 NotFoundServlet::NotFoundServlet(const std::string& name)
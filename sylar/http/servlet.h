@@ -2,12 +2,14 @@
 #define __SYALR_HTTP_SERVLET_H__
 
 #include <memory>
+#include <atomic>
 #include <string>
 #include <functional>
 #include <vector>
 #include <unordered_map>
 #include "http.h"
 #include "http_session.h"
+#include "route_tree.h"
 #include "sylar/thread.h"
 
 namespace sylar {
@@ -17,7 +19,7 @@ class Servlet {
 public:
     typedef std::shared_ptr<Servlet> ptr;
 
-    Servlet(const std::string& name) : m_name(name) {}
+    Servlet(const std::string& name) : m_name(name), m_streamingBody(false) {}
     virtual ~Servlet() {}
 
     virtual int32_t handle(sylar::http::HttpRequest::ptr request
@@ -25,8 +27,16 @@ public:
                             ,sylar::http::HttpSession::ptr session) = 0;
     
     const std::string& getName() const { return m_name;}
+
+    /**
+     * 流式接收 body: ServletDispatch 不再先把 body 收进 getBody(),
+     * servlet 从 request->getBodyStream() 边读边处理 (没读完的部分在请求结束后被丢弃)
+     */
+    bool isStreamingBody() const { return m_streamingBody;}
+    void setStreamingBody(bool v) { m_streamingBody = v;}
 protected:
     std::string m_name;
+    bool m_streamingBody;
 };
 
 class FunctionServlet : public Servlet {
@@ -45,10 +55,18 @@ private:
     callback m_cb;
 };
 
+/**
+ * servlet 分发
+ * 路由表是不可变的快照 (Table), 修改 (add/del/setDefault) 在 m_mutex 下复制当前快照、修改后替换,
+ * 并递增版本号 m_version; 每个线程缓存自己拿到的快照和版本号, 查找时只读一次 m_version (atomic),
+ * 版本没变就直接用缓存的快照, 不加锁、也不碰共享的引用计数; 版本变了才在 m_mutex 下取一次新快照
+ * 旧快照在所有线程都换掉 (或线程退出) 后回收
+ * 路由在启动时设置、很少修改, 每次修改的代价是 O(路由数)
+ */
 class ServletDispatch : public Servlet {
 public:
     typedef std::shared_ptr<ServletDispatch> ptr;
-    typedef RWMutex RWMutexType;
+    typedef Mutex MutexType;
 
     ServletDispatch();
     virtual int32_t handle(sylar::http::HttpRequest::ptr request
@@ -60,22 +78,55 @@ public:
     void addGlobServlet(const std::string& uri, Servlet::ptr slt);              // 添加到 模糊匹配
     void addGlobServlet(const std::string& uri, FunctionServlet::callback cb);
 
+    /**
+     * 添加到 路由匹配 (RouteTree), 支持静态段, ":name" 参数段和结尾的 "*name" 通配
+     * 匹配顺序: 精准匹配 > 路由匹配 > 模糊匹配 > 默认; 捕获的参数放入 HttpRequest::getPathParams()
+     * 路由格式错误返回 false
+     */
+    bool addRouteServlet(const std::string& pattern, Servlet::ptr slt);
+    bool addRouteServlet(const std::string& pattern, FunctionServlet::callback cb);
+
     void delServlet(const std::string& uri);
     void delGlobServlet(const std::string& uri);
+    void delRouteServlet(const std::string& pattern);
 
-    Servlet::ptr getDefault() const { return m_default;} 
-    void setDefault(Servlet::ptr v) { m_default = v;}
+    Servlet::ptr getDefault() const { return getTable().deflt;} 
+    void setDefault(Servlet::ptr v);
 
     Servlet::ptr getServlet(const std::string& uri);                            // 得到 精准匹配结果
     Servlet::ptr getGlobServlet(const std::string& uri);                        // 得到 模糊匹配结果
 
-    Servlet::ptr getMatchedServlet(const std::string& uri);
+    // req 不为空时把路由匹配捕获的参数写入 req
+    Servlet::ptr getMatchedServlet(const StringPiece& uri, HttpRequest::ptr req = nullptr);
+    Servlet::ptr getMatchedServlet(const std::string& uri, HttpRequest::ptr req = nullptr) {
+        return getMatchedServlet(StringPiece(uri), req);
+    }
 
 private:
-    RWMutexType m_mutex;
-    std::unordered_map<std::string, Servlet::ptr> m_data;       // uri -> servlet, 精准匹配
-    std::vector<std::pair<std::string, Servlet::ptr>> m_globs;  // uri -> servlet, 模糊匹配
-    Servlet::ptr m_default;                                     // 默认 servlet, 所有路径都未匹配到 servlet 使用
+    // 路由表快照, 发布后不再修改
+    struct Table {
+        typedef std::shared_ptr<const Table> ptr;
+        std::unordered_map<std::string, Servlet::ptr> data;       // uri -> servlet, 精准匹配
+        std::vector<std::pair<std::string, Servlet::ptr>> routes; // pattern -> servlet, 路由匹配 (据此重建 routeTree)
+        RouteTree::ptr routeTree;                                 // 与其他快照共享, 路由变化时整棵重建
+        std::vector<std::pair<std::string, Servlet::ptr>> globs;  // uri -> servlet, 模糊匹配
+        Servlet::ptr deflt;                                       // 默认 servlet, 所有路径都未匹配到 servlet 使用
+    };
+
+    /**
+     * 当前线程缓存的快照, 版本落后时刷新
+     * 引用在当前线程下次调用 getTable() 前有效, 使用期间不能让出协程
+     */
+    const Table& getTable() const;
+    // 持有 m_mutex 时调用: 复制当前快照
+    std::shared_ptr<Table> copyTable() const { return std::make_shared<Table>(*m_table);}
+    // 持有 m_mutex 时调用: 发布新快照
+    void setTable(std::shared_ptr<Table> v);
+private:
+    mutable MutexType m_mutex;          // 串行化修改, 以及线程刷新缓存时读 m_table
+    Table::ptr m_table;
+    std::atomic<uint64_t> m_version;    // 每次 setTable 加 1
+    uint64_t m_id;                      // 区分线程缓存中不同的 ServletDispatch
 };
 
 // 404 Not Found, by default
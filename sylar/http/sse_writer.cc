@@ -0,0 +1,65 @@
+#include "sse_writer.h"
+
+namespace sylar {
+namespace http {
+
+SSEWriter::ptr SSEWriter::Start(HttpResponse::ptr rsp, HttpSession::ptr session) {
+    rsp->setStatus(HttpStatus::OK);
+    rsp->setHeader("Content-Type", "text/event-stream");
+    rsp->setHeader("Cache-Control", "no-cache");
+    rsp->setHeader("X-Accel-Buffering", "no");     // 让 nginx 等反向代理不要缓冲
+    HttpResponseStream::ptr stream = session->beginResponse(rsp);
+    // 头部立即发出, 客户端在第一条事件之前就能确认连接已建立
+    if (!stream || stream->flush() < 0) {
+        return nullptr;
+    }
+    return std::make_shared<SSEWriter>(stream);
+}
+
+SSEWriter::SSEWriter(HttpResponseStream::ptr stream)
+    :m_stream(stream) {
+}
+
+int SSEWriter::send(const std::string& data, const std::string& event, const std::string& id) {
+    m_buf.clear();
+    if (!event.empty()) {
+        m_buf.append("event: ").append(event).append("\n");
+    }
+    if (!id.empty()) {
+        m_buf.append("id: ").append(id).append("\n");
+    }
+    size_t pos = 0;
+    while (true) {
+        size_t nl = data.find('\n', pos);
+        m_buf.append("data: ").append(data, pos, nl == std::string::npos ? std::string::npos : nl - pos);
+        m_buf.append("\n");
+        if (nl == std::string::npos) {
+            break;
+        }
+        pos = nl + 1;
+    }
+    m_buf.append("\n");
+    return commit();
+}
+
+int SSEWriter::comment(const std::string& text) {
+    m_buf.clear();
+    m_buf.append(": ").append(text).append("\n\n");
+    return commit();
+}
+
+int SSEWriter::retry(uint32_t ms) {
+    m_buf.clear();
+    m_buf.append("retry: ").append(std::to_string(ms)).append("\n\n");
+    return commit();
+}
+
+int SSEWriter::commit() {
+    if (m_stream->write(m_buf.c_str(), m_buf.size()) <= 0) {
+        return -1;
+    }
+    return m_stream->flush();
+}
+
+}
+}
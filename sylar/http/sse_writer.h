@@ -0,0 +1,47 @@
+#ifndef __SYLAR_HTTP_SSE_WRITER_H__
+#define __SYLAR_HTTP_SSE_WRITER_H__
+
+#include <memory>
+#include <string>
+#include "http.h"
+#include "http_session.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * Server-Sent Events (text/event-stream) 输出
+ * 基于 HttpSession::beginResponse 的 chunked 流式响应, 每条事件一个 chunk 并立即 flush
+ * 在 servlet 的 handle() 中使用, handle() 返回即结束事件流
+ */
+class SSEWriter {
+public:
+    typedef std::shared_ptr<SSEWriter> ptr;
+
+    // 设置 SSE 响应头并发出, 失败返回 nullptr
+    static SSEWriter::ptr Start(HttpResponse::ptr rsp, HttpSession::ptr session);
+
+    SSEWriter(HttpResponseStream::ptr stream);
+
+    /**
+     * 发送一条事件, data 中的每一行成为一个 "data:" 字段, event/id 为空时省略
+     * 返回 0 成功, -1 连接已断开
+     */
+    int send(const std::string& data, const std::string& event = "", const std::string& id = "");
+    // 注释行 (": text"), 用作心跳, 防止中间代理断开空闲连接
+    int comment(const std::string& text);
+    // 客户端断线后重连的等待时间
+    int retry(uint32_t ms);
+
+    HttpResponseStream::ptr getStream() const { return m_stream;}
+private:
+    int commit();
+private:
+    HttpResponseStream::ptr m_stream;
+    std::string m_buf;          // 正在拼的事件, 跨事件复用
+};
+
+}
+}
+
+#endif  // __SYLAR_HTTP_SSE_WRITER_H__
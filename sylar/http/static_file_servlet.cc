@@ -0,0 +1,460 @@
+#include "static_file_servlet.h"
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "sylar/log.h"
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static const uint32_t s_watch_mask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE
+        | IN_MOVE_SELF | IN_DELETE_SELF;
+
+static const char* GetContentType(const std::string& path) {
+    static const struct {
+        const char* ext;
+        const char* type;
+    } s_types[] = {
+        {".html", "text/html; charset=utf-8"},
+        {".htm", "text/html; charset=utf-8"},
+        {".css", "text/css; charset=utf-8"},
+        {".js", "application/javascript; charset=utf-8"},
+        {".json", "application/json"},
+        {".txt", "text/plain; charset=utf-8"},
+        {".xml", "text/xml"},
+        {".svg", "image/svg+xml"},
+        {".png", "image/png"},
+        {".jpg", "image/jpeg"},
+        {".jpeg", "image/jpeg"},
+        {".gif", "image/gif"},
+        {".ico", "image/x-icon"},
+        {".webp", "image/webp"},
+        {".wasm", "application/wasm"},
+        {".pdf", "application/pdf"},
+        {".mp4", "video/mp4"},
+        {".woff", "font/woff"},
+        {".woff2", "font/woff2"},
+    };
+    size_t dot = path.rfind('.');
+    if (dot != std::string::npos && path.find('/', dot) == std::string::npos) {
+        const char* ext = path.c_str() + dot;
+        for (auto& i : s_types) {
+            if (strcasecmp(i.ext, ext) == 0) {
+                return i.type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+static std::string HttpDate(time_t t) {
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char buf[64];
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return buf;
+}
+
+static time_t ParseHttpDate(const std::string& str) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (!strptime(str.c_str(), "%a, %d %b %Y %H:%M:%S", &tm)) {
+        return -1;
+    }
+    return timegm(&tm);
+}
+
+static int FromHex(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// %XX 解码, 格式错误返回 false
+static bool UrlDecode(const StringPiece& in, std::string& out) {
+    out.clear();
+    out.reserve(in.size());
+    for (int i = 0; i < in.size(); ++i) {
+        if (in[i] != '%') {
+            out.push_back(in[i]);
+            continue;
+        }
+        if (i + 2 >= in.size()) {
+            return false;
+        }
+        int h = FromHex(in[i + 1]);
+        int l = FromHex(in[i + 2]);
+        if (h < 0 || l < 0 || (h == 0 && l == 0)) {
+            return false;
+        }
+        out.push_back((char)(h << 4 | l));
+        i += 2;
+    }
+    return true;
+}
+
+// 路径中是否有 ".." 段
+static bool HasDotDot(const std::string& path) {
+    size_t pos = 0;
+    while ((pos = path.find("..", pos)) != std::string::npos) {
+        bool begin = pos == 0 || path[pos - 1] == '/';
+        bool end = pos + 2 == path.size() || path[pos + 2] == '/';
+        if (begin && end) {
+            return true;
+        }
+        pos += 2;
+    }
+    return false;
+}
+
+/**
+ * 合并空段和 "." 段, 以 '/' 开头, 原来以 '/' 或 "." 段结尾的保留结尾的 '/'
+ * 同一个文件只对应一个缓存 key, 避免 "//a" "/./a" 这类别名各占一项
+ */
+static std::string NormalizePath(const std::string& path) {
+    std::string rt;
+    bool dir = true;
+    size_t pos = 0;
+    while (pos <= path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        size_t len = end - pos;
+        if (len == 0 || (len == 1 && path[pos] == '.')) {
+            dir = true;
+        } else {
+            rt.push_back('/');
+            rt.append(path, pos, len);
+            dir = false;
+        }
+        pos = end + 1;
+    }
+    if (dir) {
+        rt.push_back('/');
+    }
+    return rt;
+}
+
+/**
+ * 解析单区间 Range: "bytes=a-b", "bytes=a-", "bytes=-n"
+ * 返回 1 有效区间, 0 忽略 (多区间或格式不认识, 返回整个文件), -1 不可满足
+ */
+static int ParseRange(const std::string& range, off_t size, off_t& begin, off_t& end) {
+    if (range.compare(0, 6, "bytes=") != 0 || range.find(',') != std::string::npos) {
+        return 0;
+    }
+    const char* p = range.c_str() + 6;
+    char* e = nullptr;
+    if (*p == '-') {            // 最后 n 个字节
+        long long n = strtoll(p + 1, &e, 10);
+        if (e == p + 1 || *e) {
+            return 0;
+        }
+        if (n <= 0 || size == 0) {
+            return -1;
+        }
+        begin = n >= size ? 0 : size - n;
+        end = size - 1;
+        return 1;
+    }
+    long long b = strtoll(p, &e, 10);
+    if (e == p || *e != '-' || b < 0) {
+        return 0;
+    }
+    p = e + 1;
+    long long last = size - 1;
+    if (*p) {
+        last = strtoll(p, &e, 10);
+        if (e == p || *e || last < b) {
+            return 0;
+        }
+    }
+    if (b >= size) {
+        return -1;
+    }
+    begin = b;
+    end = std::min(last, (long long)size - 1);
+    return 1;
+}
+
+StaticFileServlet::File::~File() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+StaticFileServlet::StaticFileServlet(const std::string& root, const std::string& prefix
+        , size_t max_open_files)
+    :Servlet("StaticFileServlet")
+    ,m_root(root)
+    ,m_prefix(prefix)
+    ,m_maxOpenFiles(max_open_files)
+    ,m_hits(0)
+    ,m_misses(0)
+    ,m_invalidations(0) {
+    while (m_root.size() > 1 && m_root.back() == '/') {
+        m_root.pop_back();
+    }
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) {
+        SYLAR_LOG_WARN(g_logger) << "StaticFileServlet inotify_init1 errno=" << errno
+            << " errstr=" << strerror(errno) << ", fd cache disabled";
+    }
+}
+
+StaticFileServlet::~StaticFileServlet() {
+    if (m_inotifyFd >= 0) {
+        ::close(m_inotifyFd);
+    }
+}
+
+StaticFileServlet::Stats StaticFileServlet::getStats() const {
+    Stats s;
+    s.hits = m_hits;
+    s.misses = m_misses;
+    s.invalidations = m_invalidations;
+    return s;
+}
+
+void StaticFileServlet::drainEvents() {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (true) {
+        ssize_t n = ::read(m_inotifyFd, buf, sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        for (char* p = buf; p < buf + n; ) {
+            const inotify_event* ev = (const inotify_event*)p;
+            p += sizeof(inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {     // 丢了事件, 不知道哪些失效, 全部清掉
+                m_invalidations += m_files.size();
+                evictAll();
+                continue;
+            }
+            auto it = m_watches.find(ev->wd);
+            if (it == m_watches.end()) {
+                continue;
+            }
+            ++m_invalidations;
+            // 同一 inode 可能以多个路径 (硬链接、符号链接) 缓存, 全部失效
+            std::set<std::string> paths;
+            paths.swap(it->second);
+            if (ev->mask & IN_IGNORED) {
+                // watch 已被内核移除 (文件系统卸载等), 不再调用 inotify_rm_watch
+                m_watches.erase(it);
+            } else {
+                inotify_rm_watch(m_inotifyFd, ev->wd);
+                m_watches.erase(it);
+            }
+            for (auto& i : paths) {
+                evict(i);
+            }
+        }
+    }
+}
+
+void StaticFileServlet::evict(const std::string& path) {
+    auto it = m_files.find(path);
+    if (it == m_files.end()) {
+        return;
+    }
+    File::ptr f = *it->second;
+    auto wit = m_watches.find(f->wd);
+    if (wit != m_watches.end() && wit->second.erase(path) && wit->second.empty()) {
+        inotify_rm_watch(m_inotifyFd, f->wd);
+        m_watches.erase(wit);
+    }
+    m_lru.erase(it->second);
+    m_files.erase(it);
+}
+
+void StaticFileServlet::evictAll() {
+    for (auto& i : m_watches) {
+        inotify_rm_watch(m_inotifyFd, i.first);
+    }
+    m_watches.clear();
+    m_files.clear();
+    m_lru.clear();
+}
+
+StaticFileServlet::File::ptr StaticFileServlet::getFile(const std::string& path) {
+    MutexType::Lock lock(m_mutex);
+    if (m_inotifyFd >= 0) {
+        drainEvents();
+        auto it = m_files.find(path);
+        if (it != m_files.end()) {
+            ++m_hits;
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            return *it->second;
+        }
+    }
+    ++m_misses;
+    lock.unlock();
+
+    File::ptr f = std::make_shared<File>();
+    f->path = path;
+    // 先加 watch 再 stat, 两者之间的修改也能收到事件
+    if (m_inotifyFd >= 0) {
+        f->wd = inotify_add_watch(m_inotifyFd, path.c_str(), s_watch_mask);
+    }
+    f->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (f->fd < 0 || fstat(f->fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        lock.lock();
+        if (f->wd >= 0 && !m_watches.count(f->wd)) {
+            inotify_rm_watch(m_inotifyFd, f->wd);
+        }
+        return nullptr;
+    }
+    f->size = st.st_size;
+    f->mtime = st.st_mtime;
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%lx-%lx\"", (unsigned long)st.st_mtime, (unsigned long)st.st_size);
+    f->etag = etag;
+    f->lastModified = HttpDate(st.st_mtime);
+    f->contentType = GetContentType(path);
+    if (f->wd < 0) {
+        return f;       // 无法监控的文件不缓存
+    }
+
+    lock.lock();
+    auto it = m_files.find(path);
+    if (it != m_files.end()) {   // 其他线程已经打开
+        if (f->wd != (*it->second)->wd && !m_watches.count(f->wd)) {
+            inotify_rm_watch(m_inotifyFd, f->wd);
+        }
+        return *it->second;
+    }
+    // 解锁期间其他线程可能淘汰了同一 inode 的另一个路径 (硬链接) 并移除了这个 wd,
+    // 持锁再加一次: 返回同一个 wd 说明 watch 一直有效; 否则中间可能漏了事件, 不缓存
+    int wd = inotify_add_watch(m_inotifyFd, path.c_str(), s_watch_mask);
+    if (wd != f->wd) {
+        if (wd >= 0 && !m_watches.count(wd)) {
+            inotify_rm_watch(m_inotifyFd, wd);
+        }
+        return f;
+    }
+    m_lru.push_front(f);
+    m_files[path] = m_lru.begin();
+    m_watches[f->wd].insert(path);
+    while (m_lru.size() > m_maxOpenFiles) {
+        evict(m_lru.back()->path);
+    }
+    return f;
+}
+
+// 没有 body 的错误/跳转响应: encodeHead 只在 body 非空时写 content-length,
+// 不写的话 keep-alive 的客户端会一直读到连接关闭
+static void SetEmptyResponse(HttpResponse::ptr rsp, HttpStatus status) {
+    rsp->setStatus(status);
+    rsp->setHeader("Content-Length", "0");
+}
+
+int32_t StaticFileServlet::handle(sylar::http::HttpRequest::ptr request
+        ,sylar::http::HttpResponse::ptr response
+        ,sylar::http::HttpSession::ptr session) {
+    HttpMethod method = request->getMethod();
+    if (method != HttpMethod::GET && method != HttpMethod::HEAD) {
+        SetEmptyResponse(response, HttpStatus::METHOD_NOT_ALLOWED);
+        response->setHeader("Allow", "GET, HEAD");
+        return 0;
+    }
+
+    StringPiece uri = request->getPathView();
+    std::string rel;
+    if (!uri.starts_with(m_prefix)
+            || !UrlDecode(StringPiece(uri.data() + m_prefix.size(), uri.size() - m_prefix.size()), rel)) {
+        SetEmptyResponse(response, HttpStatus::NOT_FOUND);
+        return 0;
+    }
+    if (HasDotDot(rel)) {
+        SetEmptyResponse(response, HttpStatus::FORBIDDEN);
+        return 0;
+    }
+    std::string path = m_root;
+    if (path.back() == '/') {
+        path.pop_back();
+    }
+    path.append(NormalizePath(rel));
+    if (path.back() == '/') {
+        path.append("index.html");
+    }
+
+    File::ptr f = getFile(path);
+    if (!f) {
+        struct stat st;
+        if (::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            SetEmptyResponse(response, HttpStatus::MOVED_PERMANENTLY);
+            response->setHeader("Location", uri.as_string() + "/");
+        } else {
+            SetEmptyResponse(response, HttpStatus::NOT_FOUND);
+        }
+        return 0;
+    }
+
+    response->setHeader("Content-Type", f->contentType);
+    response->setHeader("Last-Modified", f->lastModified);
+    response->setHeader("ETag", f->etag);
+    response->setHeader("Accept-Ranges", "bytes");
+
+    // 条件请求: If-None-Match 优先于 If-Modified-Since
+    std::string val;
+    if (request->hasHeader("If-None-Match", &val)) {
+        if (val == "*" || val.find(f->etag) != std::string::npos) {
+            response->setStatus(HttpStatus::NOT_MODIFIED);
+            return 0;
+        }
+    } else if (request->hasHeader("If-Modified-Since", &val)) {
+        time_t ims = ParseHttpDate(val);
+        if (ims >= 0 && f->mtime <= ims) {
+            response->setStatus(HttpStatus::NOT_MODIFIED);
+            return 0;
+        }
+    }
+
+    off_t begin = 0;
+    off_t end = f->size - 1;
+    if (request->hasHeader("Range", &val)) {
+        std::string if_range;
+        bool use_range = !request->hasHeader("If-Range", &if_range)
+                || if_range == f->etag || if_range == f->lastModified;
+        int rt = use_range ? ParseRange(val, f->size, begin, end) : 0;
+        if (rt < 0) {
+            SetEmptyResponse(response, HttpStatus::RANGE_NOT_SATISFIABLE);
+            response->setHeader("Content-Range", "bytes */" + std::to_string(f->size));
+            return 0;
+        }
+        if (rt > 0) {
+            response->setStatus(HttpStatus::PARTIAL_CONTENT);
+            response->setHeader("Content-Range", "bytes " + std::to_string(begin) + "-"
+                    + std::to_string(end) + "/" + std::to_string(f->size));
+        }
+    }
+    off_t length = end - begin + 1;
+
+    if (method == HttpMethod::HEAD) {
+        response->setHeader("Content-Length", std::to_string(length));
+        return 0;
+    }
+    HttpResponseStream::ptr stream = session->beginResponse(response, length);
+    if (!stream || (length > 0 && stream->sendFile(f->fd, begin, length) < 0)) {
+        return -1;
+    }
+    return 0;
+}
+
+}
+}
@@ -0,0 +1,84 @@
+#ifndef __SYLAR_HTTP_STATIC_FILE_SERVLET_H__
+#define __SYLAR_HTTP_STATIC_FILE_SERVLET_H__
+
+#include <list>
+#include <set>
+#include <unordered_map>
+#include <atomic>
+#include <sys/types.h>
+#include "servlet.h"
+#include "sylar/mutex.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * 静态文件 servlet, 把 uri 去掉 prefix 后映射到 root 目录下的文件
+ * 1. body 用 sendfile 发出, 不经过用户态
+ * 2. 缓存打开的 fd 和 stat 结果 (LRU, 最多 max_open_files 个), 文件被修改、删除、改名时
+ *    由 inotify 通知失效 (watch 被内核移除时同样失效, 事件队列溢出时清空缓存);
+ *    每次查找前非阻塞地读一次 inotify 事件
+ * 3. 支持 ETag / If-None-Match, Last-Modified / If-Modified-Since (304),
+ *    单区间 Range / If-Range (206, 416)
+ * 目录请求返回其中的 index.html; 含 ".." 的路径返回 403
+ */
+class StaticFileServlet : public Servlet {
+public:
+    typedef std::shared_ptr<StaticFileServlet> ptr;
+    typedef Mutex MutexType;
+
+    StaticFileServlet(const std::string& root, const std::string& prefix = "/"
+            , size_t max_open_files = 1024);
+    ~StaticFileServlet();
+
+    virtual int32_t handle(sylar::http::HttpRequest::ptr request
+                            ,sylar::http::HttpResponse::ptr response
+                            ,sylar::http::HttpSession::ptr session) override;
+
+    struct Stats {
+        uint64_t hits;          // fd 缓存命中
+        uint64_t misses;
+        uint64_t invalidations; // inotify 引起的失效
+    };
+    Stats getStats() const;
+private:
+    // 打开的文件, 从缓存中移除后由最后一个使用者关闭
+    struct File {
+        typedef std::shared_ptr<File> ptr;
+        int fd = -1;
+        int wd = -1;                // inotify watch
+        off_t size = 0;
+        time_t mtime = 0;
+        std::string path;
+        std::string etag;
+        std::string lastModified;
+        const char* contentType = nullptr;
+        ~File();
+    };
+
+    File::ptr getFile(const std::string& path);
+    // 持有 m_mutex 时调用
+    void drainEvents();
+    void evict(const std::string& path);
+    void evictAll();
+private:
+    std::string m_root;
+    std::string m_prefix;
+    size_t m_maxOpenFiles;
+    int m_inotifyFd;
+
+    MutexType m_mutex;
+    typedef std::list<File::ptr> FileList;  // 最近使用的在前
+    FileList m_lru;
+    std::unordered_map<std::string, FileList::iterator> m_files;
+    std::unordered_map<int, std::set<std::string>> m_watches;   // wd -> 以该 inode 缓存的 path
+
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<uint64_t> m_invalidations;
+};
+
+}
+}
+
+#endif  // __SYLAR_HTTP_STATIC_FILE_SERVLET_H__
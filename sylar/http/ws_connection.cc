@@ -4,6 +4,9 @@
 namespace sylar {
 namespace http {
 
+// 定义在 ws_session.cc
+extern sylar::ConfigVar<uint32_t>::ptr g_websocket_read_buffer_size;
+
 WSConnection::WSConnection(Socket::ptr sock, bool owner)
     :HttpConnection(sock, owner) {
 }
@@ -37,6 +40,10 @@ std::pair<HttpResult::ptr, WSConnection::ptr> WSConnection::Create(Uri::ptr uri
     }
     sock->setRecvTimeout(timeout_ms);
     WSConnection::ptr conn = std::make_shared<WSConnection>(sock);
+    // 握手前开启, 服务端紧跟在 101 响应后的帧不会丢
+    if (g_websocket_read_buffer_size->getValue()) {
+        conn->setBuffer(g_websocket_read_buffer_size->getValue());
+    }
 
     HttpRequest::ptr req = std::make_shared<HttpRequest>();
     req->setPath(uri->getPath());
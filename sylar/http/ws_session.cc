@@ -13,11 +13,19 @@ sylar::ConfigVar<uint32_t>::ptr g_websocket_message_max_size
     = sylar::Config::Lookup("websocket.message.max_size"
         , (uint32_t) 1024 * 1024 * 32, "websocket message max size");
 
+sylar::ConfigVar<uint32_t>::ptr g_websocket_read_buffer_size
+    = sylar::Config::Lookup("websocket.read_buffer_size"
+        , (uint32_t) 4096, "websocket read-ahead buffer size, 0 disable");
+
 WSSession::WSSession(Socket::ptr sock, bool owner)
     :HttpSession(sock, owner) {
 }
 
 HttpRequest::ptr WSSession::handleShake() {
+    // 帧头是 2 + 2/8 + 4 字节的小块读取, 经过预读缓冲
+    if (g_websocket_read_buffer_size->getValue()) {
+        setBuffer(g_websocket_read_buffer_size->getValue());
+    }
     HttpRequest::ptr req;
     do {
         req = recvRequest();
@@ -196,23 +204,24 @@ int32_t WSSendMessage(Stream* stream, WSFrameMessage::ptr msg, bool client, bool
             ws_head.payload = 127;
         }
         
+        // 帧头、扩展长度、掩码拼在一起, 与 payload 一次 writev 发出
+        char head[sizeof(ws_head) + sizeof(uint64_t) + 4];
+        size_t head_len = 0;
+
         // 数据帧头 (FIN, RSV1-3, opcode, mask)
-        if(stream->writeFixSize(&ws_head, sizeof(ws_head)) <= 0) {  
-            break;
-        }
+        memcpy(head, &ws_head, sizeof(ws_head));
+        head_len += sizeof(ws_head);
 
         // payload data length
         if(ws_head.payload == 126) {
             uint16_t len = size;
             len = sylar::byteswapOnLittleEndian(len);
-            if(stream->writeFixSize(&len, sizeof(len)) <= 0) {      
-                break;
-            }
+            memcpy(head + head_len, &len, sizeof(len));
+            head_len += sizeof(len);
         } else if(ws_head.payload == 127) {
             uint64_t len = sylar::byteswapOnLittleEndian(size);
-            if(stream->writeFixSize(&len, sizeof(len)) <= 0) {
-                break;
-            }
+            memcpy(head + head_len, &len, sizeof(len));
+            head_len += sizeof(len);
         }
 
         // Masking-key, 4 bytes
@@ -224,14 +233,17 @@ int32_t WSSendMessage(Stream* stream, WSFrameMessage::ptr msg, bool client, bool
             for(size_t i = 0; i < data.size(); ++i) {
                 data[i] ^= mask[i % 4];             // 使用 mask 对数据进行掩码处理
             }
-
-            if(stream->writeFixSize(mask, sizeof(mask)) <= 0) {
-                break;
-            }
+            memcpy(head + head_len, mask, sizeof(mask));
+            head_len += sizeof(mask);
         }
 
         // payload data (masked)
-        if(stream->writeFixSize(msg->getData().c_str(), size) <= 0) {
+        iovec iov[2];
+        iov[0].iov_base = head;
+        iov[0].iov_len = head_len;
+        iov[1].iov_base = (void*)msg->getData().c_str();
+        iov[1].iov_len = size;
+        if(stream->writeFixSizeV(iov, 2) <= 0 || stream->flush() < 0) {
             break;
         }
         return size + sizeof(ws_head);
@@ -246,6 +258,9 @@ int32_t WSPing(Stream* stream) {
     ws_head.fin = 1;
     ws_head.opcode = WSFrameHead::PING;
     int32_t v = stream->writeFixSize(&ws_head, sizeof(ws_head));
+    if(v > 0 && stream->flush() < 0) {
+        v = -1;
+    }
     if(v <= 0) {
         stream->close();
     }
@@ -258,6 +273,9 @@ int32_t WSPong(Stream* stream) {
     ws_head.fin = 1;
     ws_head.opcode = WSFrameHead::PONG;
     int32_t v = stream->writeFixSize(&ws_head, sizeof(ws_head));
+    if(v > 0 && stream->flush() < 0) {
+        v = -1;
+    }
     if(v <= 0) {
         stream->close();
     }
@@ -0,0 +1,423 @@
+#ifndef __SYLAR_SERIALIZE_H__
+#define __SYLAR_SERIALIZE_H__
+
+#include <byteswap.h>
+#include <string.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include "bytearray.h"
+#include "endian.h"
+
+/**
+ * 结构体序列化, 在结构体内用 SYLAR_SERIALIZE 列出需要序列化的字段 (最多 32 个)
+ *
+ *   struct LoginRequest {
+ *       uint32_t id;
+ *       std::string name;
+ *       std::vector<uint64_t> groups;
+ *       SYLAR_SERIALIZE(id, name, groups)
+ *   };
+ *   sylar::Serialize(ba, req);
+ *   sylar::Deserialize(ba, req);
+ *
+ * 编码与手写的调用序列相同:
+ *   算术类型/枚举  -> writeFint* (按 ByteArray 的字节序), bool 占 1 字节
+ *   std::string    -> writeStringVint
+ *   std::vector    -> writeUint64(元素个数) + 元素
+ *   嵌套的结构体   -> 按字段展开
+ * 连续的定长字段合并为一段: 写入时在栈上拼好后一次 write, 读取时一次 read 后逐个取出
+ */
+#define SYLAR_SERIALIZE(...) \
+    typedef void SylarSerializable; \
+    template<class SylarVisitor> \
+    void sylarVisit(SylarVisitor& sylar_visitor) { \
+        SYLAR_SERIALIZE_EACH(SYLAR_SERIALIZE_VISIT, __VA_ARGS__) \
+    } \
+    template<class SylarVisitor> \
+    void sylarVisit(SylarVisitor& sylar_visitor) const { \
+        SYLAR_SERIALIZE_EACH(SYLAR_SERIALIZE_VISIT, __VA_ARGS__) \
+    }
+
+#define SYLAR_SERIALIZE_VISIT(field) sylar_visitor(field);
+#define SYLAR_SERIALIZE_EACH(m, ...) \
+    SYLAR_SERIALIZE_CAT(SYLAR_SERIALIZE_EACH_, SYLAR_SERIALIZE_NARG(__VA_ARGS__))(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_CAT(a, b) SYLAR_SERIALIZE_CAT_(a, b)
+#define SYLAR_SERIALIZE_CAT_(a, b) a ## b
+#define SYLAR_SERIALIZE_NARG(...) \
+    SYLAR_SERIALIZE_NARG_(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define SYLAR_SERIALIZE_NARG_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ...) N
+#define SYLAR_SERIALIZE_EACH_1(m, x) m(x)
+#define SYLAR_SERIALIZE_EACH_2(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_1(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_3(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_2(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_4(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_3(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_5(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_4(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_6(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_5(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_7(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_6(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_8(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_7(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_9(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_8(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_10(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_9(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_11(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_10(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_12(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_11(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_13(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_12(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_14(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_13(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_15(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_14(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_16(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_15(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_17(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_16(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_18(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_17(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_19(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_18(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_20(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_19(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_21(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_20(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_22(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_21(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_23(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_22(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_24(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_23(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_25(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_24(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_26(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_25(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_27(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_26(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_28(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_27(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_29(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_28(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_30(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_29(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_31(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_30(m, __VA_ARGS__)
+#define SYLAR_SERIALIZE_EACH_32(m, x, ...) m(x) SYLAR_SERIALIZE_EACH_31(m, __VA_ARGS__)
+
+namespace sylar {
+namespace serialize {
+
+static const size_t STAGING_SIZE = 256;     // 定长段的最大长度
+
+// 定长字段
+template<class T>
+struct IsFixed : std::integral_constant<bool
+        , std::is_arithmetic<T>::value || std::is_enum<T>::value> {};
+
+// 用 SYLAR_SERIALIZE 声明过的结构体
+template<class T, class = void>
+struct IsStruct : std::false_type {};
+
+template<class T>
+struct IsStruct<T, typename T::SylarSerializable> : std::true_type {};
+
+inline void SwapBytes(char* p, size_t size) {
+    if (size == 2) {
+        uint16_t v;
+        memcpy(&v, p, sizeof(v));
+        v = bswap_16(v);
+        memcpy(p, &v, sizeof(v));
+    } else if (size == 4) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        v = bswap_32(v);
+        memcpy(p, &v, sizeof(v));
+    } else if (size == 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        v = bswap_64(v);
+        memcpy(p, &v, sizeof(v));
+    }
+}
+
+inline bool NeedSwap(const ByteArray& ba) {
+    return (ba.isLittleEndian() ? SYLAR_LITTLE_ENDIAN : SYLAR_BIG_ENDIAN) != SYLAR_BYTE_ORDER;
+}
+
+inline size_t VarintSize(uint64_t v) {
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        ++n;
+    }
+    return n;
+}
+
+// 计算序列化后的长度，用于一次性预留空间
+class SizeCounter {
+public:
+    SizeCounter() :m_size(0) {}
+
+    template<class T>
+    typename std::enable_if<IsFixed<T>::value>::type operator()(const T& v) {
+        m_size += sizeof(T);
+    }
+
+    void operator()(const std::string& v) {
+        m_size += VarintSize(v.size()) + v.size();
+    }
+
+    template<class T>
+    void operator()(const std::vector<T>& v) {
+        static_assert(!std::is_same<T, bool>::value, "std::vector<bool> is not supported");
+        m_size += VarintSize(v.size());
+        if (IsFixed<T>::value) {
+            m_size += v.size() * sizeof(T);
+        } else {
+            for (auto& i : v) {
+                (*this)(i);
+            }
+        }
+    }
+
+    template<class T>
+    typename std::enable_if<IsStruct<T>::value>::type operator()(const T& v) {
+        v.sylarVisit(*this);
+    }
+
+    size_t getSize() const { return m_size;}
+private:
+    size_t m_size;
+};
+
+class Writer {
+public:
+    Writer(ByteArray& ba)
+        :m_ba(ba)
+        ,m_swap(NeedSwap(ba))
+        ,m_len(0) {
+    }
+
+    template<class T>
+    typename std::enable_if<IsFixed<T>::value>::type operator()(const T& v) {
+        if (m_len + sizeof(T) > STAGING_SIZE) {
+            flush();
+        }
+        memcpy(m_buf + m_len, &v, sizeof(T));
+        if (m_swap) {
+            SwapBytes(m_buf + m_len, sizeof(T));
+        }
+        m_len += sizeof(T);
+    }
+
+    void operator()(const std::string& v) {
+        flush();
+        m_ba.writeStringVint(v);
+    }
+
+    template<class T>
+    void operator()(const std::vector<T>& v) {
+        static_assert(!std::is_same<T, bool>::value, "std::vector<bool> is not supported");
+        flush();
+        m_ba.writeUint64(v.size());
+        writeElements(v, IsFixed<T>());
+    }
+
+    template<class T>
+    typename std::enable_if<IsStruct<T>::value>::type operator()(const T& v) {
+        v.sylarVisit(*this);
+    }
+
+    void flush() {
+        if (m_len) {
+            m_ba.write(m_buf, m_len);
+            m_len = 0;
+        }
+    }
+private:
+    template<class T>
+    void writeElements(const std::vector<T>& v, std::true_type) {
+        if (!m_swap) {
+            m_ba.write(v.data(), v.size() * sizeof(T));     // 字节序相同时整块拷贝
+            return;
+        }
+        for (auto& i : v) {
+            (*this)(i);
+        }
+        flush();
+    }
+
+    template<class T>
+    void writeElements(const std::vector<T>& v, std::false_type) {
+        for (auto& i : v) {
+            (*this)(i);
+        }
+        flush();
+    }
+private:
+    ByteArray& m_ba;
+    bool m_swap;
+    size_t m_len;
+    char m_buf[STAGING_SIZE];
+};
+
+// 结构体展开后，各个定长段的长度, 每个类型只计算一次
+typedef std::vector<size_t> Plan;
+
+class PlanBuilder {
+public:
+    PlanBuilder() :m_cur(0) {}
+
+    template<class T>
+    typename std::enable_if<IsFixed<T>::value>::type operator()(const T& v) {
+        if (m_cur + sizeof(T) > STAGING_SIZE) {
+            finish();
+        }
+        m_cur += sizeof(T);
+    }
+
+    void operator()(const std::string& v) {
+        finish();
+    }
+
+    template<class T>
+    void operator()(const std::vector<T>& v) {
+        finish();
+    }
+
+    template<class T>
+    typename std::enable_if<IsStruct<T>::value>::type operator()(const T& v) {
+        v.sylarVisit(*this);
+    }
+
+    void finish() {
+        if (m_cur) {
+            m_plan.push_back(m_cur);
+            m_cur = 0;
+        }
+    }
+
+    Plan& getPlan() { return m_plan;}
+private:
+    Plan m_plan;
+    size_t m_cur;
+};
+
+template<class T>
+const Plan& GetPlan(const T& v) {
+    static const Plan s_plan = [&v]() {
+        PlanBuilder builder;
+        v.sylarVisit(builder);
+        builder.finish();
+        return builder.getPlan();
+    }();
+    return s_plan;
+}
+
+class Reader {
+public:
+    Reader(ByteArray& ba, const Plan& plan)
+        :m_ba(ba)
+        ,m_plan(plan)
+        ,m_swap(NeedSwap(ba))
+        ,m_run(0)
+        ,m_pos(0)
+        ,m_len(0) {
+    }
+
+    template<class T>
+    typename std::enable_if<IsFixed<T>::value>::type operator()(T& v) {
+        if (m_pos == m_len) {
+            // 新的一段定长字段, 一次读完
+            m_len = m_plan[m_run++];
+            m_ba.read(m_buf, m_len);
+            m_pos = 0;
+        }
+        if (m_swap) {
+            SwapBytes(m_buf + m_pos, sizeof(T));
+        }
+        memcpy(&v, m_buf + m_pos, sizeof(T));
+        m_pos += sizeof(T);
+    }
+
+    void operator()(bool& v) {
+        uint8_t b = 0;
+        (*this)(b);
+        v = b != 0;
+    }
+
+    void operator()(std::string& v) {
+        v = m_ba.readStringVint();
+    }
+
+    template<class T>
+    void operator()(std::vector<T>& v) {
+        static_assert(!std::is_same<T, bool>::value, "std::vector<bool> is not supported");
+        uint64_t n = m_ba.readUint64();
+        // 每个元素至少 1 字节，先检查长度，防止恶意的个数导致超大分配
+        uint64_t min_size = IsFixed<T>::value ? sizeof(T) : 1;
+        if (n > m_ba.getReadSize() / min_size) {
+            throw std::out_of_range("not enough length");
+        }
+        v.resize(n);
+        readElements(v, IsFixed<T>());
+    }
+
+    template<class T>
+    typename std::enable_if<IsStruct<T>::value>::type operator()(T& v) {
+        v.sylarVisit(*this);
+    }
+private:
+    template<class T>
+    void readElements(std::vector<T>& v, std::true_type) {
+        if (v.empty()) {
+            return;
+        }
+        m_ba.read(&v[0], v.size() * sizeof(T));
+        if (m_swap && sizeof(T) > 1) {
+            for (auto& i : v) {
+                SwapBytes((char*)&i, sizeof(T));
+            }
+        }
+    }
+
+    template<class T>
+    void readElements(std::vector<T>& v, std::false_type) {
+        readStructs(v, IsStruct<T>());
+    }
+
+    // 结构体元素有自己的定长段划分
+    template<class T>
+    void readStructs(std::vector<T>& v, std::true_type) {
+        const Plan& plan = GetPlan(T());
+        for (auto& i : v) {
+            Reader reader(m_ba, plan);
+            i.sylarVisit(reader);
+        }
+    }
+
+    template<class T>
+    void readStructs(std::vector<T>& v, std::false_type) {
+        for (auto& i : v) {
+            (*this)(i);
+        }
+    }
+private:
+    ByteArray& m_ba;
+    const Plan& m_plan;
+    bool m_swap;
+    size_t m_run;
+    size_t m_pos;
+    size_t m_len;
+    char m_buf[STAGING_SIZE];
+};
+
+}
+
+// 序列化后的长度
+template<class T>
+size_t SerializedSize(const T& v) {
+    static_assert(serialize::IsStruct<T>::value, "use SYLAR_SERIALIZE to declare fields");
+    serialize::SizeCounter counter;
+    v.sylarVisit(counter);
+    return counter.getSize();
+}
+
+// 从 ba 的当前位置写入 v
+template<class T>
+void Serialize(ByteArray::ptr ba, const T& v) {
+    static_assert(serialize::IsStruct<T>::value, "use SYLAR_SERIALIZE to declare fields");
+    ba->reserve(SerializedSize(v));
+    serialize::Writer writer(*ba);
+    v.sylarVisit(writer);
+    writer.flush();
+}
+
+// 从 ba 的当前位置读出 v, 数据不足时抛出 std::out_of_range
+template<class T>
+void Deserialize(ByteArray::ptr ba, T& v) {
+    static_assert(serialize::IsStruct<T>::value, "use SYLAR_SERIALIZE to declare fields");
+    serialize::Reader reader(*ba, serialize::GetPlan(v));
+    v.sylarVisit(reader);
+}
+
+}
+
+#endif  // __SYLAR_SERIALIZE_H__
@@ -1,17 +1,36 @@
 #include <limits.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/udp.h>
+#include <sys/sendfile.h>
 #include "socket.h"
 #include "iomanager.h"
+#include "config.h"
 #include "fd_manager.h"
 #include "hook.h"
 #include "log.h"
 #include "macro.h"
+#include "ssl_context.h"
 
 namespace sylar {
 
 static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
+static sylar::ConfigVar<bool>::ptr g_ssl_ktls =
+    sylar::Config::Lookup("ssl.ktls", false, "enable kernel tls offload after handshake");
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+// 每个报文的控制信息: 发送时的 UDP_SEGMENT (uint16_t) 或接收时的 UDP_GRO (int)
+static const size_t CONTROL_SIZE = CMSG_SPACE(sizeof(int));
+static const size_t CONTROL_WORDS = (CONTROL_SIZE + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
 // 根据传入的地址类型创建 TCP 
 Socket::ptr Socket::CreateTCP(Address::ptr address) {
     Socket::ptr sock(new Socket(address->getFamily(), TCP, 0));
@@ -58,7 +77,8 @@ Socket::Socket(int family, int type, int protocol)
     ,m_family(family)
     ,m_type(type)
     ,m_protocol(protocol)
-    ,m_connected(false) {
+    ,m_connected(false)
+    ,m_fastOpenConnect(false) {
 }
 
 Socket::~Socket() {
@@ -86,7 +106,7 @@ void Socket::shutdownRead() {
 }
 
 int64_t Socket::getSendTimeout() {
-    FdCtx::ptr ctx = FdMgr::GetInstance()->get(m_sock);
+    FdCtx* ctx = FdMgr::GetInstance()->get(m_sock);
     if (ctx) {
         return ctx->getTimeout(SO_SNDTIMEO);
     }
@@ -99,7 +119,7 @@ void Socket::setSendTimeout(int64_t v) {
 }   
 
 int64_t Socket::getRecvTimeout() { 
-    FdCtx::ptr ctx = FdMgr::GetInstance()->get(m_sock);
+    FdCtx* ctx = FdMgr::GetInstance()->get(m_sock);
     if (ctx) {
         return ctx->getTimeout(SO_RCVTIMEO);
     }
@@ -149,7 +169,7 @@ Socket::ptr Socket::accept() {
 
 // 对句柄进行初始化：状态、地址等
 bool Socket::init(int connfd) {
-    FdCtx::ptr ctx = FdMgr::GetInstance()->get(connfd);
+    FdCtx* ctx = FdMgr::GetInstance()->get(connfd);
     if (ctx && ctx->isSocket() && !ctx->isClose()) {
         m_sock = connfd;
         m_connected = true;
@@ -210,6 +230,13 @@ bool Socket::connect(const Address::ptr addr, uint64_t timeout_ms) {
         return false;
     }
 
+    if (m_fastOpenConnect && m_type == TCP) {
+        int val = 1;
+        if (!setOption(IPPROTO_TCP, TCP_FASTOPEN_CONNECT, val)) {
+            m_fastOpenConnect = false;  // 内核不支持, 走普通握手
+        }
+    }
+
     if (timeout_ms == (uint64_t)-1) {
         if (::connect(m_sock, addr->getAddr(), addr->getAddrLen())) {
             SYLAR_LOG_ERROR(g_logger) << "sock=" << m_sock << " connect(" << addr->toString()
@@ -226,11 +253,31 @@ bool Socket::connect(const Address::ptr addr, uint64_t timeout_ms) {
         }
     }
     m_connected = true;
+    if (m_fastOpenConnect) {
+        // 握手可能推迟到第一次 send, 此时 getpeername 失败
+        m_remoteAddress = Address::Create(addr->getAddr(), addr->getAddrLen());
+    }
     getRemoteAddress();
     getLocalAddress();
     return true;
 }
 
+int Socket::connectWithData(const Address::ptr addr, const void* data, size_t length, uint64_t timeout_ms) {
+    m_fastOpenConnect = true;
+    if (!connect(addr, timeout_ms)) {
+        return -1;
+    }
+    return send(data, length);
+}
+
+bool Socket::setFastOpen(int qlen) {
+    return setOption(IPPROTO_TCP, TCP_FASTOPEN, qlen);
+}
+
+bool Socket::setDeferAccept(int seconds) {
+    return setOption(IPPROTO_TCP, TCP_DEFER_ACCEPT, seconds);
+}
+
 bool Socket::listen(int backlog) {
     if (!isValid()) {
         SYLAR_LOG_ERROR(g_logger) << "listen error sock=-1";
@@ -295,6 +342,13 @@ int Socket::sendTo(const iovec* buffers, size_t length, const Address::ptr to, i
     return -1;
 }
 
+ssize_t Socket::sendFile(int fd, off_t offset, size_t count) {
+    if (isConnected()) {
+        return ::sendfile(m_sock, fd, &offset, count);
+    }
+    return -1;
+}
+
 int Socket::recv(void* buffer, size_t length, int flags) {
     if (isConnected()) {
         return ::recv(m_sock, buffer, length, flags);
@@ -334,6 +388,44 @@ int Socket::recvFrom(iovec* buffers, size_t length, Address::ptr from, int flags
     return -1;
 }   
 
+int Socket::recvBatch(DatagramBatch::ptr batch, int flags) {
+    if (!isValid()) {
+        return -1;
+    }
+    batch->prepareRecv();
+    int rt = ::recvmmsg(m_sock, &batch->m_msgs[0], batch->capacity(), flags | MSG_WAITFORONE, nullptr);
+    if (rt > 0) {
+        batch->finishRecv(rt);
+    }
+    return rt;
+}
+
+int Socket::sendBatch(DatagramBatch::ptr batch, int flags) {
+    if (!isValid()) {
+        return -1;
+    }
+    size_t sent = 0;
+    while (sent < batch->size()) {
+        // 发送缓冲满时只发出一部分, 继续发剩下的
+        int rt = ::sendmmsg(m_sock, &batch->m_msgs[sent], batch->size() - sent, flags);
+        if (rt <= 0) {
+            return sent ? (int)sent : -1;
+        }
+        sent += rt;
+    }
+    return sent;
+}
+
+bool Socket::setUdpSegment(uint16_t size) {
+    int v = size;
+    return setOption(SOL_UDP, UDP_SEGMENT, v);
+}
+
+bool Socket::setUdpGro(bool v) {
+    int val = v ? 1 : 0;
+    return setOption(SOL_UDP, UDP_GRO, val);
+}
+
 Address::ptr Socket::getRemoteAddress() {
     if (m_remoteAddress) {  // 已经被初始化
         return m_remoteAddress;
@@ -468,6 +560,97 @@ void Socket::newSock() {
 
 }
 
+DatagramBatch::DatagramBatch(size_t capacity, size_t slot_size)
+    :m_slotSize(slot_size)
+    ,m_count(0)
+    ,m_arena(capacity * slot_size)
+    ,m_msgs(capacity)
+    ,m_iovs(capacity)
+    ,m_addrs(capacity)
+    ,m_control(capacity * CONTROL_WORDS)
+    ,m_segments(capacity) {
+    for (size_t i = 0; i < capacity; ++i) {
+        m_iovs[i].iov_base = data(i);
+        m_iovs[i].iov_len = m_slotSize;
+        m_msgs[i].msg_hdr.msg_iov = &m_iovs[i];
+        m_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+bool DatagramBatch::add(const void* buffer, size_t length, Address::ptr to, uint16_t segment_size) {
+    if (m_count >= capacity() || length > m_slotSize) {
+        return false;
+    }
+    size_t idx = m_count++;
+    memcpy(data(idx), buffer, length);
+    m_iovs[idx].iov_len = length;
+
+    msghdr& hdr = m_msgs[idx].msg_hdr;
+    if (to) {
+        memcpy(&m_addrs[idx], to->getAddr(), to->getAddrLen());
+        hdr.msg_name = &m_addrs[idx];
+        hdr.msg_namelen = to->getAddrLen();
+    } else {
+        hdr.msg_name = nullptr;
+        hdr.msg_namelen = 0;
+    }
+    setControl(idx, segment_size);
+    return true;
+}
+
+void DatagramBatch::setControl(size_t idx, uint16_t segment_size) {
+    msghdr& hdr = m_msgs[idx].msg_hdr;
+    hdr.msg_flags = 0;
+    if (!segment_size) {
+        hdr.msg_control = nullptr;
+        hdr.msg_controllen = 0;
+        return;
+    }
+    hdr.msg_control = &m_control[idx * CONTROL_WORDS];
+    hdr.msg_controllen = CMSG_SPACE(sizeof(segment_size));
+    cmsghdr* cm = CMSG_FIRSTHDR(&hdr);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(segment_size));
+    memcpy(CMSG_DATA(cm), &segment_size, sizeof(segment_size));
+}
+
+Address::ptr DatagramBatch::getAddress(size_t idx) const {
+    if (getAddrLen(idx) == 0) {
+        return nullptr;
+    }
+    return Address::Create(getAddr(idx), getAddrLen(idx));
+}
+
+void DatagramBatch::prepareRecv() {
+    m_count = 0;
+    for (size_t i = 0; i < m_msgs.size(); ++i) {
+        msghdr& hdr = m_msgs[i].msg_hdr;
+        m_iovs[i].iov_len = m_slotSize;
+        hdr.msg_name = &m_addrs[i];
+        hdr.msg_namelen = sizeof(sockaddr_storage);
+        hdr.msg_control = &m_control[i * CONTROL_WORDS];
+        hdr.msg_controllen = CONTROL_SIZE;
+        hdr.msg_flags = 0;
+    }
+}
+
+void DatagramBatch::finishRecv(size_t count) {
+    m_count = count;
+    for (size_t i = 0; i < count; ++i) {
+        msghdr& hdr = m_msgs[i].msg_hdr;
+        m_iovs[i].iov_len = m_msgs[i].msg_len;
+        m_segments[i] = 0;
+        for (cmsghdr* cm = CMSG_FIRSTHDR(&hdr); cm; cm = CMSG_NXTHDR(&hdr, cm)) {
+            if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                int v = 0;
+                memcpy(&v, CMSG_DATA(cm), sizeof(v));
+                m_segments[i] = v;
+            }
+        }
+    }
+}
+
 namespace {
 
 struct _SSLInit {
@@ -482,8 +665,93 @@ static _SSLInit s_init;
 
 }
 
+namespace {
+
+// 直接调用未 hook 的 send/recv: 数据未就绪时返回 EAGAIN, 由 SSLSocket 等待事件后重试
+int SockBioWrite(BIO* bio, const char* data, int len) {
+    BIO_clear_retry_flags(bio);
+    int rt = send_f((int)(intptr_t)BIO_get_data(bio), data, len, MSG_NOSIGNAL);
+    if (rt < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        BIO_set_retry_write(bio);
+    }
+    return rt;
+}
+
+int SockBioRead(BIO* bio, char* data, int len) {
+    BIO_clear_retry_flags(bio);
+    int rt = recv_f((int)(intptr_t)BIO_get_data(bio), data, len, 0);
+    if (rt < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        BIO_set_retry_read(bio);
+    }
+    return rt;
+}
+
+int SockBioPuts(BIO* bio, const char* str) {
+    return SockBioWrite(bio, str, strlen(str));
+}
+
+long SockBioCtrl(BIO* bio, int cmd, long num, void* ptr) {
+    return cmd == BIO_CTRL_FLUSH ? 1 : 0;
+}
+
+int SockBioCreate(BIO* bio) {
+    BIO_set_init(bio, 1);
+    return 1;
+}
+
+// fd 归 Socket 管理, BIO 释放时不关闭
+int SockBioDestroy(BIO* bio) {
+    return 1;
+}
+
+/**
+ * kTLS 需要 OpenSSL 自带的 socket BIO (SSL_set_fd), 它调用的 read/write/recvmsg 会走 hook:
+ * 数据未就绪时在 hook 里挂起协程, 不返回 WANT_READ/WANT_WRITE, 绕过 waitRetry 和它的超时
+ * 调用 SSL_* 期间关闭当前线程的 hook, 让 EAGAIN 交给 waitRetry 处理
+ */
+class SSLHookGuard {
+public:
+    SSLHookGuard(bool socket_bio)
+        :m_active(socket_bio && is_hook_enable()) {
+        if (m_active) {
+            set_hook_enable(false);
+        }
+    }
+    ~SSLHookGuard() {
+        if (m_active) {
+            set_hook_enable(true);
+        }
+    }
+private:
+    bool m_active;
+};
+
+BIO_METHOD* GetSockBioMethod() {
+    static BIO_METHOD* s_method = []() {
+        BIO_METHOD* m = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "sylar_socket");
+        BIO_meth_set_write(m, SockBioWrite);
+        BIO_meth_set_read(m, SockBioRead);
+        BIO_meth_set_puts(m, SockBioPuts);
+        BIO_meth_set_ctrl(m, SockBioCtrl);
+        BIO_meth_set_create(m, SockBioCreate);
+        BIO_meth_set_destroy(m, SockBioDestroy);
+        return m;
+    }();
+    return s_method;
+}
+
+struct ssl_wait_info {
+    int cancelled = 0;
+};
+
+}
+
 SSLSocket::SSLSocket(int family, int type, int protocol)
-    :Socket(family, type, protocol) {
+    :Socket(family, type, protocol)
+    ,m_handshaked(false)
+    ,m_ktls(g_ssl_ktls->getValue())
+    ,m_ktlsSend(false)
+    ,m_socketBio(false) {
 }
 
 Socket::ptr SSLSocket::accept() {
@@ -495,6 +763,7 @@ Socket::ptr SSLSocket::accept() {
         return nullptr;
     }
     sock->m_ctx = m_ctx;
+    sock->m_ktls = m_ktls;
     if(sock->init(newsock)) {
         return sock;
     }
@@ -508,10 +777,24 @@ bool SSLSocket::bind(const Address::ptr addr) {
 bool SSLSocket::connect(const Address::ptr addr, uint64_t timeout_ms) {
     bool v = Socket::connect(addr, timeout_ms);
     if(v) {
-        m_ctx.reset(SSL_CTX_new(SSLv23_client_method()), SSL_CTX_free);
-        m_ssl.reset(SSL_new(m_ctx.get()),  SSL_free);
-        SSL_set_fd(m_ssl.get(), m_sock);
-        v = (SSL_connect(m_ssl.get()) == 1);
+        m_ctx = SSLContextMgr::GetInstance()->getClientContext();
+        newSSL();
+        SSL_set_connect_state(m_ssl.get());
+
+        // 会话按 host:port 缓存, 没有设置主机名时用 ip:port
+        std::string key;
+        if(!m_hostName.empty()) {
+            SSL_set_tlsext_host_name(m_ssl.get(), m_hostName.c_str());
+            IPAddress::ptr iaddr = std::dynamic_pointer_cast<IPAddress>(addr);
+            key = m_hostName + ":" + std::to_string(iaddr ? iaddr->getPort() : 0);
+        } else {
+            key = addr->toString();
+        }
+        SSLContextMgr::GetInstance()->prepareClient(m_ssl.get(), key);
+        v = handshake(timeout_ms);
+        if(!v) {
+            SSLContextMgr::GetInstance()->removeClientSession(key);
+        }
     }
     return v;
 }
@@ -521,25 +804,192 @@ bool SSLSocket::listen(int backlog) {
 }
 
 bool SSLSocket::close() {
+    if(m_ssl && m_handshaked && m_connected) {
+        // 发出 close_notify, 不等待对端回应; 正常关闭的会话才能复用
+        SSLHookGuard guard(m_socketBio);
+        SSL_shutdown(m_ssl.get());
+    }
     return Socket::close();
 }
 
+void SSLSocket::newSSL() {
+    m_ssl.reset(SSL_new(m_ctx.get()),  SSL_free);
+    m_handshaked = false;
+    m_ktlsSend = false;
+    m_socketBio = false;
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    if(m_ktls) {
+        SSL_set_options(m_ssl.get(), SSL_OP_ENABLE_KTLS);
+        SSL_set_fd(m_ssl.get(), m_sock);
+        m_socketBio = true;
+        return;
+    }
+#endif
+    BIO* bio = BIO_new(GetSockBioMethod());
+    BIO_set_data(bio, (void*)(intptr_t)m_sock);
+    SSL_set_bio(m_ssl.get(), bio, bio);
+}
+
+bool SSLSocket::isKtlsRecv() const {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    return m_ssl && m_handshaked && BIO_get_ktls_recv(SSL_get_rbio(m_ssl.get()));
+#else
+    return false;
+#endif
+}
+
+bool SSLSocket::waitEvent(int event, uint64_t timeout_ms) {
+    IOManager* iom = IOManager::GetThis();
+    if(!iom) {
+        pollfd pfd;
+        pfd.fd = m_sock;
+        pfd.events = event == IOManager::READ ? POLLIN : POLLOUT;
+        pfd.revents = 0;
+        int rt = ::poll(&pfd, 1, timeout_ms == (uint64_t)-1 ? -1 : (int)timeout_ms);
+        if(rt == 0) {
+            errno = ETIMEDOUT;
+        }
+        return rt > 0;
+    }
+
+    std::shared_ptr<ssl_wait_info> winfo(new ssl_wait_info);
+    std::weak_ptr<ssl_wait_info> wweak(winfo);
+    Timer::ptr timer;
+    int fd = m_sock;
+    if(timeout_ms != (uint64_t)-1) {
+        timer = iom->addConditionTimer(timeout_ms, [wweak, fd, iom, event]() {
+            auto t = wweak.lock();
+            if(!t || t->cancelled) {
+                return;
+            }
+            t->cancelled = ETIMEDOUT;
+            iom->cancelEvent(fd, (IOManager::Event)event);  // 超时强制唤醒
+        }, wweak);
+    }
+    if(iom->addEvent(fd, (IOManager::Event)event)) {
+        if(timer) {
+            timer->cancel();
+        }
+        SYLAR_LOG_ERROR(g_logger) << "SSLSocket addEvent(" << fd << ", " << event << ") error";
+        return false;
+    }
+    Fiber::YieldToHold();
+    if(timer) {
+        timer->cancel();
+    }
+    if(winfo->cancelled) {
+        errno = winfo->cancelled;
+        return false;
+    }
+    return true;
+}
+
+int SSLSocket::waitRetry(int rt, uint64_t timeout_ms) {
+    int err = SSL_get_error(m_ssl.get(), rt);
+    switch(err) {
+        case SSL_ERROR_WANT_READ:
+            return waitEvent(IOManager::READ, timeout_ms != (uint64_t)-1
+                    ? timeout_ms : getRecvTimeout()) ? 1 : -1;
+        case SSL_ERROR_WANT_WRITE:
+            return waitEvent(IOManager::WRITE, timeout_ms != (uint64_t)-1
+                    ? timeout_ms : getSendTimeout()) ? 1 : -1;
+        case SSL_ERROR_ZERO_RETURN:
+            return 0;
+        case SSL_ERROR_SYSCALL:
+            return rt == 0 ? 0 : -1;    // 没有 close_notify 的 EOF
+        default:
+            return -1;
+    }
+}
+
+bool SSLSocket::handshake(uint64_t timeout_ms) {
+    if(m_handshaked) {
+        return true;
+    }
+    if(!m_ssl) {
+        return false;
+    }
+    // 整个握手共用一个截止时间, 每次等待只用剩余的时间
+    uint64_t deadline = timeout_ms != (uint64_t)-1 ? sylar::GetCurretMS() + timeout_ms : 0;
+    while(true) {
+        ERR_clear_error();
+        int rt;
+        {
+            SSLHookGuard guard(m_socketBio);
+            rt = SSL_do_handshake(m_ssl.get());
+        }
+        if(rt == 1) {
+            break;
+        }
+        uint64_t left = (uint64_t)-1;
+        if(deadline) {
+            uint64_t now = sylar::GetCurretMS();
+            left = now < deadline ? deadline - now : 0;
+        }
+        if(left == 0) {
+            errno = ETIMEDOUT;
+        }
+        if(left == 0 || waitRetry(rt, left) <= 0) {
+            SYLAR_LOG_DEBUG(g_logger) << "SSL handshake fail " << *this
+                << " errno=" << errno << " errstr=" << strerror(errno);
+            SSLContextMgr::GetInstance()->onHandshake(m_ssl.get(), SSL_is_server(m_ssl.get()), false);
+            return false;
+        }
+    }
+    m_handshaked = true;
+    SSLContextMgr::GetInstance()->onHandshake(m_ssl.get(), SSL_is_server(m_ssl.get()), true);
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    if(m_ktls) {
+        // 内核不支持时 OpenSSL 继续在用户态加密
+        m_ktlsSend = BIO_get_ktls_send(SSL_get_wbio(m_ssl.get()));
+        SYLAR_LOG_DEBUG(g_logger) << "SSL ktls " << *this << " send=" << m_ktlsSend
+            << " recv=" << isKtlsRecv() << " cipher=" << SSL_get_cipher_name(m_ssl.get());
+    }
+#endif
+    return true;
+}
+
 int SSLSocket::send(const void* buffer, size_t length, int flags) {
-    if(m_ssl) {
-        return SSL_write(m_ssl.get(), buffer, length);
+    if(!m_ssl || !handshake()) {
+        return -1;
+    }
+    if(m_ktlsSend) {
+        return Socket::send(buffer, length, flags | MSG_NOSIGNAL);
+    }
+    while(true) {
+        ERR_clear_error();
+        int rt;
+        {
+            SSLHookGuard guard(m_socketBio);
+            rt = SSL_write(m_ssl.get(), buffer, length);
+        }
+        if(rt > 0) {
+            return rt;
+        }
+        // WANT_WRITE 后必须以相同参数重试
+        int w = waitRetry(rt);
+        if(w <= 0) {
+            return w;
+        }
     }
-    return -1;
 }
 
 int SSLSocket::send(const iovec* buffers, size_t length, int flags) {
-    if(!m_ssl) {
+    if(!m_ssl || !handshake()) {
         return -1;
     }
+    if(m_ktlsSend) {
+        // 一次 sendmsg, 由内核切分成 TLS 记录
+        return Socket::send(buffers, length, flags | MSG_NOSIGNAL);
+    }
     int total = 0;
     for(size_t i = 0; i < length; ++i) {
-        int tmp = SSL_write(m_ssl.get(), buffers[i].iov_base, buffers[i].iov_len);
+        if(buffers[i].iov_len == 0) {
+            continue;
+        }
+        int tmp = send(buffers[i].iov_base, buffers[i].iov_len, flags);
         if(tmp <= 0) {
-            return tmp;
+            return total ? total : tmp;
         }
         total += tmp;
         if(tmp != (int)buffers[i].iov_len) {
@@ -559,11 +1009,49 @@ int SSLSocket::sendTo(const iovec* buffers, size_t length, const Address::ptr to
     return -1;
 }
 
+ssize_t SSLSocket::sendFile(int fd, off_t offset, size_t count) {
+    if(!m_ssl || !handshake()) {
+        return -1;
+    }
+    if(m_ktlsSend) {
+        return Socket::sendFile(fd, offset, count);
+    }
+    // 一次读一个 TLS 记录的大小
+    char buf[16 * 1024];
+    ssize_t total = 0;
+    while((size_t)total < count) {
+        ssize_t n = ::pread(fd, buf, std::min(sizeof(buf), count - total), offset + total);
+        if(n <= 0) {
+            break;
+        }
+        int rt = send(buf, n);
+        if(rt <= 0) {
+            return total ? total : -1;
+        }
+        total += rt;
+    }
+    return total;
+}
+
 int SSLSocket::recv(void* buffer, size_t length, int flags) {
-    if(m_ssl) {
-        return SSL_read(m_ssl.get(), buffer, length);
+    if(!m_ssl || !handshake()) {
+        return -1;
+    }
+    while(true) {
+        ERR_clear_error();
+        int rt;
+        {
+            SSLHookGuard guard(m_socketBio);
+            rt = SSL_read(m_ssl.get(), buffer, length);
+        }
+        if(rt > 0) {
+            return rt;
+        }
+        int w = waitRetry(rt);
+        if(w <= 0) {
+            return w;
+        }
     }
-    return -1;
 }
 
 int SSLSocket::recv(iovec* buffers, size_t length, int flags) {
@@ -572,9 +1060,16 @@ int SSLSocket::recv(iovec* buffers, size_t length, int flags) {
     }
     int total = 0;
     for(size_t i = 0; i < length; ++i) {
-        int tmp = SSL_read(m_ssl.get(), buffers[i].iov_base, buffers[i].iov_len);
+        if(buffers[i].iov_len == 0) {
+            continue;
+        }
+        // 已经读到数据后只取缓冲中剩余的, 不再等待
+        if(total > 0 && SSL_pending(m_ssl.get()) <= 0) {
+            break;
+        }
+        int tmp = recv(buffers[i].iov_base, buffers[i].iov_len, flags);
         if(tmp <= 0) {
-            return tmp;
+            return total ? total : tmp;
         }
         total += tmp;
         if(tmp != (int)buffers[i].iov_len) {
@@ -597,31 +1092,17 @@ int SSLSocket::recvFrom(iovec* buffers, size_t length, Address::ptr from, int fl
 bool SSLSocket::init(int sock) {
     bool v = Socket::init(sock);
     if(v) {
-        m_ssl.reset(SSL_new(m_ctx.get()),  SSL_free);
-        SSL_set_fd(m_ssl.get(), m_sock);
-        v = (SSL_accept(m_ssl.get()) == 1);
+        // 握手不在 accept 协程中进行
+        newSSL();
+        SSL_set_accept_state(m_ssl.get());
     }
     return v;
 }
 
 bool SSLSocket::loadCertificates(const std::string& cert_file, const std::string& key_file) {
-    m_ctx.reset(SSL_CTX_new(SSLv23_server_method()), SSL_CTX_free);
-    if(SSL_CTX_use_certificate_chain_file(m_ctx.get(), cert_file.c_str()) != 1) {
-        SYLAR_LOG_ERROR(g_logger) << "SSL_CTX_use_certificate_chain_file("
-            << cert_file << ") error";
-        return false;
-    }
-    if(SSL_CTX_use_PrivateKey_file(m_ctx.get(), key_file.c_str(), SSL_FILETYPE_PEM) != 1) {
-        SYLAR_LOG_ERROR(g_logger) << "SSL_CTX_use_PrivateKey_file("
-            << key_file << ") error";
-        return false;
-    }
-    if(SSL_CTX_check_private_key(m_ctx.get()) != 1) {
-        SYLAR_LOG_ERROR(g_logger) << "SSL_CTX_check_private_key cert_file="
-            << cert_file << " key_file=" << key_file;
-        return false;
-    }
-    return true;
+    // 相同证书共用 SSL_CTX 及其会话缓存
+    m_ctx = SSLContextMgr::GetInstance()->getServerContext(cert_file, key_file);
+    return m_ctx != nullptr;
 }
 
 SSLSocket::ptr SSLSocket::CreateTCP(sylar::Address::ptr address) {
@@ -2,6 +2,7 @@
 #define __SYLAR_SOCKET_H__
 
 #include <memory>
+#include <vector>
 #include <netinet/tcp.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
@@ -10,6 +11,54 @@
 
 namespace sylar {
 
+/**
+ * Socket::recvBatch / sendBatch 使用的报文缓冲
+ * 预先分配 capacity 个 slot_size 字节的槽 (一整块连续内存) 以及对应的 mmsghdr/iovec/地址/控制信息, 反复使用
+ * 使用 GSO/GRO 时 slot_size 取 64K, 一个槽装多个等长的分段
+ */
+class DatagramBatch : NonCopyable {
+public:
+    typedef std::shared_ptr<DatagramBatch> ptr;
+    DatagramBatch(size_t capacity = 64, size_t slot_size = 2048);
+
+    /**
+     * 追加一个待发送的报文, 数据拷贝到下一个槽
+     * to 为空时发往 connect 的地址; segment_size 非 0 时由内核按该大小切分 (UDP GSO)
+     * 槽已用完或 length 超过槽大小返回 false
+     */
+    bool add(const void* data, size_t length, Address::ptr to = nullptr, uint16_t segment_size = 0);
+    void clear() { m_count = 0;}
+
+    // 报文个数: 发送前为已 add 的个数, recvBatch 后为收到的个数
+    size_t size() const { return m_count;}
+    size_t capacity() const { return m_msgs.size();}
+    size_t getSlotSize() const { return m_slotSize;}
+
+    char* data(size_t idx) { return &m_arena[idx * m_slotSize];}
+    size_t length(size_t idx) const { return m_iovs[idx].iov_len;}
+    const sockaddr* getAddr(size_t idx) const { return (const sockaddr*)&m_addrs[idx];}
+    socklen_t getAddrLen(size_t idx) const { return m_msgs[idx].msg_hdr.msg_namelen;}
+    Address::ptr getAddress(size_t idx) const;
+    // 收到的报文由 GRO 合并时为每个分段的大小 (最后一段可能更短), 否则为 0
+    uint16_t getSegmentSize(size_t idx) const { return m_segments[idx];}
+private:
+    friend class Socket;
+    // recvmmsg 前恢复各槽的长度
+    void prepareRecv();
+    // recvmmsg 后记录长度和 GRO 分段大小
+    void finishRecv(size_t count);
+    void setControl(size_t idx, uint16_t segment_size);
+private:
+    size_t m_slotSize;
+    size_t m_count;
+    std::vector<char> m_arena;
+    std::vector<mmsghdr> m_msgs;
+    std::vector<iovec> m_iovs;
+    std::vector<sockaddr_storage> m_addrs;
+    std::vector<uint64_t> m_control;    // 每个槽 CONTROL_SIZE 字节, uint64_t 保证 cmsghdr 对齐
+    std::vector<uint16_t> m_segments;
+};
+
 class Socket : public std::enable_shared_from_this<Socket>, NonCopyable {
 public:
     typedef std::shared_ptr<Socket> ptr;
@@ -70,16 +119,52 @@ public:
     virtual bool listen(int backlog = SOMAXCONN);
     virtual bool close();
 
+    // 监听 socket 开启 TCP Fast Open, qlen 为未完成握手的 TFO 请求队列长度, 0 关闭
+    bool setFastOpen(int qlen);
+    // 监听 socket 开启 TCP_DEFER_ACCEPT: 连接上有数据到达才 accept, 最多等待 seconds 秒, 0 关闭
+    bool setDeferAccept(int seconds);
+    /**
+     * 客户端 TCP Fast Open, 需在 connect 之前设置
+     * 有 cookie 时 connect 立即返回, 握手推迟到第一次 send, 数据随 SYN 发出;
+     * 没有 cookie 时退化为普通握手并取得 cookie
+     */
+    void setFastOpenConnect(bool v) { m_fastOpenConnect = v;}
+    bool isFastOpenConnect() const { return m_fastOpenConnect;}
+    /**
+     * 以 Fast Open 方式连接并发送 data, 可能时 data 随 SYN 发出, 省去一个 RTT
+     * 返回发送的字节数, 连接失败返回 -1
+     */
+    int connectWithData(const Address::ptr addr, const void* data, size_t length, uint64_t timeout_ms = -1);
+
     virtual int send(const void* buffer, size_t length, int flags = 0);
     virtual int send(const iovec* buffers, size_t length, int flags = 0);
     virtual int sendTo(const void* buffer, size_t length, const Address::ptr to, int flags = 0);
     virtual int sendTo(const iovec* buffers, size_t length, const Address::ptr to, int flags = 0);
+    /**
+     * 用 sendfile 发出文件 fd 从 offset 开始的 count 个字节, 数据不经过用户态
+     * 返回发送的字节数 (可能少于 count), 出错返回 -1
+     */
+    virtual ssize_t sendFile(int fd, off_t offset, size_t count);
 
     virtual int recv(void* buffer, size_t length, int flags = 0);
     virtual int recv(iovec* buffers, size_t length, int flags = 0);
     virtual int recvFrom(void* buffer, size_t length, Address::ptr from, int flags = 0);
     virtual int recvFrom(iovec* buffers, size_t length, Address::ptr from, int flags = 0);
 
+    /**
+     * 一次 recvmmsg 收多个报文到 batch, 至少收到一个才返回 (MSG_WAITFORONE)
+     * 返回收到的报文数, 出错返回 -1
+     */
+    int recvBatch(DatagramBatch::ptr batch, int flags = 0);
+    /**
+     * sendmmsg 发出 batch 中的全部报文, 返回发出的报文数, 一个都没发出时返回 -1
+     */
+    int sendBatch(DatagramBatch::ptr batch, int flags = 0);
+    // UDP GSO: 之后发送的大报文由内核按 size 切分, 0 关闭
+    bool setUdpSegment(uint16_t size);
+    // UDP GRO: 接收时内核合并同一流的报文, 分段大小见 DatagramBatch::getSegmentSize
+    bool setUdpGro(bool v);
+
     Address::ptr getRemoteAddress();
     Address::ptr getLocalAddress();
 
@@ -110,6 +195,7 @@ protected:
     int m_type;                     // 类型
     int m_protocol;                 // 协议
     int m_connected;                // 是否连接
+    bool m_fastOpenConnect;         // connect 时使用 TCP Fast Open
 
     Address::ptr m_localAddress;    // 本地地址
     Address::ptr m_remoteAddress;   // 远端地址
@@ -138,15 +224,56 @@ public:
     virtual int recv(iovec* buffers, size_t length, int flags = 0) override;
     virtual int recvFrom(void* buffer, size_t length, Address::ptr from, int flags = 0) override;
     virtual int recvFrom(iovec* buffers, size_t length, Address::ptr from, int flags = 0) override;
+    // kTLS 发送已开启时直接 sendfile, 否则读出文件经 SSL_write 发送
+    virtual ssize_t sendFile(int fd, off_t offset, size_t count) override;
 
     // 加载证书与私钥文件
     bool loadCertificates(const std::string& cert_file, const std::string& key_file);
+    // 客户端: connect 前设置, 用于 SNI 和会话缓存的 key (host:port)
+    void setHostName(const std::string& v) { m_hostName = v;}
+    const std::string& getHostName() const { return m_hostName;}
+
+    /**
+     * TLS 握手. 服务端 accept 只建立连接, 握手由处理连接的工作协程调用 (或在第一次 send/recv 时进行);
+     * 客户端在 connect 中调用
+     * 需要等待数据时在 IOManager 上让出协程 (不在 IOManager 中时 poll)
+     * timeout_ms 为整个握手的超时时间 (connect 传入它的 timeout_ms), 为 -1 时每次等待用 recv/send timeout
+     */
+    bool handshake(uint64_t timeout_ms = -1);
+    bool isHandshaked() const { return m_handshaked;}
+
+    /**
+     * kTLS: 握手后把会话密钥交给内核 (setsockopt SOL_TLS), 之后 send/writev/sendfile 直接走系统调用,
+     * 加密在内核中完成. 需要在握手前 (connect 前, 或监听 socket 上) 设置, accept 的 socket 继承监听 socket 的设置
+     * 内核没有 tls 模块或算法不支持时自动回退到用户态加密
+     * 默认值取配置 ssl.ktls
+     */
+    void setKtls(bool v) { m_ktls = v;}
+    bool isKtls() const { return m_ktls;}
+    // 握手后内核是否接管了发送/接收方向的加密
+    bool isKtlsSend() const { return m_ktlsSend;}
+    bool isKtlsRecv() const;
     virtual std::ostream& dump(std::ostream& os) const override;
 protected:
     virtual bool init(int sock) override;
+private:
+    /**
+     * 用未 hook 的 send/recv 的 BIO 包装 socket, 数据未就绪时 SSL_* 返回 WANT_READ/WANT_WRITE
+     * 开启 kTLS 时改用 OpenSSL 的 socket BIO (只有它支持 kTLS), 由 hook 的 read/write 等待数据
+     */
+    void newSSL();
+    // SSL_* 返回 rt <= 0 后调用: 需要等待读写时等到就绪返回 1 (调用方重试), 对端关闭返回 0, 出错返回 -1
+    // timeout_ms 为 -1 时按 recv/send timeout 等待
+    int waitRetry(int rt, uint64_t timeout_ms = -1);
+    bool waitEvent(int event, uint64_t timeout_ms);
 private:
     std::shared_ptr<SSL_CTX> m_ctx;         // SSL 配置对象
     std::shared_ptr<SSL> m_ssl;             // SSL/TLS 会话链接
+    std::string m_hostName;                 // 客户端连接的主机名
+    bool m_handshaked;                      // 是否已完成握手
+    bool m_ktls;                            // 是否尝试开启 kTLS
+    bool m_ktlsSend;                        // 发送方向已由内核加密
+    bool m_socketBio;                       // 使用 OpenSSL 的 socket BIO (kTLS), SSL_* 期间需关闭 hook
 };
 
 std::ostream& operator<< (std::ostream& os, const Socket& sock);
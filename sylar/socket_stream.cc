@@ -1,4 +1,6 @@
 #include "socket_stream.h"
+#include <limits.h>
+#include <algorithm>
 #include <vector>
 
 namespace sylar {
@@ -19,7 +21,20 @@ bool SocketStream::isConnected() const {
     return m_socket && m_socket->isConnected();
 }
 
+void SocketStream::setBuffer(size_t read_size, size_t write_size) {
+    if (m_buffer) {
+        m_buffer->setReadBufferSize(read_size);
+        m_buffer->setWriteBufferSize(write_size);
+        return;
+    }
+    m_buffer.reset(new BufferedStream(std::make_shared<SocketStream>(m_socket, false)
+                , read_size, write_size));
+}
+
 int SocketStream::read(void* buffer, size_t length) {
+    if (m_buffer) {
+        return m_buffer->read(buffer, length);
+    }
     if (!isConnected()) {
         return -1;
     }
@@ -27,11 +42,14 @@ int SocketStream::read(void* buffer, size_t length) {
 }
 
 int SocketStream::read(ByteArray::ptr ba, size_t length) {
+    if (m_buffer) {
+        return m_buffer->read(ba, length);
+    }
     if (!isConnected()) {
         return -1;
     }
-    std::vector<iovec> iovs;
-    ba->getWriteBuffers(iovs, length);  // iovs 指向 ByteArray 中的内存块，通过 iovec 向 ByteArray 写数据
+    // iovs 指向 ByteArray 中的内存块，通过 iovec 向 ByteArray 写数据
+    std::vector<iovec>& iovs = ba->getWriteIovecs(length);
     int rt = m_socket->recv(&iovs[0], iovs.size());
     if (rt > 0) {
         ba->setPosition(ba->getPosition() + rt);
@@ -41,6 +59,9 @@ int SocketStream::read(ByteArray::ptr ba, size_t length) {
 
 // 期望从 Socket 读 length (不确定) 个字节放入 ByteArray
 int SocketStream::write(const void* buffer, size_t length) {
+    if (m_buffer) {
+        return m_buffer->write(buffer, length);
+    }
     if (!isConnected()) {
         return -1;
     }
@@ -48,11 +69,13 @@ int SocketStream::write(const void* buffer, size_t length) {
 }
 
 int SocketStream::write(ByteArray::ptr ba, size_t length) {
+    if (m_buffer) {
+        return m_buffer->write(ba, length);
+    }
     if (!isConnected()) {
         return -1;
     }
-    std::vector<iovec> iovs;
-    ba->getReadBuffers(iovs, length);               // 从 ByteArray 读出需要的数据
+    std::vector<iovec>& iovs = ba->getReadIovecs(length);  // 从 ByteArray 读出需要的数据
     int rt =  m_socket->send(&iovs[0], iovs.size());
     if (rt > 0) {
         ba->setPosition(ba->getPosition() + rt);    // 需要修改位置
@@ -60,8 +83,66 @@ int SocketStream::write(ByteArray::ptr ba, size_t length) {
     return rt;
 }        
 
+int SocketStream::writev(const iovec* iov, size_t iovcnt) {
+    if (m_buffer) {
+        return m_buffer->writev(iov, iovcnt);
+    }
+    if (!isConnected()) {
+        return -1;
+    }
+    // 超过 IOV_MAX 时 sendmsg 报错, 剩下的由 writeFixSizeV 继续写
+    return m_socket->send(iov, std::min(iovcnt, (size_t)IOV_MAX));
+}
+
+int SocketStream::readAvailable(ByteArray::ptr ba) {
+    if (m_buffer) {
+        // 先交出缓冲中的数据
+        size_t n = m_buffer->getReadAvailable();
+        if (n > 0) {
+            return m_buffer->read(ba, n);
+        }
+        if (m_buffer->flush() < 0) {
+            return -1;
+        }
+    }
+    if (!isConnected()) {
+        return -1;
+    }
+    static const size_t s_extra_size = 64 * 1024;
+    char extrabuf[s_extra_size];
+
+    uint64_t writable = 0;
+    std::vector<iovec>& iovs = ba->getWritableIovecs(writable);
+    // 空闲空间已经足够大时不用额外缓冲
+    bool use_extra = writable < s_extra_size;
+    if (use_extra) {
+        iovec iov;
+        iov.iov_base = extrabuf;
+        iov.iov_len = s_extra_size;
+        iovs.push_back(iov);
+    }
+    int rt = m_socket->recv(&iovs[0], iovs.size());
+    if (rt <= 0) {
+        return rt;
+    }
+    if ((uint64_t)rt <= writable) {
+        ba->setPosition(ba->getPosition() + rt);
+    } else {
+        ba->setPosition(ba->getPosition() + writable);
+        ba->write(extrabuf, rt - writable);
+    }
+    return rt;
+}
+
 // 从 ByteArray 向 Socket 写入 length 个字节
+int SocketStream::flush() {
+    return m_buffer ? m_buffer->flush() : 0;
+}
+
 void SocketStream::close() {
+    if (m_buffer) {
+        m_buffer->flush();
+    }
     if (m_socket) {
         m_socket->close();
     }
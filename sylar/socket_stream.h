@@ -3,6 +3,7 @@
 
 #include "stream.h"
 #include "socket.h"
+#include "buffered_stream.h"
 
 namespace sylar {
 
@@ -17,13 +18,31 @@ public:
     virtual int read(ByteArray::ptr ba, size_t length) override;         // 期望从 Socket 读 length (不确定) 个字节放入 ByteArray
     virtual int write(const void* buffer, size_t length) override;
     virtual int write(ByteArray::ptr ba, size_t length) override;        // 从 ByteArray 向 Socket 写入 length 个字节
+    virtual int writev(const iovec* iov, size_t iovcnt) override;        // 一次 sendmsg
     virtual void close() override;
+    virtual int flush() override;
+
+    /**
+     * 一次 readv 读尽 socket 中当前可读的数据，写入 ba 的当前位置
+     * 先填满 ba 已有的空闲节点，多出来的部分落到 64K 的栈上缓冲，再追加到 ba
+     * 返回读到的字节数，<= 0 同 read()
+     */
+    int readAvailable(ByteArray::ptr ba);
+
+    /**
+     * 开启读写缓冲, 之后的读写经过 BufferedStream (下层是不持有 socket 的 SocketStream)
+     * read_size 预读缓冲大小, write_size 写缓冲大小, 为 0 表示该方向不缓冲
+     * 已经开启时只修改缓冲大小, 缓冲中的数据保留
+     */
+    void setBuffer(size_t read_size, size_t write_size = 0);
+    BufferedStream::ptr getBuffer() const { return m_buffer;}
 
     Socket::ptr getSocket() const { return m_socket;}
     bool isConnected() const;
 protected:
     Socket::ptr m_socket;
     bool m_owner;
+    BufferedStream::ptr m_buffer;
 };
 
 }
@@ -0,0 +1,220 @@
+#include "ssl_context.h"
+#include <sstream>
+#include "config.h"
+#include "log.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<uint32_t>::ptr g_ssl_server_session_cache_size =
+    sylar::Config::Lookup("ssl.server.session_cache_size", (uint32_t)20480
+            , "server side ssl session cache size");
+
+static sylar::ConfigVar<uint32_t>::ptr g_ssl_server_session_timeout =
+    sylar::Config::Lookup("ssl.server.session_timeout", (uint32_t)300
+            , "ssl session timeout seconds");
+
+static sylar::ConfigVar<bool>::ptr g_ssl_server_session_tickets =
+    sylar::Config::Lookup("ssl.server.session_tickets", true
+            , "enable ssl session tickets");
+
+static sylar::ConfigVar<uint32_t>::ptr g_ssl_client_session_cache_size =
+    sylar::Config::Lookup("ssl.client.session_cache_size", (uint32_t)1024
+            , "client side ssl session cache size (host:port)");
+
+// SSL 上挂的会话 key (std::string*), 随 SSL 释放
+static void FreeSessionKey(void* parent, void* ptr, CRYPTO_EX_DATA* ad, int idx, long argl, void* argp) {
+    delete (std::string*)ptr;
+}
+
+static int s_session_key_index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, FreeSessionKey);
+
+static const unsigned char s_session_id_context[] = "sylar";
+
+std::string SSLContextManager::Stats::toString() const {
+    uint64_t server = server_full + server_resumed;
+    uint64_t client = client_full + client_resumed;
+    std::stringstream ss;
+    ss << "[SSLStats server_full=" << server_full
+       << " server_resumed=" << server_resumed
+       << " server_resume_ratio=" << (server ? (double)server_resumed / server : 0.0)
+       << " client_full=" << client_full
+       << " client_resumed=" << client_resumed
+       << " client_resume_ratio=" << (client ? (double)client_resumed / client : 0.0)
+       << " failed=" << failed
+       << "]";
+    return ss.str();
+}
+
+SSLContextManager::SSLContextManager()
+    :m_serverFull(0)
+    ,m_serverResumed(0)
+    ,m_clientFull(0)
+    ,m_clientResumed(0)
+    ,m_failed(0) {
+}
+
+SSLContextManager::CtxPtr SSLContextManager::getServerContext(const std::string& cert_file
+        , const std::string& key_file) {
+    auto key = std::make_pair(cert_file, key_file);
+    MutexType::Lock lock(m_mutex);
+    auto it = m_servers.find(key);
+    if (it != m_servers.end()) {
+        return it->second;
+    }
+
+    CtxPtr ctx(SSL_CTX_new(SSLv23_server_method()), SSL_CTX_free);
+    if (SSL_CTX_use_certificate_chain_file(ctx.get(), cert_file.c_str()) != 1) {
+        SYLAR_LOG_ERROR(g_logger) << "SSL_CTX_use_certificate_chain_file("
+            << cert_file << ") error";
+        return nullptr;
+    }
+    if (SSL_CTX_use_PrivateKey_file(ctx.get(), key_file.c_str(), SSL_FILETYPE_PEM) != 1) {
+        SYLAR_LOG_ERROR(g_logger) << "SSL_CTX_use_PrivateKey_file("
+            << key_file << ") error";
+        return nullptr;
+    }
+    if (SSL_CTX_check_private_key(ctx.get()) != 1) {
+        SYLAR_LOG_ERROR(g_logger) << "SSL_CTX_check_private_key cert_file="
+            << cert_file << " key_file=" << key_file;
+        return nullptr;
+    }
+
+    // 会话 ID 缓存 (TLS1.2) 与 session ticket (TLS1.2/1.3)
+    SSL_CTX_set_session_cache_mode(ctx.get(), SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx.get(), g_ssl_server_session_cache_size->getValue());
+    SSL_CTX_set_timeout(ctx.get(), g_ssl_server_session_timeout->getValue());
+    SSL_CTX_set_session_id_context(ctx.get(), s_session_id_context, sizeof(s_session_id_context) - 1);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    // 对端不发 close_notify 直接断开按正常 EOF 处理
+    SSL_CTX_set_options(ctx.get(), SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+    if (!g_ssl_server_session_tickets->getValue()) {
+        SSL_CTX_set_options(ctx.get(), SSL_OP_NO_TICKET);
+    }
+    m_servers[key] = ctx;
+    return ctx;
+}
+
+SSLContextManager::CtxPtr SSLContextManager::getClientContext() {
+    MutexType::Lock lock(m_mutex);
+    if (!m_client) {
+        m_client.reset(SSL_CTX_new(SSLv23_client_method()), SSL_CTX_free);
+        // 会话只存在自己的缓存中, 按 host:port 查找
+        SSL_CTX_set_session_cache_mode(m_client.get()
+                , SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(m_client.get(), &SSLContextManager::OnNewSession);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+        SSL_CTX_set_options(m_client.get(), SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+    }
+    return m_client;
+}
+
+void SSLContextManager::prepareClient(SSL* ssl, const std::string& key) {
+    SSL_set_ex_data(ssl, s_session_key_index, new std::string(key));
+
+    std::shared_ptr<SSL_SESSION> session;
+    {
+        MutexType::Lock lock(m_sessionMutex);
+        auto it = m_sessionIndex.find(key);
+        if (it == m_sessionIndex.end()) {
+            return;
+        }
+        session = it->second->second;
+        if (!SSL_SESSION_is_resumable(session.get())) {
+            m_sessions.erase(it->second);
+            m_sessionIndex.erase(it);
+            return;
+        }
+        m_sessions.splice(m_sessions.begin(), m_sessions, it->second);
+    }
+    SSL_set_session(ssl, session.get());
+}
+
+int SSLContextManager::OnNewSession(SSL* ssl, SSL_SESSION* session) {
+    std::string* key = (std::string*)SSL_get_ex_data(ssl, s_session_key_index);
+    if (!key || !SSL_SESSION_is_resumable(session)) {
+        return 0;
+    }
+    // 存副本: 连接未 SSL_shutdown 就释放时 OpenSSL 会把它正在用的 session 标记为不可复用
+    SSL_SESSION* copy = SSL_SESSION_dup(session);
+    if (copy) {
+        SSLContextMgr::GetInstance()->putClientSession(*key, copy);
+    }
+    return 0;
+}
+
+void SSLContextManager::putClientSession(const std::string& key, SSL_SESSION* session) {
+    std::shared_ptr<SSL_SESSION> s(session, SSL_SESSION_free);
+    std::shared_ptr<SSL_SESSION> evicted;   // 在锁外释放
+    MutexType::Lock lock(m_sessionMutex);
+    auto it = m_sessionIndex.find(key);
+    if (it != m_sessionIndex.end()) {
+        evicted = it->second->second;
+        it->second->second = s;
+        m_sessions.splice(m_sessions.begin(), m_sessions, it->second);
+        return;
+    }
+    m_sessions.push_front(std::make_pair(key, s));
+    m_sessionIndex[key] = m_sessions.begin();
+    if (m_sessions.size() > g_ssl_client_session_cache_size->getValue()) {
+        evicted = m_sessions.back().second;
+        m_sessionIndex.erase(m_sessions.back().first);
+        m_sessions.pop_back();
+    }
+}
+
+void SSLContextManager::removeClientSession(const std::string& key) {
+    MutexType::Lock lock(m_sessionMutex);
+    auto it = m_sessionIndex.find(key);
+    if (it != m_sessionIndex.end()) {
+        m_sessions.erase(it->second);
+        m_sessionIndex.erase(it);
+    }
+}
+
+void SSLContextManager::clearClientSessions() {
+    MutexType::Lock lock(m_sessionMutex);
+    m_sessions.clear();
+    m_sessionIndex.clear();
+}
+
+size_t SSLContextManager::getClientSessionCount() {
+    MutexType::Lock lock(m_sessionMutex);
+    return m_sessions.size();
+}
+
+void SSLContextManager::onHandshake(SSL* ssl, bool server, bool ok) {
+    if (!ok) {
+        ++m_failed;
+        return;
+    }
+    bool resumed = SSL_session_reused(ssl);
+    if (server) {
+        ++(resumed ? m_serverResumed : m_serverFull);
+    } else {
+        ++(resumed ? m_clientResumed : m_clientFull);
+    }
+}
+
+SSLContextManager::Stats SSLContextManager::getStats() const {
+    Stats s;
+    s.server_full = m_serverFull;
+    s.server_resumed = m_serverResumed;
+    s.client_full = m_clientFull;
+    s.client_resumed = m_clientResumed;
+    s.failed = m_failed;
+    return s;
+}
+
+void SSLContextManager::resetStats() {
+    m_serverFull = 0;
+    m_serverResumed = 0;
+    m_clientFull = 0;
+    m_clientResumed = 0;
+    m_failed = 0;
+}
+
+}
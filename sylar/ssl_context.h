@@ -0,0 +1,83 @@
+#ifndef __SYLAR_SSL_CONTEXT_H__
+#define __SYLAR_SSL_CONTEXT_H__
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <openssl/ssl.h>
+#include "mutex.h"
+#include "noncopyable.h"
+#include "singleton.h"
+
+namespace sylar {
+
+/**
+ * SSL_CTX 注册表
+ * 1. 服务端按 (cert_file, key_file) 共享 SSL_CTX, 开启服务端会话缓存与 session ticket
+ * 2. 客户端共用一个 SSL_CTX, 按 host:port 缓存会话 (LRU), 再次连接时恢复会话, 省去完整握手
+ * 3. 统计握手次数与会话复用次数
+ */
+class SSLContextManager : NonCopyable {
+public:
+    typedef Mutex MutexType;
+    typedef std::shared_ptr<SSL_CTX> CtxPtr;
+
+    struct Stats {
+        uint64_t server_full = 0;       // 服务端完整握手
+        uint64_t server_resumed = 0;    // 服务端会话复用
+        uint64_t client_full = 0;
+        uint64_t client_resumed = 0;
+        uint64_t failed = 0;            // 握手失败
+
+        std::string toString() const;
+    };
+
+    SSLContextManager();
+
+    // 相同证书的监听 socket 共用一个 SSL_CTX, 加载失败返回 nullptr
+    CtxPtr getServerContext(const std::string& cert_file, const std::string& key_file);
+    CtxPtr getClientContext();
+
+    /**
+     * 客户端握手前调用: 记下会话的 key (host:port), 有缓存的会话时设置到 ssl 上
+     * 服务端发来的新会话 (TLS1.3 在握手之后) 通过回调存入缓存
+     */
+    void prepareClient(SSL* ssl, const std::string& key);
+    void removeClientSession(const std::string& key);
+    void clearClientSessions();
+    size_t getClientSessionCount();
+
+    // 握手结束后调用, 记录统计
+    void onHandshake(SSL* ssl, bool server, bool ok);
+    Stats getStats() const;
+    void resetStats();
+private:
+    static int OnNewSession(SSL* ssl, SSL_SESSION* session);
+    // 接管 session 的引用
+    void putClientSession(const std::string& key, SSL_SESSION* session);
+private:
+    MutexType m_mutex;
+    std::map<std::pair<std::string, std::string>, CtxPtr> m_servers;
+    CtxPtr m_client;
+
+    // 客户端会话 LRU, 最近使用的在前
+    typedef std::list<std::pair<std::string, std::shared_ptr<SSL_SESSION>>> SessionList;
+    MutexType m_sessionMutex;
+    SessionList m_sessions;
+    std::unordered_map<std::string, SessionList::iterator> m_sessionIndex;
+
+    std::atomic<uint64_t> m_serverFull;
+    std::atomic<uint64_t> m_serverResumed;
+    std::atomic<uint64_t> m_clientFull;
+    std::atomic<uint64_t> m_clientResumed;
+    std::atomic<uint64_t> m_failed;
+};
+
+typedef sylar::Singleton<SSLContextManager> SSLContextMgr;
+
+}
+
+#endif  // __SYLAR_SSL_CONTEXT_H__
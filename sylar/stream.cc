@@ -1,7 +1,11 @@
 #include "stream.h"
+#include <vector>
 
 namespace sylar {
 
+static const size_t s_cork_copy_size = 1024;           // cork 时小于该长度的数据拷贝后合并
+static const size_t s_cork_buffer_size = 64 * 1024;    // cork 缓冲上限
+
 
 int Stream::readFixSize(void* buffer, size_t length) {
     size_t offset = 0;
@@ -30,6 +34,16 @@ int Stream::readFixSize(ByteArray::ptr ba, size_t length) {
 } 
 
 int Stream::writeFixSize(const void* buffer, size_t length) {
+    if (m_corked) {
+        if (length < s_cork_copy_size
+                && m_corkBuf.size() + length <= s_cork_buffer_size) {
+            m_corkBuf.append((const char*)buffer, length);
+            return length;
+        }
+        int rt = flushCorked(buffer, length);
+        return rt <= 0 ? rt : length;
+    }
+
     size_t offset = 0;
     int64_t left = length;
     while (left > 0) {
@@ -44,6 +58,12 @@ int Stream::writeFixSize(const void* buffer, size_t length) {
 }
 
 int Stream::writeFixSize(ByteArray::ptr ba, size_t length) {
+    if (!m_corkBuf.empty()) {
+        int rt = flushCorked(nullptr, 0);   // 保持顺序
+        if (rt <= 0) {
+            return rt;
+        }
+    }
     int64_t left = length;
     while (left > 0) {
         int64_t len = write(ba, left);
@@ -55,4 +75,79 @@ int Stream::writeFixSize(ByteArray::ptr ba, size_t length) {
     return length;
 }
 
-}
\ No newline at end of file
+int Stream::writev(const iovec* iov, size_t iovcnt) {
+    for (size_t i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len) {
+            return write(iov[i].iov_base, iov[i].iov_len);
+        }
+    }
+    return 0;
+}
+
+int Stream::writeFixSizeV(const iovec* iov, size_t iovcnt) {
+    if (m_corked && !m_corkBuf.empty()) {
+        // 已攒的数据在前, 与本次数据一起发出, 保持顺序
+        size_t corked = m_corkBuf.size();
+        std::vector<iovec> iovs;
+        iovs.reserve(iovcnt + 1);
+        iovs.push_back({&m_corkBuf[0], corked});
+        iovs.insert(iovs.end(), iov, iov + iovcnt);
+        int rt = writeAllV(iovs);   // 会修改 iovs
+        m_corkBuf.clear();
+        return rt <= 0 ? rt : rt - (int)corked;
+    }
+    std::vector<iovec> iovs(iov, iov + iovcnt);     // 部分写入时需要修改
+    return writeAllV(iovs);
+}
+
+int Stream::writeAllV(std::vector<iovec>& iovs) {
+    size_t total = 0;
+    for (auto& i : iovs) {
+        total += i.iov_len;
+    }
+
+    size_t idx = 0;
+    while (true) {
+        while (idx < iovs.size() && iovs[idx].iov_len == 0) {
+            ++idx;
+        }
+        if (idx == iovs.size()) {
+            break;
+        }
+        int64_t len = writev(&iovs[idx], iovs.size() - idx);
+        if (len <= 0) {
+            return len;
+        }
+        // 跳过已经写完的 buffer, 调整写了一部分的
+        while (idx < iovs.size() && (size_t)len >= iovs[idx].iov_len) {
+            len -= iovs[idx].iov_len;
+            ++idx;
+        }
+        if (len > 0) {
+            iovs[idx].iov_base = (char*)iovs[idx].iov_base + len;
+            iovs[idx].iov_len -= len;
+        }
+    }
+    return total;
+}
+
+int Stream::flushCorked(const void* buffer, size_t length) {
+    std::vector<iovec> iovs(2);
+    iovs[0].iov_base = &m_corkBuf[0];
+    iovs[0].iov_len = m_corkBuf.size();
+    iovs[1].iov_base = (void*)buffer;
+    iovs[1].iov_len = length;
+    int rt = writeAllV(iovs);
+    m_corkBuf.clear();
+    return rt;
+}
+
+int Stream::uncork() {
+    if (m_corked == 0 || --m_corked > 0 || m_corkBuf.empty()) {
+        return 0;
+    }
+    int rt = flushCorked(nullptr, 0);
+    return rt <= 0 ? -1 : rt;
+}
+
+}
@@ -2,13 +2,18 @@
 #define __SYLAR_STREAM_H__
 
 #include <memory>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
 #include "bytearray.h"
+#include "noncopyable.h"
 
 namespace sylar {
 
 class Stream {
 public:
     typedef std::shared_ptr<Stream> ptr;
+    Stream() :m_corked(0) {}
     virtual ~Stream() {}
 
     virtual int read(void* buffer, size_t length) = 0;
@@ -19,11 +24,60 @@ public:
     virtual int write(ByteArray::ptr ba, size_t length) = 0;        // 从 ByteArray 向 Socket 写入 length 个字节
     virtual int writeFixSize(const void* buffer, size_t length);
     virtual int writeFixSize(ByteArray::ptr ba, size_t length);
+    // 聚集写, 返回写入的字节数, 默认实现只写第一个非空的 buffer
+    virtual int writev(const iovec* iov, size_t iovcnt);
+    // 全部写完才返回, 成功返回总长度
+    virtual int writeFixSizeV(const iovec* iov, size_t iovcnt);
     virtual void close() = 0;
+    // 发出缓冲中的数据, 无缓冲的 Stream 什么也不做, 出错返回 -1
+    virtual int flush() { return 0;}
 
+    /**
+     * 合并写: cork 之后 writeFixSize 的小块数据先拷贝攒起来,
+     * 遇到大块数据时与已攒的数据一起 writeFixSizeV 发出 (大块不拷贝), uncork 时发出剩余的
+     * 只影响 writeFixSize, 可嵌套
+     * 攒起来的 writeFixSize 直接返回成功, 写错误在 uncork 时返回
+     * uncork 返回发送的字节数, 没有需要发送的数据返回 0, 出错返回 -1
+     * cork 期间只能用 writeFixSize / writeFixSizeV 写入 (它们先发出已攒的数据);
+     * 直接调用 write / writev 会越过已攒的数据, 造成乱序
+     */
+    void cork() { ++m_corked;}
+    int uncork();
+    bool isCorked() const { return m_corked > 0;}
 private:
+    int flushCorked(const void* buffer, size_t length);
+    // 循环 writev 直到 iovs 全部写完 (会修改 iovs), 返回总字节数
+    int writeAllV(std::vector<iovec>& iovs);
+private:
+    int m_corked;
+    std::string m_corkBuf;      // cork 期间攒的数据
+};
+
+// 作用域内的 writeFixSize 合并发送
+class StreamCork : NonCopyable {
+public:
+    StreamCork(Stream* stream)
+        :m_stream(stream)
+        ,m_flushed(false) {
+        m_stream->cork();
+    }
 
+    ~StreamCork() {
+        flush();
+    }
+
+    int flush() {
+        if (m_flushed) {
+            return 0;
+        }
+        m_flushed = true;
+        return m_stream->uncork();
+    }
+private:
+    Stream* m_stream;
+    bool m_flushed;
 };
+
 }
 
 #endif  // __SYLAR_STREAM_H__
\ No newline at end of file
@@ -3,9 +3,12 @@
 
 #include "address.h"
 #include "application.h"
+#include "buffer_pool.h"
+#include "buffered_stream.h"
 #include "bytearray.h"
 #include "config.h"
 #include "daemon.h"
+#include "dns.h"
 #include "endian.h"
 #include "env.h"
 #include "fd_manager.h"
@@ -19,9 +22,11 @@
 #include "mutex.h"
 #include "noncopyable.h"
 #include "scheduler.h"
+#include "serialize.h"
 #include "singleton.h"
 #include "socket.h"
 #include "socket_stream.h"
+#include "ssl_context.h"
 #include "stream.h"
 #include "tcp_server.h"
 #include "thread.h"
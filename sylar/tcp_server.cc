@@ -45,6 +45,14 @@ bool TcpServer::bind(const std::vector<Address::ptr>& addrs, std::vector<Address
             failed_addrs.push_back(addr);
             continue;
         }
+        if (m_fastOpen && !sock->setFastOpen(m_fastOpen)) {
+            SYLAR_LOG_WARN(g_logger) << "fail to set TCP_FASTOPEN, errno=" << errno
+                << ", addr=[" << addr->toString() << "]";
+        }
+        if (m_deferAccept && !sock->setDeferAccept(m_deferAccept)) {
+            SYLAR_LOG_WARN(g_logger) << "fail to set TCP_DEFER_ACCEPT, errno=" << errno
+                << ", addr=[" << addr->toString() << "]";
+        }
         if (!sock->listen()) {
             SYLAR_LOG_ERROR(g_logger) << "fail to listen, errno=" << errno << ", errstr=" << strerror(errno)
                 << ", addr=[" << addr->toString() << "]";
@@ -69,12 +77,36 @@ bool TcpServer::bind(const std::vector<Address::ptr>& addrs, std::vector<Address
     return true;
 }
 
+void TcpServer::setFastOpen(int qlen) {
+    m_fastOpen = qlen;
+    for (auto& sock : m_socks) {
+        if (!sock->setFastOpen(qlen)) {
+            SYLAR_LOG_WARN(g_logger) << "fail to set TCP_FASTOPEN, errno=" << errno
+                << " " << *sock;
+        }
+    }
+}
+
+void TcpServer::setDeferAccept(int seconds) {
+    m_deferAccept = seconds;
+    for (auto& sock : m_socks) {
+        if (!sock->setDeferAccept(seconds)) {
+            SYLAR_LOG_WARN(g_logger) << "fail to set TCP_DEFER_ACCEPT, errno=" << errno
+                << " " << *sock;
+        }
+    }
+}
+
 void TcpServer::startAccept(Socket::ptr sock) {
     while (!m_isStop) {
         Socket::ptr client = sock->accept();
         if (client) {
             client->setRecvTimeout(m_recvTimeout); // 设置超时时间
-            m_worker->schedule(std::bind(&TcpServer::handleClient, shared_from_this(), client));  // 
+            if (m_ssl) {
+                m_worker->schedule(std::bind(&TcpServer::handshakeClient, shared_from_this(), client));
+            } else {
+                m_worker->schedule(std::bind(&TcpServer::handleClient, shared_from_this(), client));  // 
+            }
         } else {
             SYLAR_LOG_ERROR(g_logger) << "accept errno = " << errno
                 << " errstr=" << strerror(errno);
@@ -105,6 +137,15 @@ void TcpServer::stop() {
     });
 }
 
+void TcpServer::handshakeClient(Socket::ptr client) {
+    auto ssl_socket = std::dynamic_pointer_cast<SSLSocket>(client);
+    if (ssl_socket && !ssl_socket->handshake()) {
+        client->close();
+        return;
+    }
+    handleClient(client);
+}
+
 void TcpServer::handleClient(Socket::ptr client) {
     SYLAR_LOG_INFO(g_logger) << "handleClient: " << *client;
 }
@@ -19,6 +19,10 @@ struct TcpServerConf {
     int keepalive = 0;
     int timeout = 1000 * 2 * 60;
     int ssl = 0;
+    /// TCP Fast Open 队列长度, 0 关闭
+    int fast_open = 0;
+    /// TCP_DEFER_ACCEPT 等待秒数, 0 关闭
+    int defer_accept = 0;
     std::string id;
     /// 服务器类型，http, ws
     std::string type = "http";
@@ -39,6 +43,8 @@ struct TcpServerConf {
             && timeout == oth.timeout
             && name == oth.name
             && ssl == oth.ssl
+            && fast_open == oth.fast_open
+            && defer_accept == oth.defer_accept
             && cert_file == oth.cert_file
             && key_file == oth.key_file
             && accept_worker == oth.accept_worker
@@ -62,6 +68,8 @@ public:
         conf.timeout = node["timeout"].as<int>(conf.timeout);
         conf.name = node["name"].as<std::string>(conf.name);
         conf.ssl = node["ssl"].as<int>(conf.ssl);
+        conf.fast_open = node["fast_open"].as<int>(conf.fast_open);
+        conf.defer_accept = node["defer_accept"].as<int>(conf.defer_accept);
         conf.cert_file = node["cert_file"].as<std::string>(conf.cert_file);
         conf.key_file = node["key_file"].as<std::string>(conf.key_file);
         conf.accept_worker = node["accept_worker"].as<std::string>();
@@ -89,6 +97,8 @@ public:
         node["keepalive"] = conf.keepalive;
         node["timeout"] = conf.timeout;
         node["ssl"] = conf.ssl;
+        node["fast_open"] = conf.fast_open;
+        node["defer_accept"] = conf.defer_accept;
         node["cert_file"] = conf.cert_file;
         node["key_file"] = conf.key_file;
         node["accept_worker"] = conf.accept_worker;
@@ -125,12 +135,22 @@ public:
     virtual void setName(const std::string& v) { m_name = v;}  
     bool isStop() const { return m_isStop;}
 
+    // 监听 socket 的 TCP Fast Open 队列长度, 0 关闭; bind 前后设置均可
+    void setFastOpen(int qlen);
+    // 监听 socket 的 TCP_DEFER_ACCEPT 秒数, 连接有数据才 accept, 不为空连接调度协程; 0 关闭
+    void setDeferAccept(int seconds);
+    int getFastOpen() const { return m_fastOpen;}
+    int getDeferAccept() const { return m_deferAccept;}
+
     TcpServerConf::ptr getConf() const { return m_conf;}
     void setConf(TcpServerConf::ptr v) { m_conf = v;}
     void setConf(const TcpServerConf& v);
 protected:
     virtual void handleClient(Socket::ptr client);  // 每 accpet 一次，执行一次这个回调函数
     virtual void startAccept(Socket::ptr sock);
+private:
+    // 在工作线程中完成 TLS 握手后再 handleClient, 握手不占用 accept 协程
+    void handshakeClient(Socket::ptr client);
 protected:
     std::vector<Socket::ptr> m_socks;       // 监听 socket 数组
     IOManager* m_worker;                    // 工作线程池，执行 hanleClient()
@@ -141,6 +161,8 @@ protected:
     bool m_isStop;
 
     bool m_ssl = false;
+    int m_fastOpen = 0;
+    int m_deferAccept = 0;
 
     TcpServerConf::ptr m_conf;              // 服务器配置
 };